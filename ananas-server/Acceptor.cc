@@ -7,6 +7,9 @@
 
 #include "AnanasDebug.h"
 
+#include <iostream>
+using namespace std;
+
 
 namespace ananas {
 namespace internal {
@@ -29,6 +32,10 @@ void Acceptor::SetNewConnCallback(NewTcpConnCallback cb) {
     newConnCallback_ = std::move(cb);
 }
 
+void Acceptor::SetLoadBalance(LoadBalance lb) {
+    loadBalance_ = lb;
+}
+
 bool Acceptor::Bind(const SocketAddr& addr) {
 	cout<<"Acceptor::Bind"<<endl;
     if (!addr.IsValid())
@@ -68,6 +75,9 @@ bool Acceptor::Bind(const SocketAddr& addr) {
     if (!loop_->Register(eET_Read, this->shared_from_this()))
         return false;
 
+    // accept by io_uring if possible
+    loop_->StartCompletion(CompletionOp::eAccept, this);
+
     ANANAS_INF << "Create listen socket " << localSock_
                << " on port " << localPort_;
     return  true;
@@ -82,21 +92,7 @@ bool Acceptor::HandleReadEvent() {
     while (true) {
         int connfd = _Accept();
         if (connfd != kInvalid) {
-            auto loop = Application::Instance().Next();
-            auto func = [loop, newCb = newConnCallback_, connfd, peer = peer_]() {
-                auto conn(std::make_shared<Connection>(loop));
-                conn->Init(connfd, peer);
-				cout<<"Acceptor::HandleReadEvent() loop->Register Connection"<<endl;
-                if (loop->Register(eET_Read, conn)) {
-                    newCb(conn.get());
-					cout<<"Acceptor::HandleReadEven conn->_Onconnect"<<endl;
-                    conn->_OnConnect();
-                } else {
-                    ANANAS_ERR << "Failed to register socket " << conn->Identifier();
-                }
-            };
-			cout<<"Acceptor::HandleReadEvent() loop_Execute"<<endl;
-            loop->Execute(std::move(func));
+            _NewConnection(connfd);
         } else {
             bool goAhead = false;
             const int error = errno;
@@ -144,6 +140,43 @@ bool Acceptor::HandleReadEvent() {
     return true;
 }
 
+bool Acceptor::HandleCompletion(const Completion& c) {
+    if (c.result < 0) {
+        // poller accepts again, see HandleReadEvent for errors
+        ANANAS_ERR << "Accept completion error = " << -c.result;
+        return true;
+    }
+
+    int connfd = c.result;
+    socklen_t addrLength = sizeof peer_;
+    if (::getpeername(connfd, (struct sockaddr *)&peer_, &addrLength) == kError) {
+        ANANAS_WRN << "getpeername failed, error = " << errno;
+        CloseSocket(connfd);
+        return true;
+    }
+
+    _NewConnection(connfd);
+    return true;
+}
+
+void Acceptor::_NewConnection(int connfd) {
+    auto loop = Application::Instance().Next(loadBalance_, peer_);
+    auto func = [loop, newCb = newConnCallback_, connfd, peer = peer_]() {
+        auto conn(std::make_shared<Connection>(loop));
+        conn->Init(connfd, peer);
+        if (loop->Register(eET_Read, conn)) {
+			cout<<"Acceptor::HandleReadEvent() loop->Register Connection"<<endl;
+            newCb(conn.get());
+				cout<<"Acceptor::HandleReadEven conn->_Onconnect"<<endl;
+            conn->_OnConnect();
+        } else {
+            ANANAS_ERR << "Failed to register socket " << conn->Identifier();
+        }
+    };
+	cout<<"Acceptor::HandleReadEvent() loop_Execute"<<endl;
+    loop->Dispatch(std::move(func));
+}
+
 bool Acceptor::HandleWriteEvent() {
     assert (false);
     return false;
@@ -0,0 +1,239 @@
+#include "Affinity.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#if defined(__gnu_linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "AnanasDebug.h"
+
+namespace ananas {
+
+AffinityPolicy AffinityPolicy::CpuList(std::vector<int> cpus) {
+    AffinityPolicy policy;
+    policy.mode = eCpuList;
+    policy.cpus = std::move(cpus);
+    return policy;
+}
+
+AffinityPolicy AffinityPolicy::OnePerCore() {
+    AffinityPolicy policy;
+    policy.mode = eOnePerCore;
+    return policy;
+}
+
+AffinityPolicy AffinityPolicy::NumaNode(int node) {
+    AffinityPolicy policy;
+    policy.mode = eNumaNode;
+    policy.node = node;
+    return policy;
+}
+
+namespace internal {
+
+std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+
+    std::istringstream iss(list);
+    std::string range;
+    while (std::getline(iss, range, ',')) {
+        if (range.empty())
+            continue;
+
+        int first = 0, last = 0;
+        const auto dash = range.find('-');
+        try {
+            first = std::stoi(range.substr(0, dash));
+            last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        } catch (...) {
+            continue;
+        }
+
+        for (int cpu = first; cpu <= last; ++ cpu)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+#if defined(__gnu_linux__)
+
+namespace {
+
+const char* const kSysCpu = "/sys/devices/system/cpu/";
+const char* const kSysNode = "/sys/devices/system/node/";
+
+bool ReadLine(const std::string& path, std::string& line) {
+    std::ifstream ifs(path);
+    return ifs && std::getline(ifs, line);
+}
+
+std::vector<int> OnlineCpus() {
+    std::string line;
+    if (ReadLine(std::string(kSysCpu) + "online", line))
+        return ParseCpuList(line);
+
+    std::vector<int> cpus;
+    const long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    for (long i = 0; i < n; ++ i)
+        cpus.push_back(static_cast<int>(i));
+
+    return cpus;
+}
+
+// The first thread of every physical core
+std::vector<int> CoreCpus() {
+    std::vector<int> cpus;
+    std::set<std::pair<int, int> > seen; // (package, core)
+
+    for (int cpu : OnlineCpus()) {
+        const std::string topo = std::string(kSysCpu) + "cpu" + std::to_string(cpu) + "/topology/";
+
+        std::string pkg, core;
+        if (!ReadLine(topo + "physical_package_id", pkg) ||
+            !ReadLine(topo + "core_id", core)) {
+            cpus.push_back(cpu);
+            continue;
+        }
+
+        if (seen.insert(std::make_pair(std::atoi(pkg.c_str()), std::atoi(core.c_str()))).second)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+std::vector<int> OnlineNodes() {
+    std::string line;
+    if (ReadLine(std::string(kSysNode) + "online", line))
+        return ParseCpuList(line);
+
+    return std::vector<int>();
+}
+
+std::vector<int> NodeCpus(int node) {
+    std::string line;
+    if (ReadLine(std::string(kSysNode) + "node" + std::to_string(node) + "/cpulist", line))
+        return ParseCpuList(line);
+
+    return std::vector<int>();
+}
+
+// set_mempolicy(MPOL_PREFERRED), no dependency on libnuma
+bool PreferNode(int node) {
+#if defined(__NR_set_mempolicy)
+    const int kMpolPreferred = 1;
+    const std::size_t kBitsPerLong = 8 * sizeof(unsigned long);
+
+    std::vector<unsigned long> mask(node / kBitsPerLong + 1, 0);
+    mask[node / kBitsPerLong] |= 1UL << (node % kBitsPerLong);
+
+    return 0 == ::syscall(__NR_set_mempolicy, kMpolPreferred,
+                          mask.data(), mask.size() * kBitsPerLong + 1);
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+std::string ToString(const std::vector<int>& cpus) {
+    std::ostringstream oss;
+    for (std::size_t i = 0; i < cpus.size(); ++ i) {
+        if (i > 0)
+            oss << ',';
+        oss << cpus[i];
+    }
+
+    return oss.str();
+}
+
+} // end namespace
+
+std::string ApplyAffinity(const AffinityPolicy& policy, std::size_t index) {
+    std::vector<int> cpus;
+    int node = -1;
+
+    switch (policy.mode) {
+    case AffinityPolicy::eNone:
+        return "not pinned";
+
+    case AffinityPolicy::eCpuList:
+        if (!policy.cpus.empty())
+            cpus.push_back(policy.cpus[index % policy.cpus.size()]);
+        break;
+
+    case AffinityPolicy::eOnePerCore: {
+        const auto cores = CoreCpus();
+        if (!cores.empty())
+            cpus.push_back(cores[index % cores.size()]);
+        break;
+    }
+
+    case AffinityPolicy::eNumaNode: {
+        if (policy.node >= 0) {
+            node = policy.node;
+        } else {
+            const auto nodes = OnlineNodes();
+            if (!nodes.empty())
+                node = nodes[index % nodes.size()];
+        }
+
+        if (node >= 0)
+            cpus = NodeCpus(node);
+        break;
+    }
+    }
+
+    if (cpus.empty()) {
+        ANANAS_WRN << "No cpu for affinity policy " << policy.mode
+                   << ", loop " << index << " is not pinned";
+        return "not pinned";
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+
+    const int err = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+    if (err != 0) {
+        ANANAS_ERR << "pthread_setaffinity_np failed for loop " << index
+                   << ", cpus " << ToString(cpus) << ", error " << err;
+        return "not pinned";
+    }
+
+    std::string desc = "cpus " + ToString(cpus);
+    if (node >= 0) {
+        desc += ", node " + std::to_string(node);
+        if (!PreferNode(node))
+            desc += " (memory policy failed)";
+    }
+
+    return desc;
+}
+
+#else
+
+std::string ApplyAffinity(const AffinityPolicy& policy, std::size_t ) {
+    if (policy.mode != AffinityPolicy::eNone)
+        ANANAS_WRN << "Affinity is only supported on linux";
+
+    return "not pinned";
+}
+
+#endif
+
+} // end namespace internal
+
+} // end namespace ananas
+
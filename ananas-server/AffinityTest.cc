@@ -0,0 +1,106 @@
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+#include "net/Affinity.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+using internal::ParseCpuList;
+
+namespace {
+
+std::vector<int> Cpus(std::initializer_list<int> l) {
+    return std::vector<int>(l);
+}
+
+// cpus the current thread may run on
+std::vector<int> Allowed() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::pthread_getaffinity_np(::pthread_self(), sizeof set, &set) != 0)
+        return cpus;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++ cpu) {
+        if (CPU_ISSET(cpu, &set))
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+// Apply in a new thread, not to pin the test; allowed is after applied
+std::string Apply(const AffinityPolicy& policy, std::size_t index,
+                  std::vector<int>* allowed = nullptr) {
+    std::string desc;
+    std::thread t([&]() {
+        desc = internal::ApplyAffinity(policy, index);
+        if (allowed)
+            *allowed = Allowed();
+    });
+    t.join();
+
+    return desc;
+}
+
+} // end namespace
+
+TEST_CASE(ParseRanges) {
+    EXPECT_TRUE(ParseCpuList("0-3,8,10-11") == Cpus({0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_TRUE(ParseCpuList("5") == Cpus({5}));
+    EXPECT_TRUE(ParseCpuList("2-2") == Cpus({2}));
+}
+
+TEST_CASE(ParseBlanks) {
+    EXPECT_TRUE(ParseCpuList("").empty());
+    EXPECT_TRUE(ParseCpuList(",,") == Cpus({}));
+    EXPECT_TRUE(ParseCpuList("0,,2,") == Cpus({0, 2}));
+    EXPECT_TRUE(ParseCpuList(" 1, 3 - 4") == Cpus({1, 3, 4}));
+}
+
+TEST_CASE(ParseMalformed) {
+    EXPECT_TRUE(ParseCpuList("a,2") == Cpus({2}));
+    EXPECT_TRUE(ParseCpuList("1-,4") == Cpus({4}));
+    EXPECT_TRUE(ParseCpuList("-1,4") == Cpus({4}));
+    EXPECT_TRUE(ParseCpuList("5-3,7") == Cpus({7})); // reversed, empty
+    EXPECT_TRUE(ParseCpuList("99999999999,1") == Cpus({1})); // out of int
+}
+
+TEST_CASE(ApplyNone) {
+    std::vector<int> before = Allowed();
+    std::vector<int> after;
+    EXPECT_EQ(Apply(AffinityPolicy(), 0, &after), std::string("not pinned"));
+    EXPECT_TRUE(after == before);
+}
+
+TEST_CASE(ApplyCpuList) {
+    const std::vector<int> allowed = Allowed();
+    EXPECT_TRUE(!allowed.empty());
+
+    // loop index wraps around the list
+    const int cpu = allowed.back();
+    std::vector<int> after;
+    const auto policy = AffinityPolicy::CpuList(Cpus({allowed.front(), cpu}));
+    EXPECT_EQ(Apply(policy, 3, &after), "cpus " + std::to_string(cpu));
+    EXPECT_TRUE(after == Cpus({cpu}));
+
+    // nothing to pin to
+    EXPECT_EQ(Apply(AffinityPolicy::CpuList(Cpus({})), 0), std::string("not pinned"));
+    EXPECT_EQ(Apply(AffinityPolicy::CpuList(Cpus({CPU_SETSIZE + 1})), 0), std::string("not pinned"));
+}
+
+TEST_CASE(ApplyOnePerCore) {
+    std::vector<int> after;
+    const std::string desc = Apply(AffinityPolicy::OnePerCore(), 0, &after);
+    // first core may be out of cpuset of a container
+    if (desc == "not pinned")
+        return;
+
+    EXPECT_EQ(after.size(), 1u);
+    EXPECT_EQ(desc, "cpus " + std::to_string(after[0]));
+}
+
+TEST_MAIN()
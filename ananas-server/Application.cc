@@ -46,9 +46,34 @@ Application& Application::Instance() {
     return app;
 }
 
-void Application::SetNumOfWorker(size_t num) {
+void Application::SetNumOfWorker(size_t num, const AffinityPolicy& policy) {
     assert (state_ == State::eS_None);
     workerGroup_->SetNumOfEventLoop(num);
+    workerGroup_->SetAffinity(policy);
+}
+
+void Application::SetPollerType(PollerType type) {
+    assert (state_ == State::eS_None);
+    workerGroup_->SetPollerType(type);
+}
+
+void Application::SetBudget(const LoopBudget& budget) {
+    assert (state_ == State::eS_None);
+    base_.SetBudget(budget);
+    workerGroup_->SetBudget(budget);
+}
+
+void Application::SetTimerBackend(TimerBackend backend) {
+    assert (state_ == State::eS_None);
+    base_.SetTimerBackend(backend);
+    workerGroup_->SetTimerBackend(backend);
+}
+
+void Application::EnableWatchdog(DurationMs budget, bool backtrace, int signo) {
+    assert (state_ == State::eS_None);
+    watchdog_.reset(new Watchdog(budget));
+    watchdog_->EnableBacktrace(backtrace, signo);
+    workerGroup_->SetWatchdog(watchdog_.get());
 }
 
 size_t Application::NumOfWorker() const {
@@ -76,24 +101,39 @@ void Application::Run(int ac, char* av[]) {
     }
 
     state_ = State::eS_Started;
+    if (watchdog_) {
+        watchdog_->Watch(BaseLoop());
+        watchdog_->Start();
+    }
+
     workerGroup_->Start();
 
     BaseLoop()->Run();
+    workerGroup_->Stop();
 
     baseGroup_->Wait();
     printf("Stopped BaseEventLoopGroup ...\n");
 
     workerGroup_->Wait();
     printf("Stopped WorkerEventLoopGroup...\n");
+
+    if (watchdog_) {
+        watchdog_->Unwatch(BaseLoop());
+        watchdog_->Stop();
+    }
 }
 
 void Application::Exit() {
     if (state_ == State::eS_Stopped)
         return;
 
+    // May be in signal handler: only set flags and wake up base_,
+    // workers are stopped by Run when base_ returns.
     state_ = State::eS_Stopped;
-    baseGroup_->Stop();
-    workerGroup_->Stop();
+    baseGroup_->MarkStopped();
+
+    // base_ is not in baseGroup_'s loops
+    base_.Wakeup();
 }
 
 bool Application::IsExit() const {
@@ -115,11 +155,18 @@ void Application::SetOnExit(std::function<void ()> onexit) {
 void Application::Listen(const SocketAddr& listenAddr,
                          NewTcpConnCallback cb,
                          BindCallback bfcb) {
+    Listen(listenAddr, std::move(cb), LoadBalance::eRoundRobin, std::move(bfcb));
+}
+
+void Application::Listen(const SocketAddr& listenAddr,
+                         NewTcpConnCallback cb,
+                         LoadBalance lb,
+                         BindCallback bfcb) {
 	cout<<"BaseLoop listen"<<endl;
     auto loop = BaseLoop();
-    loop->Execute([loop, listenAddr, cb, bfcb]() {
+    loop->Dispatch([loop, listenAddr, cb, bfcb, lb]() {
 		cout<<"loop->Execute Application::Listen"<<endl;
-        if (!loop->Listen(listenAddr, std::move(cb)))
+        if (!loop->Listen(listenAddr, std::move(cb), lb))
             bfcb(false, listenAddr);
         else
             bfcb(true, listenAddr);
@@ -134,12 +181,21 @@ void Application::Listen(const char* ip,
     Listen(addr, std::move(cb), std::move(bfcb));
 }
 
+void Application::Listen(const char* ip,
+                         uint16_t hostPort,
+                         NewTcpConnCallback cb,
+                         LoadBalance lb,
+                         BindCallback bfcb) {
+    SocketAddr addr(ip, hostPort);
+    Listen(addr, std::move(cb), lb, std::move(bfcb));
+}
+
 void Application::ListenUDP(const SocketAddr& addr,
                             UDPMessageCallback mcb,
                             UDPCreateCallback ccb,
                             BindCallback bfcb) {
     auto loop = BaseLoop();
-    loop->Execute([loop, addr, mcb, ccb, bfcb]() {
+    loop->Dispatch([loop, addr, mcb, ccb, bfcb]() {
         if (!loop->ListenUDP(addr, std::move(mcb), std::move(ccb)))
             bfcb(false, addr);
         else
@@ -158,7 +214,7 @@ void Application::ListenUDP(const char* ip, uint16_t hostPort,
 void Application::CreateClientUDP(UDPMessageCallback mcb,
                                   UDPCreateCallback ccb) {
     auto loop = BaseLoop();
-    loop->Execute([loop, mcb, ccb]() {
+    loop->Dispatch([loop, mcb, ccb]() {
         loop->CreateClientUDP(std::move(mcb), std::move(ccb));
     });
 }
@@ -169,7 +225,7 @@ void Application::Connect(const SocketAddr& dst,
                           DurationMs timeout,
                           EventLoop* dstLoop) {
     auto loop = BaseLoop();
-    loop->Execute([loop, dst, nccb, cfcb, timeout, dstLoop]() {
+    loop->Dispatch([loop, dst, nccb, cfcb, timeout, dstLoop]() {
         loop->Connect(dst,
                       std::move(nccb),
                       std::move(cfcb),
@@ -198,6 +254,14 @@ EventLoop* Application::Next() {
     return BaseLoop();
 }
 
+EventLoop* Application::Next(LoadBalance lb, const SocketAddr& peer) {
+    auto loop = workerGroup_->Next(lb, peer);
+    if (loop)
+        return loop;
+
+    return BaseLoop();
+}
+
 Application::Application() :
     baseGroup_(new internal::EventLoopGroup(0)),
     base_(baseGroup_.get()),
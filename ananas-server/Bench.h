@@ -0,0 +1,102 @@
+#ifndef BERT_BENCH_H
+#define BERT_BENCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+// Helpers for *Bench.cc programs, see `make bench`.
+// Numbers depend on the machine, compare rows of one run only.
+
+namespace ananas {
+
+namespace bench {
+
+class Stopwatch {
+public:
+    Stopwatch() :
+        start_(std::chrono::steady_clock::now()) {
+    }
+
+    double Seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// user + system CPU of this process
+inline double CpuSeconds() {
+    rusage r;
+    getrusage(RUSAGE_SELF, &r);
+    return r.ru_utime.tv_sec + r.ru_utime.tv_usec / 1e6 +
+           r.ru_stime.tv_sec + r.ru_stime.tv_usec / 1e6;
+}
+
+// A connected pair of TCP sockets over loopback: fds[0] accepted, fds[1] connecting
+inline void TcpPair(int fds[2]) {
+    const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof addr;
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+        ::listen(listener, 1) != 0 ||
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        perror("listen");
+        ::exit(1);
+    }
+
+    fds[1] = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(fds[1], reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+        perror("connect");
+        ::exit(1);
+    }
+
+    fds[0] = ::accept(listener, nullptr, nullptr);
+    ::close(listener);
+}
+
+#if defined(ANANAS_BENCH_COUNT_ALLOCS)
+// Define it before including me to count operator new of all threads,
+// only in the one source file of a bench.
+std::atomic<uint64_t> g_allocations {0};
+
+inline uint64_t Allocations() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+#endif
+
+} // end namespace bench
+
+} // end namespace ananas
+
+#if defined(ANANAS_BENCH_COUNT_ALLOCS)
+void* operator new(std::size_t size) {
+    ananas::bench::g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t ) noexcept {
+    std::free(p);
+}
+#endif
+
+#endif
+
@@ -0,0 +1,163 @@
+#include <new>
+#include <cassert>
+
+#include "BufferPool.h"
+
+namespace ananas {
+
+namespace internal {
+
+constexpr int BufferPool::kMinShift;
+constexpr int BufferPool::kMaxShift;
+constexpr std::size_t BufferPool::kDefaultLimit;
+constexpr int BufferPool::kClasses;
+
+static thread_local BufferPool* g_pool = nullptr;
+
+BufferPool* BufferPool::Current() {
+    return g_pool;
+}
+
+void BufferPool::SetCurrent(BufferPool* pool) {
+    g_pool = pool;
+}
+
+BufferPool::BufferPool() :
+    limit_(kDefaultLimit) {
+}
+
+BufferPool::~BufferPool() {
+    if (g_pool == this)
+        g_pool = nullptr;
+
+    for (int cls = 0; cls < kClasses; ++ cls)
+        _Release(cls, classes_[cls].count);
+}
+
+int BufferPool::_ClassOf(std::size_t size) {
+    if (size <= (std::size_t(1) << kMinShift))
+        return 0;
+
+    const int shift = 64 - __builtin_clzll(size - 1);
+    return shift <= kMaxShift ? shift - kMinShift : -1;
+}
+
+char* BufferPool::Allocate(std::size_t& size) {
+    const int cls = _ClassOf(size);
+    if (cls < 0)
+        return static_cast<char*>(::operator new(size));
+
+    size = std::size_t(1) << (cls + kMinShift);
+
+    BufferPool* pool = g_pool;
+    if (pool) {
+        _Add(pool->allocs_, 1);
+        if (char* block = pool->_Pop(cls)) {
+            _Add(pool->hits_, 1);
+            return block;
+        }
+    }
+
+    return static_cast<char*>(::operator new(size));
+}
+
+void BufferPool::Free(char* block, std::size_t size) {
+    if (!block)
+        return;
+
+    BufferPool* pool = g_pool;
+    if (pool) {
+        _Add(pool->frees_, 1);
+
+        const int cls = _ClassOf(size);
+        if (cls >= 0 && size == (std::size_t(1) << (cls + kMinShift)) &&
+            pool->_Push(cls, block))
+            return;
+    }
+
+    ::operator delete(block);
+}
+
+char* BufferPool::_Pop(int cls) {
+    SizeClass& c = classes_[cls];
+    if (!c.head)
+        return nullptr;
+
+    FreeBlock* block = c.head;
+    c.head = block->next;
+    -- c.count;
+    if (c.count < c.lowWater)
+        c.lowWater = c.count;
+
+    _Add(retainedBytes_, -(int64_t(1) << (cls + kMinShift)));
+    return reinterpret_cast<char*>(block);
+}
+
+bool BufferPool::_Push(int cls, char* block) {
+    const std::size_t size = std::size_t(1) << (cls + kMinShift);
+    if (retainedBytes_.load(std::memory_order_relaxed) + size > limit_)
+        return false;
+
+    SizeClass& c = classes_[cls];
+    FreeBlock* b = reinterpret_cast<FreeBlock*>(block);
+    b->next = c.head;
+    c.head = b;
+    ++ c.count;
+
+    _Add(retainedBytes_, size);
+    return true;
+}
+
+void BufferPool::_Release(int cls, std::size_t n) {
+    SizeClass& c = classes_[cls];
+    assert (n <= c.count);
+
+    const std::size_t size = std::size_t(1) << (cls + kMinShift);
+    for (std::size_t i = 0; i < n; ++ i) {
+        FreeBlock* block = c.head;
+        c.head = block->next;
+        ::operator delete(block);
+    }
+
+    c.count -= n;
+    if (c.lowWater > c.count)
+        c.lowWater = c.count;
+
+    _Add(retainedBytes_, -static_cast<int64_t>(n * size));
+    _Add(trimmedBytes_, n * size);
+}
+
+void BufferPool::SetLimit(std::size_t bytes) {
+    limit_ = bytes;
+
+    // release from the largest class
+    for (int cls = kClasses - 1; cls >= 0 &&
+         retainedBytes_.load(std::memory_order_relaxed) > limit_; -- cls)
+        _Release(cls, classes_[cls].count);
+}
+
+void BufferPool::Trim() {
+    // blocks never taken since last trim are idle
+    for (int cls = 0; cls < kClasses; ++ cls) {
+        SizeClass& c = classes_[cls];
+        if (c.lowWater > 0)
+            _Release(cls, c.lowWater);
+
+        c.lowWater = c.count;
+    }
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+    Stats stats;
+    stats.allocs = allocs_.load(std::memory_order_relaxed);
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.frees = frees_.load(std::memory_order_relaxed);
+    stats.trimmedBytes = trimmedBytes_.load(std::memory_order_relaxed);
+    stats.retainedBytes = retainedBytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
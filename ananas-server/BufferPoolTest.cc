@@ -0,0 +1,208 @@
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "net/Connection.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "net/ReadSizer.h"
+#include "util/BufferPool.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+using ananas::internal::BufferPool;
+
+TEST_CASE(SizeClasses) {
+    BufferPool pool;
+    BufferPool::SetCurrent(&pool);
+
+    std::size_t size = 1;
+    char* a = BufferPool::Allocate(size);
+    EXPECT_EQ(size, 64u);
+
+    size = 1000;
+    char* b = BufferPool::Allocate(size);
+    EXPECT_EQ(size, 1024u);
+
+    // not pooled, size kept
+    size = (1 << BufferPool::kMaxShift) + 1;
+    char* c = BufferPool::Allocate(size);
+    EXPECT_EQ(size, (1u << BufferPool::kMaxShift) + 1);
+
+    BufferPool::Free(a, 64);
+    BufferPool::Free(b, 1024);
+    BufferPool::Free(c, size);
+    EXPECT_EQ(pool.GetStats().retainedBytes, 64u + 1024u);
+
+    BufferPool::SetCurrent(nullptr);
+}
+
+TEST_CASE(Reuse) {
+    BufferPool pool;
+    BufferPool::SetCurrent(&pool);
+
+    std::size_t size = 4096;
+    char* a = BufferPool::Allocate(size);
+    BufferPool::Free(a, size);
+
+    size = 3000;
+    char* b = BufferPool::Allocate(size);
+    EXPECT_TRUE(b == a);
+    EXPECT_EQ(size, 4096u);
+    BufferPool::Free(b, size);
+
+    const auto stats = pool.GetStats();
+    EXPECT_EQ(stats.allocs, 2u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.frees, 2u);
+
+    BufferPool::SetCurrent(nullptr);
+}
+
+TEST_CASE(Limit) {
+    BufferPool pool;
+    pool.SetLimit(8192);
+    BufferPool::SetCurrent(&pool);
+
+    char* blocks[4];
+    for (auto& b : blocks) {
+        std::size_t size = 4096;
+        b = BufferPool::Allocate(size);
+    }
+    for (auto b : blocks)
+        BufferPool::Free(b, 4096);
+
+    EXPECT_EQ(pool.GetStats().retainedBytes, 8192u);
+
+    BufferPool::SetCurrent(nullptr);
+}
+
+// only blocks unused for a whole trim period are released
+TEST_CASE(TrimIdle) {
+    BufferPool pool;
+    BufferPool::SetCurrent(&pool);
+
+    char* blocks[4];
+    for (auto& b : blocks) {
+        std::size_t size = 1024;
+        b = BufferPool::Allocate(size);
+    }
+    for (auto b : blocks)
+        BufferPool::Free(b, 1024);
+
+    pool.Trim(); // starts the period
+    EXPECT_EQ(pool.GetStats().retainedBytes, 4096u);
+
+    // one of them is busy in this period
+    std::size_t size = 1024;
+    char* busy = BufferPool::Allocate(size);
+    BufferPool::Free(busy, size);
+
+    pool.Trim();
+    EXPECT_EQ(pool.GetStats().retainedBytes, 1024u);
+    EXPECT_EQ(pool.GetStats().trimmedBytes, 3072u);
+
+    BufferPool::SetCurrent(nullptr);
+}
+
+TEST_CASE(NoPool) {
+    std::size_t size = 100;
+    char* a = BufferPool::Allocate(size);
+    EXPECT_EQ(size, 128u);
+
+    // freed by thread with pool, kept there
+    BufferPool pool;
+    std::thread t([&]() {
+        BufferPool::SetCurrent(&pool);
+        BufferPool::Free(a, size);
+        BufferPool::SetCurrent(nullptr);
+    });
+    t.join();
+
+    EXPECT_EQ(pool.GetStats().retainedBytes, 128u);
+}
+
+namespace {
+
+const int kPings = 10;
+// 4 bytes a read, recvBuf_ is only reallocated when read size shrinks
+const uint64_t kShrinks = (kPings - 1) / internal::ReadSizer::kShrinkAfter;
+
+struct RecvAllocs {
+    uint64_t reading = 0;   // by kPings drained reads
+    uint64_t afterIdle = 0; // by one read after idle trims
+};
+
+// Connection of a loop reads kPings messages one by one, each read drains
+// recvBuf_, then idles for idle, then reads one more.
+RecvAllocs PingPong(std::chrono::milliseconds idle) {
+    internal::EventLoopGroup group(0);
+    RecvAllocs allocs;
+
+    // one loop per thread
+    std::thread t([&]() {
+        EventLoop loop(&group);
+
+        int fds[2];
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        ::fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        const int peer = fds[1];
+
+        auto conn = std::make_shared<Connection>(&loop);
+        conn->Init(fds[0], SocketAddr());
+        loop.Register(internal::eET_Read, conn);
+
+        int pings = 0;
+        uint64_t start = 0;
+        conn->SetOnMessage([&](Connection* , const char* , PacketLen_t len) {
+            ++ pings;
+            if (pings < kPings) {
+                if (pings == 1)
+                    start = loop.GetStats().bufferAllocs;
+                // after this read sees EAGAIN
+                loop.Post([peer]() {
+                    ::write(peer, "ping", 4);
+                });
+            } else if (pings == kPings) {
+                allocs.reading = loop.GetStats().bufferAllocs - start;
+                loop.ScheduleAfter(idle, [&]() {
+                    start = loop.GetStats().bufferAllocs;
+                    ::write(peer, "ping", 4);
+                });
+            } else {
+                allocs.afterIdle = loop.GetStats().bufferAllocs - start;
+                group.Stop();
+            }
+
+            return len;
+        });
+
+        ::write(peer, "ping", 4);
+        loop.Run();
+        ::close(peer);
+    });
+    t.join();
+
+    return allocs;
+}
+
+} // end namespace
+
+TEST_CASE(RecvBufferKeptWhileReading) {
+    const RecvAllocs allocs = PingPong(std::chrono::milliseconds(1));
+    EXPECT_EQ(allocs.reading, kShrinks);
+    EXPECT_EQ(allocs.afterIdle, 0u);
+}
+
+TEST_CASE(RecvBufferReleasedWhenIdle) {
+    // trim runs every 1s, slack 0.5s; idle after the second one
+    const RecvAllocs allocs = PingPong(std::chrono::milliseconds(3000));
+    EXPECT_EQ(allocs.reading, kShrinks);
+    EXPECT_EQ(allocs.afterIdle, 1u);
+}
+
+TEST_MAIN()
@@ -0,0 +1,153 @@
+#include <string>
+#include <sys/uio.h>
+
+#include "util/Buffer.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+
+namespace {
+
+// all bytes in order
+std::string Content(const BufferVector& vec) {
+    std::string s;
+    for (const auto& buf : vec)
+        s.append(buf.ReadAddr(), buf.ReadableSize());
+
+    return s;
+}
+
+Buffer Make(const std::string& s) {
+    Buffer buf;
+    buf.PushData(s.data(), s.size());
+    return buf;
+}
+
+} // end namespace
+
+TEST_CASE(MergeSmall) {
+    BufferVector vec;
+    std::string expect;
+    for (int i = 0; i < 1000; ++ i) {
+        const std::string s = std::to_string(i) + ",";
+        vec.Push(s.data(), s.size());
+        expect += s;
+    }
+
+    EXPECT_EQ(vec.TotalBytes(), expect.size());
+    // small writes share a chunk
+    EXPECT_EQ(vec.Size(), 1u);
+    EXPECT_TRUE(Content(vec) == expect);
+
+    // not merged beyond a chunk
+    const std::string big(BufferVector::kChunkSize, 'x');
+    vec.Push(Make(big));
+    EXPECT_EQ(vec.Size(), 2u);
+    EXPECT_TRUE(Content(vec) == expect + big);
+
+    vec.Push(Buffer()); // empty one is dropped
+    EXPECT_EQ(vec.Size(), 2u);
+}
+
+// push and pop around the ring many times, order is kept
+TEST_CASE(WrapAround) {
+    BufferVector vec;
+    const std::string big(BufferVector::kChunkSize, 'a');
+
+    int pushed = 0, popped = 0;
+    for (int i = 0; i < 5; ++ i)
+        vec.Push(Make(big + std::to_string(pushed ++)));
+
+    for (int round = 0; round < 100; ++ round) {
+        EXPECT_TRUE(Content(vec).compare(0, big.size(), big) == 0);
+        const std::string front(vec.Front().ReadAddr(), vec.Front().ReadableSize());
+        EXPECT_TRUE(front == big + std::to_string(popped ++));
+        vec.Pop();
+
+        vec.Push(Make(big + std::to_string(pushed ++)));
+        EXPECT_EQ(vec.Size(), 5u);
+    }
+
+    EXPECT_EQ(vec.TotalBytes(), 5 * (big.size() + 3));
+}
+
+// grow when head is not at slot 0
+TEST_CASE(GrowKeepsOrder) {
+    BufferVector vec;
+    const std::string big(BufferVector::kChunkSize, 'b');
+
+    int pushed = 0, popped = 0;
+    for (int i = 0; i < 6; ++ i)
+        vec.Push(Make(big + std::to_string(pushed ++)));
+    for (int i = 0; i < 3; ++ i, ++ popped)
+        vec.Pop();
+
+    // 3 left, 8 slots; wrap then grow twice
+    for (int i = 0; i < 30; ++ i)
+        vec.Push(Make(big + std::to_string(pushed ++)));
+
+    EXPECT_EQ(vec.Size(), 33u);
+    for (const auto& buf : vec) {
+        const std::string s(buf.ReadAddr(), buf.ReadableSize());
+        EXPECT_TRUE(s == big + std::to_string(popped ++));
+    }
+    EXPECT_EQ(popped, pushed);
+}
+
+TEST_CASE(ConsumePartial) {
+    BufferVector vec;
+    vec.Push(Make("hello "));
+    vec.Push(Make(std::string(BufferVector::kChunkSize, 'w')));
+    vec.Push(Make("!"));
+
+    vec.Consume(3);
+    EXPECT_EQ(vec.Size(), 3u);
+    EXPECT_EQ(vec.TotalBytes(), 3 + BufferVector::kChunkSize + 1);
+
+    // first one gone, second one partially
+    vec.Consume(3 + 10);
+    EXPECT_EQ(vec.Size(), 2u);
+    EXPECT_EQ(vec.Front().ReadableSize(), BufferVector::kChunkSize - 10);
+
+    vec.Consume(vec.TotalBytes());
+    EXPECT_TRUE(vec.Empty());
+    EXPECT_EQ(vec.TotalBytes(), 0u);
+}
+
+TEST_CASE(Gather) {
+    BufferVector vec;
+    const std::string big(BufferVector::kChunkSize, 'g');
+    for (int i = 0; i < 4; ++ i)
+        vec.Push(Make(big));
+    vec.Consume(100);
+
+    struct iovec iov[8];
+    std::size_t bytes = 0;
+    EXPECT_EQ(vec.Gather(iov, 2, &bytes), 2);
+    EXPECT_EQ(bytes, 2 * big.size() - 100);
+    EXPECT_EQ(iov[0].iov_len, big.size() - 100);
+
+    EXPECT_EQ(vec.Gather(iov, 8, &bytes), 4);
+    EXPECT_EQ(bytes, vec.TotalBytes());
+}
+
+TEST_CASE(Move) {
+    BufferVector a;
+    a.Push(Make("abc"));
+    a.Push(Make(std::string(BufferVector::kChunkSize, 'm')));
+
+    BufferVector b(std::move(a));
+    EXPECT_TRUE(a.Empty());
+    EXPECT_EQ(a.TotalBytes(), 0u);
+    EXPECT_EQ(b.Size(), 2u);
+
+    // moved-from one is usable
+    a.Push(Make("xyz"));
+    EXPECT_TRUE(Content(a) == "xyz");
+
+    a = std::move(b);
+    EXPECT_EQ(a.Size(), 2u);
+    EXPECT_EQ(a.TotalBytes(), 3 + BufferVector::kChunkSize);
+}
+
+TEST_MAIN()
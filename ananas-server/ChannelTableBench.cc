@@ -0,0 +1,133 @@
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "net/ChannelTable.h"
+#include "Bench.h"
+
+// Channel churn: register and unregister channels on reused fds while
+// dispatching events, ChannelTable against the std::map keyed by a
+// per-loop id that EventLoop used before.
+
+using ananas::internal::Channel;
+using ananas::internal::ChannelTable;
+using ananas::bench::Stopwatch;
+
+namespace {
+
+const int kOps = 2 * 1000 * 1000;
+const int kEventsPerOp = 4;
+
+class FakeChannel : public Channel {
+public:
+    explicit FakeChannel(int fd) : fd_(fd) {
+    }
+
+    int Identifier() const override {
+        return fd_;
+    }
+
+    bool HandleReadEvent() override {
+        return true;
+    }
+    bool HandleWriteEvent() override {
+        return true;
+    }
+    void HandleErrorEvent() override {
+    }
+
+private:
+    int fd_;
+};
+
+// two channels per fd, one is registered while the other is closed
+using Channels = std::vector<std::shared_ptr<FakeChannel> >;
+
+Channels MakeChannels(int live) {
+    Channels channels;
+    for (int i = 0; i < 2 * live; ++ i)
+        channels.push_back(std::make_shared<FakeChannel>(i % live));
+
+    return channels;
+}
+
+double ChurnTable(int live) {
+    Channels channels = MakeChannels(live);
+    ChannelTable table;
+    std::vector<uint64_t> tokens(live);
+    for (int fd = 0; fd < live; ++ fd) {
+        table.Insert(channels[fd]);
+        tokens[fd] = ChannelTable::Token(channels[fd].get());
+    }
+
+    std::mt19937 rand(1);
+    std::size_t found = 0;
+    Stopwatch watch;
+    for (int i = 0; i < kOps; ++ i) {
+        const int fd = static_cast<int>(rand() % live);
+        const int which = (table.Get(tokens[fd]) == channels[fd].get()) ? 0 : 1;
+        table.Erase(channels[fd + which * live].get());
+        table.Insert(channels[fd + (1 - which) * live]);
+        tokens[fd] = ChannelTable::Token(channels[fd + (1 - which) * live].get());
+
+        // dispatch events to random channels
+        for (int e = 0; e < kEventsPerOp; ++ e)
+            found += table.Get(tokens[rand() % live]) != nullptr;
+    }
+
+    const double seconds = watch.Seconds();
+    if (found != std::size_t(kOps) * kEventsPerOp)
+        printf("table lookup failed\n");
+
+    return seconds * 1e9 / kOps;
+}
+
+double ChurnMap(int live) {
+    Channels channels = MakeChannels(live);
+    std::map<unsigned int, std::shared_ptr<Channel> > map;
+    unsigned int id = 0;
+    std::vector<unsigned int> ids(live);
+    for (int fd = 0; fd < live; ++ fd) {
+        ids[fd] = ++ id;
+        channels[fd]->SetUniqueId(ids[fd]);
+        map.insert({ids[fd], channels[fd]});
+    }
+
+    std::mt19937 rand(1);
+    std::size_t found = 0;
+    Stopwatch watch;
+    for (int i = 0; i < kOps; ++ i) {
+        const int fd = static_cast<int>(rand() % live);
+        const int which = (channels[fd]->GetUniqueId() == ids[fd]) ? 0 : 1;
+        map.erase(ids[fd]);
+
+        auto& next = channels[fd + (1 - which) * live];
+        ids[fd] = ++ id;
+        next->SetUniqueId(ids[fd]);
+        map.insert({ids[fd], next});
+
+        // events carried the channel pointer, no lookup
+        for (int e = 0; e < kEventsPerOp; ++ e)
+            found += channels[rand() % live] != nullptr;
+    }
+
+    const double seconds = watch.Seconds();
+    if (found != std::size_t(kOps) * kEventsPerOp)
+        printf("map lookup failed\n");
+
+    return seconds * 1e9 / kOps;
+}
+
+} // end namespace
+
+int main() {
+    printf("%-14s %12s %12s\n", "live channels", "map ns/op", "table ns/op");
+    for (int live : {100, 10000, 100000}) {
+        const double map = ChurnMap(live);
+        const double table = ChurnTable(live);
+        printf("%-14d %12.1f %12.1f\n", live, map, table);
+    }
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "net/ChannelTable.h"
+#include "UnitTest.h"
+
+using ananas::internal::Channel;
+using ananas::internal::ChannelTable;
+using ananas::internal::TrimList;
+
+namespace {
+
+class FakeChannel : public Channel {
+public:
+    explicit FakeChannel(int fd) : fd_(fd) {
+    }
+
+    int Identifier() const override {
+        return fd_;
+    }
+
+    bool HandleReadEvent() override {
+        return true;
+    }
+    bool HandleWriteEvent() override {
+        return true;
+    }
+    void HandleErrorEvent() override {
+    }
+
+private:
+    int fd_;
+};
+
+} // end namespace
+
+TEST_CASE(InsertErase) {
+    ChannelTable table;
+    EXPECT_TRUE(table.Empty());
+
+    auto a = std::make_shared<FakeChannel>(3);
+    auto b = std::make_shared<FakeChannel>(1000);
+    EXPECT_TRUE(table.Insert(a));
+    EXPECT_TRUE(table.Insert(b));
+    EXPECT_EQ(table.Size(), 2u);
+    EXPECT_TRUE(table.Contains(a.get()));
+    EXPECT_TRUE(table.Contains(b.get()));
+
+    EXPECT_TRUE(table.Get(ChannelTable::Token(a.get())) == a.get());
+    EXPECT_TRUE(table.Get(ChannelTable::Token(b.get())) == b.get());
+
+    auto owner = table.Erase(a.get());
+    EXPECT_TRUE(owner == a);
+    EXPECT_TRUE(!table.Contains(a.get()));
+    EXPECT_TRUE(table.Erase(a.get()) == nullptr);
+    EXPECT_EQ(table.Size(), 1u);
+}
+
+TEST_CASE(RejectInvalid) {
+    ChannelTable table;
+    EXPECT_TRUE(!table.Insert(std::make_shared<FakeChannel>(-1)));
+
+    EXPECT_TRUE(table.Insert(std::make_shared<FakeChannel>(5)));
+    // fd occupied
+    EXPECT_TRUE(!table.Insert(std::make_shared<FakeChannel>(5)));
+    EXPECT_EQ(table.Size(), 1u);
+
+    FakeChannel unknown(7);
+    EXPECT_TRUE(!table.Contains(&unknown));
+    EXPECT_TRUE(table.Erase(&unknown) == nullptr);
+}
+
+TEST_CASE(StaleToken) {
+    ChannelTable table;
+    auto old = std::make_shared<FakeChannel>(8);
+    table.Insert(old);
+    const uint64_t staleToken = ChannelTable::Token(old.get());
+    table.Erase(old.get());
+
+    // reuse fd 8, event fired for the old channel must not reach it
+    auto reuse = std::make_shared<FakeChannel>(8);
+    EXPECT_TRUE(table.Insert(reuse));
+    EXPECT_TRUE(reuse->GetUniqueId() != old->GetUniqueId());
+    EXPECT_TRUE(table.Get(staleToken) == nullptr);
+    EXPECT_TRUE(table.Get(ChannelTable::Token(reuse.get())) == reuse.get());
+
+    // the old one is not contained though fd is the same
+    EXPECT_TRUE(!table.Contains(old.get()));
+    EXPECT_TRUE(table.Erase(old.get()) == nullptr);
+    EXPECT_EQ(table.Size(), 1u);
+
+    // token beyond table
+    EXPECT_TRUE(table.Get((uint64_t(1) << 32) | 100000) == nullptr);
+}
+
+TEST_CASE(ForEachAndClear) {
+    ChannelTable table;
+    for (int fd = 0; fd < 100; fd += 3)
+        table.Insert(std::make_shared<FakeChannel>(fd));
+
+    int n = 0;
+    int lastFd = -1;
+    bool ordered = true;
+    table.ForEach([&](Channel* c) {
+        ++ n;
+        if (c->Identifier() <= lastFd)
+            ordered = false;
+        lastFd = c->Identifier();
+    });
+    EXPECT_EQ(n, 34);
+    EXPECT_TRUE(ordered);
+
+    auto c = std::make_shared<FakeChannel>(3);
+    table.Clear();
+    EXPECT_TRUE(table.Empty());
+
+    // generations survive Clear
+    EXPECT_TRUE(table.Insert(c));
+    EXPECT_EQ(c->GetUniqueId(), 2u);
+}
+
+TEST_CASE(TrimListLinks) {
+    FakeChannel a(1), b(2), c(3);
+    TrimList list;
+
+    list.Push(&a);
+    list.Push(&b);
+    list.Push(&c);
+    list.Push(&b); // already in
+    EXPECT_EQ(list.Size(), 3u);
+    EXPECT_TRUE(list.Contains(&b));
+
+    // middle, then head and tail
+    list.Erase(&b);
+    EXPECT_TRUE(!list.Contains(&b));
+    list.Erase(&b); // not in
+    EXPECT_EQ(list.Size(), 2u);
+
+    int seen = 0;
+    list.Filter([&seen](Channel* ch) {
+        seen += ch->Identifier();
+        return ch->Identifier() == 1;
+    });
+    EXPECT_EQ(seen, 1 + 3);
+    EXPECT_EQ(list.Size(), 1u);
+    EXPECT_TRUE(list.Contains(&a) && !list.Contains(&c));
+
+    list.Push(&c);
+    list.Clear();
+    EXPECT_EQ(list.Size(), 0u);
+    EXPECT_TRUE(!list.Contains(&a) && !list.Contains(&c));
+
+    // relinked after clear
+    list.Push(&a);
+    EXPECT_EQ(list.Size(), 1u);
+    list.Clear();
+}
+
+TEST_MAIN()
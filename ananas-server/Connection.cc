@@ -1,14 +1,28 @@
+#include <algorithm>
 #include <cassert>
+#include <climits>
 
 #include <errno.h>
 #include <unistd.h>
 #include <sys/uio.h>
+#if defined(__gnu_linux__)
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#endif
+
+#if defined(__gnu_linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define ANANAS_ZEROCOPY 1
+#endif
 
 #include "EventLoop.h"
 #include "Connection.h"
 #include "AnanasDebug.h"
 #include "util/Util.h"
 
+#include <iostream>
+using namespace std;
+
 namespace ananas {
 
 using internal::eET_Read;
@@ -24,8 +38,31 @@ Connection::Connection(EventLoop* loop) :
 Connection::~Connection() {
     if (localSock_ != kInvalid) {
         Shutdown(ShutdownMode::eSM_Both); // Force send FIN
+        // the last completions, before they're lost with socket
+        if (zeroCopyThreshold_ != 0)
+            _ReapZeroCopy();
         CloseSocket(localSock_);
     }
+
+    _ClearSendQueue();
+
+    // socket is closed, no more completion
+    std::deque<ZeroCopyRelease> aborted;
+    aborted.swap(zcReleases_);
+    for (auto& e : aborted) {
+        if (e.release)
+            e.release(ZeroCopyStatus::eZC_Aborted);
+    }
+}
+
+void Connection::_ClearSendQueue() {
+    sendBuf_.Clear();
+
+    // release may send again
+    std::deque<Segment> segments;
+    segments.swap(segments_);
+    for (auto& seg : segments)
+        _FinishSegment(seg);
 }
 
 bool Connection::Init(int fd, const SocketAddr& peer) {
@@ -57,18 +94,18 @@ void Connection::Shutdown(ShutdownMode mode) {
         break;
 
     case ShutdownMode::eSM_Write:
-        if (!sendBuf_.Empty()) {
+        if (_HasPendingSend()) {
             ANANAS_WRN << localSock_ << " shutdown write, but still has data to send";
-            sendBuf_.Clear();
+            _ClearSendQueue();
         }
 
         ::shutdown(localSock_, SHUT_WR);
         break;
 
     case ShutdownMode::eSM_Both:
-        if (!sendBuf_.Empty()) {
+        if (_HasPendingSend()) {
             ANANAS_WRN << localSock_ << " shutdown both, but still has data to send";
-            sendBuf_.Clear();
+            _ClearSendQueue();
         }
 
         ::shutdown(localSock_, SHUT_RDWR);
@@ -100,29 +137,28 @@ bool Connection::HandleReadEvent() {
         }
     };
 
-    bool busy = false;
-    while (true) {
-        recvBuf_.AssureSpace(8 * 1024);
-        char stack[128 * 1024];
+    const LoopBudget& budget = loop_->GetBudget();
+    std::size_t readBytes = 0;
+    std::size_t nMessages = 0;
 
-        struct iovec vecs[2];
-        vecs[0].iov_base = recvBuf_.WriteAddr();
-        vecs[0].iov_len = recvBuf_.WritableSize();
-        vecs[1].iov_base = stack;
-        vecs[1].iov_len = sizeof stack;
+    bool shrink = false;
+    while (true) {
+        // read into buffer directly, its size adapts to the peer
+        recvBuf_.AssureSpace(readSizer_.Guess());
+        const std::size_t space = recvBuf_.WritableSize();
 
-        int bytes = ::readv(localSock_, vecs, 2);
+        int bytes = ::read(localSock_, recvBuf_.WriteAddr(), space);
         if (bytes == kError) {
             if (EAGAIN == errno || EWOULDBLOCK == errno)
-                return true;
+                break;
 
             if (EINTR == errno)
-                continue; // restart ::readv
+                continue; // restart ::read
         }
 
         if (bytes == 0) {
             ANANAS_WRN << localSock_ << " HandleReadEvent EOF ";
-            if (sendBuf_.Empty()) {
+            if (!_HasPendingSend()) {
                 state_ = State::eS_PassiveClose;
             } else {
                 state_ = State::eS_CloseWaitWrite;
@@ -139,36 +175,101 @@ bool Connection::HandleReadEvent() {
             return false;
         }
 
-        if (static_cast<size_t>(bytes) <= vecs[0].iov_len) {
-            recvBuf_.Produce(static_cast<size_t>(bytes));
-        } else {
-            recvBuf_.Produce(vecs[0].iov_len);
+        recvBuf_.Produce(static_cast<size_t>(bytes));
+        if (readSizer_.Record(static_cast<size_t>(bytes), space))
+            shrink = true;
+
+        recvBuf_.Consume(_Deliver(recvBuf_.ReadAddr(), recvBuf_.ReadableSize(), nMessages));
 
-            auto stackBytes = static_cast<size_t>(bytes) - vecs[0].iov_len;
-            recvBuf_.PushData(stack, stackBytes);
+        // Give others a chance, socket may still be readable.
+        readBytes += static_cast<std::size_t>(bytes);
+        if ((budget.readBytes && readBytes >= budget.readBytes) ||
+            (budget.readMessages && nMessages >= budget.readMessages)) {
+            loop_->ContinueRead(this);
+            break;
         }
+    }
 
-        while (recvBuf_.ReadableSize() >= minPacketSize_) {
-			cout<<"Connection::HandleReadEvent onMessage_"<<endl;
-            auto bytes = onMessage_(this,
-                                    recvBuf_.ReadAddr(),
-                                    recvBuf_.ReadableSize());
+    // Keep buffer while reading, idle one is released by HandleIdleTrim
+    if (shrink)
+        recvBuf_.Shrink(readSizer_.Guess());
+    if (recvBuf_.Capacity() > 0)
+        loop_->TrimWhenIdle(this);
 
-            if (bytes == 0) {
-                break;
-            } else {
-                recvBuf_.Consume(bytes);
-                busy = true;
-            }
+    return true;
+}
+
+bool Connection::HandleCompletion(const internal::Completion& c) {
+    if (state_ != State::eS_Connected) {
+        ANANAS_ERR << localSock_ << "[fd] HandleCompletion error state:" << state_;
+        return false;
+    }
+
+    if (c.result == 0) {
+        ANANAS_WRN << localSock_ << " HandleCompletion EOF ";
+        if (!_HasPendingSend()) {
+            state_ = State::eS_PassiveClose;
+        } else {
+            state_ = State::eS_CloseWaitWrite;
+            loop_->Modify(eET_Write, shared_from_this());
         }
+
+        return false;
     }
 
-    if (busy)
-        recvBuf_.Shrink();
+    if (c.result < 0) {
+        ANANAS_ERR << localSock_ << " HandleCompletion Error " << -c.result;
+        state_ = State::eS_Error;
+        return false;
+    }
+
+    processingRead_ = true;
+    ANANAS_DEFER {
+        processingRead_ = false;
+        if (!batchSendBuf_.IsEmpty()) {
+            SendPacket(batchSendBuf_);
+            batchSendBuf_.Clear();
+        }
+    };
+
+    std::size_t nMessages = 0;
+    const std::size_t len = static_cast<std::size_t>(c.result);
+    if (recvBuf_.IsEmpty()) {
+        // data is in poller's buffer, copy only what is not consumed
+        const std::size_t consumed = _Deliver(c.data, len, nMessages);
+        if (consumed < len)
+            recvBuf_.PushData(c.data + consumed, len - consumed);
+    } else {
+        recvBuf_.PushData(c.data, len);
+        recvBuf_.Consume(_Deliver(recvBuf_.ReadAddr(), recvBuf_.ReadableSize(), nMessages));
+    }
+
+    if (recvBuf_.Capacity() > 0)
+        loop_->TrimWhenIdle(this);
 
     return true;
 }
 
+std::size_t Connection::_Deliver(const char* data, std::size_t len, std::size_t& nMessages) {
+    std::size_t consumed = 0;
+    while (len - consumed >= minPacketSize_) {
+			cout<<"Connection::HandleReadEvent onMessage_"<<endl;
+        auto bytes = onMessage_(this, data + consumed, len - consumed);
+        if (bytes == 0)
+            break;
+
+        consumed += bytes;
+        ++ nMessages;
+    }
+
+    return consumed;
+}
+
+bool Connection::HandleIdleTrim() {
+    // release if empty, else compact the partial message
+    recvBuf_.Shrink();
+    return recvBuf_.Capacity() > 0;
+}
 
 int Connection::_Send(const void* data, size_t len) {
     if (len == 0)
@@ -192,9 +293,16 @@ int Connection::_Send(const void* data, size_t len) {
 }
 
 namespace {
-int WriteV(int , const std::vector<iovec>& );
-void ConsumeBufferVectors(BufferVector& , size_t );
-void CollectBuffer(const std::vector<iovec>& , size_t , BufferVector& );
+iovec* IovecArray();
+int WriteV(int , const iovec* , int );
+ssize_t SendFileChunk(int , int , off_t* , size_t );
+void CollectBuffer(const iovec* , int , size_t , BufferVector& );
+
+#if defined(IOV_MAX)
+const int kMaxIovecs = IOV_MAX < 1024 ? IOV_MAX : 1024;
+#else
+const int kMaxIovecs = 1024;
+#endif
 }
 
 bool Connection::HandleWriteEvent() {
@@ -207,33 +315,14 @@ bool Connection::HandleWriteEvent() {
     }
 
     // it's connected or half-close, whatever, we can send.
-
-    size_t expectSend = 0;
-    std::vector<iovec> iovecs;
-    for (auto& e : sendBuf_) {
-        assert (!e.IsEmpty());
-
-        iovec ivc;
-        ivc.iov_base = (void*)(e.ReadAddr());
-        ivc.iov_len = e.ReadableSize();
-
-        iovecs.push_back(ivc);
-        expectSend += e.ReadableSize();
-    }
-
-    int ret = WriteV(localSock_, iovecs);
+    const int ret = _FlushSendQueue();
     if (ret == kError) {
         ANANAS_ERR << localSock_ << " HandleWriteEvent ERROR ";
         state_ = State::eS_Error;
         return false;
     }
 
-    assert (ret >= 0);
-
-    size_t alreadySent = static_cast<size_t>(ret);
-    ConsumeBufferVectors(sendBuf_, alreadySent);
-
-    if (alreadySent == expectSend) {
+    if (ret == 1) {
         loop_->Modify(eET_Read, shared_from_this());
 
         if (onWriteComplete_)
@@ -248,7 +337,258 @@ bool Connection::HandleWriteEvent() {
     return true;
 }
 
+int Connection::_FlushSendQueue() {
+    // At most kMaxIovecs buffers per writev, go on if all of them are sent.
+    iovec* vecs = IovecArray();
+    while (_HasPendingSend()) {
+        if (!segments_.empty() && segments_.front().after == bufSent_) {
+            Segment& seg = segments_.front();
+            const ssize_t bytes = seg.fd != kInvalid ?
+                                  SendFileChunk(localSock_, seg.fd, &seg.offset, seg.len) :
+                                  _SendZeroCopyChunk(seg);
+            if (bytes == kError)
+                return kError;
+            if (bytes == 0)
+                return 0;
+
+            seg.len -= static_cast<std::size_t>(bytes);
+            if (seg.len == 0) {
+                Segment done(std::move(seg));
+                segments_.pop_front();
+                _FinishSegment(done);
+            }
+
+            continue;
+        }
+
+        size_t expectSend = 0;
+        int n = sendBuf_.Gather(vecs, kMaxIovecs, &expectSend);
+
+        // do not send data queued after the next segment
+        if (!segments_.empty() && bufSent_ + expectSend > segments_.front().after) {
+            size_t limit = static_cast<size_t>(segments_.front().after - bufSent_);
+            expectSend = limit;
+            for (int i = 0; i < n; ++ i) {
+                if (limit <= vecs[i].iov_len) {
+                    vecs[i].iov_len = limit;
+                    n = i + 1;
+                    break;
+                }
+
+                limit -= vecs[i].iov_len;
+            }
+        }
+
+        int ret = WriteV(localSock_, vecs, n);
+        if (ret == kError)
+            return kError;
+
+        assert (ret >= 0);
+
+        const size_t alreadySent = static_cast<size_t>(ret);
+        sendBuf_.Consume(alreadySent);
+        bufSent_ += alreadySent;
+        if (alreadySent < expectSend)
+            return 0;
+    }
+
+    return 1;
+}
+
+bool Connection::SendFile(int fd, off_t offset, std::size_t len) {
+    assert (loop_->InThisLoop());
+
+    if (state_ != State::eS_Connected &&
+        state_ != State::eS_CloseWaitWrite)
+        return false;
+
+    if (len == 0)
+        return true;
+
+    const int dupFd = ::dup(fd);
+    if (dupFd == kInvalid) {
+        ANANAS_ERR << localSock_ << " SendFile dup failed, errno " << errno;
+        return false;
+    }
+
+    return _QueueSegment(Segment {dupFd, offset, nullptr, len, 0, false, nullptr});
+}
+
+bool Connection::EnableZeroCopy(std::size_t threshold) {
+#if defined(ANANAS_ZEROCOPY)
+    if (zeroCopyThreshold_ == 0) {
+        int on = 1;
+        if (::setsockopt(localSock_, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof on) == kError) {
+            ANANAS_WRN << localSock_ << " SO_ZEROCOPY failed, errno " << errno;
+            return false;
+        }
+    }
+
+    zeroCopyThreshold_ = std::max<std::size_t>(threshold, 1);
+    return true;
+#else
+    (void)threshold;
+    return false;
+#endif
+}
+
+bool Connection::SendZeroCopy(const void* data, std::size_t len,
+                              UniqueFunction<void (ZeroCopyStatus )> release) {
+    assert (loop_->InThisLoop());
+
+    if (zeroCopyThreshold_ == 0 || len < zeroCopyThreshold_) {
+        const bool ok = SendPacket(data, len);
+        if (release)
+            release(ZeroCopyStatus::eZC_Released);
+        return ok;
+    }
+
+    if (state_ != State::eS_Connected &&
+        state_ != State::eS_CloseWaitWrite) {
+        if (release)
+            release(ZeroCopyStatus::eZC_Released);
+        return false;
+    }
+
+    return _QueueSegment(Segment {kInvalid, 0, static_cast<const char*>(data), len,
+                                  0, false, std::move(release)});
+}
+
+bool Connection::_QueueSegment(Segment&& seg) {
+    // batched packets are before segment
+    if (!batchSendBuf_.IsEmpty()) {
+        sendBuf_.Push(batchSendBuf_.ReadAddr(), batchSendBuf_.ReadableSize());
+        batchSendBuf_.Clear();
+    }
+
+    const bool idle = !_HasPendingSend();
+    seg.after = bufSent_ + sendBuf_.TotalBytes();
+    segments_.push_back(std::move(seg));
+    if (!idle)
+        return true; // in order, HandleWriteEvent will send it
+
+    const int ret = _FlushSendQueue();
+    if (ret == kError) {
+        ANANAS_ERR << localSock_ << " send segment Error";
+        state_ = State::eS_Error;
+        loop_->Modify(eET_Write, shared_from_this());
+        return false;
+    }
+
+    if (ret == 0) {
+        loop_->Modify(eET_Read | eET_Write, shared_from_this());
+    } else {
+        if (onWriteComplete_)
+            onWriteComplete_(this);
+    }
+
+    return true;
+}
+
+ssize_t Connection::_SendZeroCopyChunk(Segment& seg) {
+    int flags = 0;
+#if defined(ANANAS_ZEROCOPY)
+    if (zeroCopyThreshold_ != 0)
+        flags = MSG_ZEROCOPY;
+#endif
+
+    while (true) {
+        ssize_t bytes = ::send(localSock_, seg.data, seg.len, flags);
+        if (bytes > 0) {
+            if (flags != 0) {
+                ++ zcSeq_; // every successful call is numbered
+                seg.zeroCopied = true;
+            }
+
+            seg.data += bytes;
+            return bytes;
+        }
+
+        if (bytes == 0 || EAGAIN == errno || EWOULDBLOCK == errno)
+            return 0;
+
+        if (EINTR == errno)
+            continue; // retry
+
+        if (ENOBUFS == errno && flags != 0) {
+            flags = 0; // too many pages pinned, copy this time
+            continue;
+        }
+
+        return kError;
+    }
+}
+
+void Connection::_FinishSegment(Segment& seg) {
+    if (seg.fd != kInvalid) {
+        ::close(seg.fd);
+    } else if (seg.zeroCopied) {
+        // the last send of seg, kernel may still refer to data
+        zcReleases_.push_back(ZeroCopyRelease {zcSeq_ - 1, std::move(seg.release)});
+        _ReleaseZeroCopied();
+    } else if (seg.release) {
+        seg.release(ZeroCopyStatus::eZC_Released);
+    }
+}
+
+void Connection::_ReleaseZeroCopied() {
+    while (!zcReleases_.empty() &&
+           static_cast<int32_t>(zcReleases_.front().lastSeq - zcCompleted_) < 0) {
+        auto release = std::move(zcReleases_.front().release);
+        zcReleases_.pop_front();
+        if (release)
+            release(ZeroCopyStatus::eZC_Released);
+    }
+}
+
+bool Connection::_ReapZeroCopy() {
+#if defined(ANANAS_ZEROCOPY)
+    bool reaped = false;
+    while (true) {
+        char control[128];
+        msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+
+        if (::recvmsg(localSock_, &msg, MSG_ERRQUEUE) == kError) {
+            if (EINTR == errno)
+                continue;
+
+            break; // EAGAIN, queue is empty
+        }
+
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            const auto* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+
+            // sends [ee_info, ee_data] are done, TCP completes them in order
+            reaped = true;
+            if (static_cast<int32_t>(err->ee_data + 1 - zcCompleted_) > 0)
+                zcCompleted_ = err->ee_data + 1;
+
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                ANANAS_DBG << localSock_ << " zero copy fell back to copy";
+        }
+    }
+
+    _ReleaseZeroCopied();
+    return reaped;
+#else
+    return false;
+#endif
+}
+
 void  Connection::HandleErrorEvent() {
+    // MSG_ZEROCOPY completions are reported as socket error
+    if (zeroCopyThreshold_ != 0 && _ReapZeroCopy() &&
+        (state_ == State::eS_Connected || state_ == State::eS_CloseWaitWrite))
+        return;
+
     ANANAS_ERR << localSock_ << " HandleErrorEvent " << state_;
 
     switch (state_) {
@@ -279,17 +619,22 @@ void  Connection::HandleErrorEvent() {
 bool Connection::SafeSend(const void* data, std::size_t size) {
     if (loop_->InThisLoop())
         return this->SendPacket(data, size);
-    else
-        return SafeSend(std::string((const char*)data, size));
+
+    std::string copy((const char*)data, size);
+    loop_->Post([this, copy = std::move(copy)]() {
+                    this->SendPacket(copy);
+                });
+
+    return true;
 }
 
 bool Connection::SafeSend(const std::string& data) {
     if (loop_->InThisLoop())
         return this->SendPacket(data);
     else
-        loop_->Execute([this, data]() {
-                          this->SendPacket(data);
-                       });
+        loop_->Post([this, data]() {
+                        this->SendPacket(data);
+                    });
 
     return true;
 }
@@ -315,7 +660,7 @@ bool Connection::SendPacket(const void* data, std::size_t size) {
         }
     };
 
-    if (oldSendBytes > 0) {
+    if (_HasPendingSend()) {
         sendBuf_.Push(data, size);
         return true;
     }
@@ -360,70 +705,72 @@ bool Connection::SendPacket(const Buffer& data) {
 // iovec for writev
 namespace {
 
-int WriteV(int sock, const std::vector<iovec>& buffers) {
-    const int kIOVecCount = 64; // be care of IOV_MAX
-
-    size_t sentVecs = 0;
-    size_t sentBytes = 0;
-    while (sentVecs < buffers.size()) {
-        const int vc = std::min<int>(buffers.size() - sentVecs, kIOVecCount);
+// shared by connections of this thread, never used re-entrantly
+iovec* IovecArray() {
+    static thread_local iovec vecs[kMaxIovecs];
+    return vecs;
+}
 
-        int expectBytes = 0;
-        for (size_t i = sentVecs; i < sentVecs + vc; ++ i) {
-            expectBytes += static_cast<int>(buffers[i].iov_len);
-        }
+// return bytes sent, 0 if socket is not writable
+int WriteV(int sock, const iovec* vecs, int count) {
+    assert (count > 0 && count <= kMaxIovecs);
 
-        assert (expectBytes > 0);
-        int bytes = static_cast<int>(::writev(sock, &buffers[sentVecs], vc));
-        assert (bytes != 0);
+    while (true) {
+        int bytes = static_cast<int>(::writev(sock, vecs, count));
+        if (kError != bytes)
+            return bytes;
 
-        if (kError == bytes) {
-            assert (errno != EINVAL);
+        assert (errno != EINVAL);
 
-            if (EAGAIN == errno || EWOULDBLOCK == errno)
-                return static_cast<int>(sentBytes);
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+            return 0;
 
-            if (EINTR == errno)
-                continue; // retry
+        if (EINTR == errno)
+            continue; // retry
 
-            return kError;  // can not send any more
-        } else {
-            assert (bytes > 0);
-            sentBytes += bytes;
-            if (bytes == expectBytes)
-                sentVecs += vc;
-            else
-                return sentBytes;
-        }
+        return kError;  // can not send any more
     }
-
-    return sentBytes;
 }
 
-void ConsumeBufferVectors(BufferVector& buffers, size_t toSkippedBytes) {
-    size_t skippedVecs = 0;
-    for (auto& e : buffers) {
-        assert (e.ReadableSize() > 0);
+// like sendfile, return 0 if socket is not writable
+ssize_t SendFileChunk(int sock, int fd, off_t* offset, size_t len) {
+    // sendfile transfers at most 0x7ffff000 bytes
+    len = std::min<size_t>(len, 1 << 30);
 
-        if (toSkippedBytes >= e.ReadableSize()) {
-            toSkippedBytes -= e.ReadableSize();
-            ++ skippedVecs;
-        } else {
-            if (toSkippedBytes > 0) {
-                e.Consume(toSkippedBytes);
-                buffers.totalBytes -= toSkippedBytes;
-            }
+    while (true) {
+#if defined(__gnu_linux__)
+        ssize_t bytes = ::sendfile(sock, fd, offset, len);
+#else
+        // no zero copy, bounce through stack
+        char buf[64 * 1024];
+        ssize_t bytes = ::pread(fd, buf, std::min(len, sizeof buf), *offset);
+        if (bytes > 0) {
+            bytes = ::send(sock, buf, static_cast<size_t>(bytes), 0);
+            if (bytes > 0)
+                *offset += bytes;
+        }
+#endif
+        if (bytes > 0)
+            return bytes;
 
-            break;
+        if (bytes == 0) {
+            ANANAS_ERR << sock << " SendFile: file is shorter than expected";
+            return kError;
         }
-    }
 
-    while (skippedVecs-- > 0)
-        buffers.Pop();
+        if (EAGAIN == errno || EWOULDBLOCK == errno)
+            return 0;
+
+        if (EINTR == errno)
+            continue; // retry
+
+        return kError;
+    }
 }
 
-void CollectBuffer(const std::vector<iovec>& buffers, size_t skipped, BufferVector& dst) {
-    for (auto e : buffers) {
+void CollectBuffer(const iovec* vecs, int count, size_t skipped, BufferVector& dst) {
+    for (int i = 0; i < count; ++ i) {
+        const iovec& e = vecs[i];
         if (skipped >= e.iov_len) {
             skipped -= e.iov_len;
         } else {
@@ -444,7 +791,7 @@ bool Connection::SendPacket(const BufferVector& data) {
 
     SliceVector s;
     for (const auto& d : data) {
-        s.PushBack(const_cast<Buffer&>(d).ReadAddr(), d.ReadableSize());
+        s.PushBack(d.ReadAddr(), d.ReadableSize());
     }
 
     return SendPacket(s);
@@ -464,7 +811,7 @@ bool Connection::SendPacket(const SliceVector& slices) {
         }
     };
 
-    if (oldSendBytes > 0) {
+    if (_HasPendingSend()) {
         for (const auto& e : slices) {
             sendBuf_.Push(e.data, e.len);
         }
@@ -480,32 +827,45 @@ bool Connection::SendPacket(const SliceVector& slices) {
         return true;
     }
 
-    size_t expectSend = 0;
-    std::vector<iovec> iovecs;
-    for (const auto& e : slices) {
-        if (e.len == 0)
-            continue;
+    iovec* vecs = IovecArray();
+    auto it = slices.begin();
+    bool blocked = false;
+    while (it != slices.end() && !blocked) {
+        int n = 0;
+        size_t expectSend = 0;
+        for (; it != slices.end() && n < kMaxIovecs; ++ it) {
+            if (it->len == 0)
+                continue;
+
+            vecs[n].iov_base = const_cast<void*>(it->data);
+            vecs[n].iov_len = it->len;
+            expectSend += it->len;
+            ++ n;
+        }
 
-        iovec ivc;
-        ivc.iov_base = const_cast<void*>(e.data);
-        ivc.iov_len = e.len;
+        if (n == 0)
+            break;
 
-        iovecs.push_back(ivc);
-        expectSend += e.len;
-    }
+        int ret = WriteV(localSock_, vecs, n);
+        if (ret == kError) {
+            state_ = State::eS_Error;
+            loop_->Modify(eET_Write, shared_from_this());
+            return false;
+        }
 
-    int ret = WriteV(localSock_, iovecs);
-    if (ret == kError) {
-        state_ = State::eS_Error;
-        loop_->Modify(eET_Write, shared_from_this());
-        return false;
+        assert (ret >= 0);
+
+        const size_t alreadySent = static_cast<size_t>(ret);
+        if (alreadySent < expectSend) {
+            CollectBuffer(vecs, n, alreadySent, sendBuf_);
+            blocked = true;
+        }
     }
 
-    assert (ret >= 0);
+    if (blocked) {
+        for (; it != slices.end(); ++ it)
+            sendBuf_.Push(it->data, it->len);
 
-    size_t alreadySent = static_cast<size_t>(ret);
-    if (alreadySent < expectSend) {
-        CollectBuffer(iovecs, alreadySent, sendBuf_);
         loop_->Modify(eET_Read | eET_Write, shared_from_this());
     } else {
         if (onWriteComplete_)
@@ -535,6 +895,9 @@ void Connection::_OnConnect() {
     if (state_ != State::eS_Connected)
         return;
 
+    // let io_uring read for me if possible
+    loop_->StartCompletion(internal::CompletionOp::eRecv, this);
+
     if (onConnect_)
         onConnect_(this);
 }
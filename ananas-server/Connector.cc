@@ -82,7 +82,7 @@ bool Connector::Connect(const SocketAddr& addr, DurationMs timeout, EventLoop* d
             if (timeout != DurationMs::max()) {
                 timeoutId_ = loop_->ScheduleAfterWithRepeat<1>(timeout, [this]() {
                     if (this->state_ != ConnectState::connected) {
-                        this->timeoutId_.reset();
+                        this->timeoutId_ = TimerId();
                         this->_OnFailed();
                     }
                 });
@@ -171,7 +171,7 @@ void Connector::_OnSuccess() {
         }
     };
 
-    loop->Execute(std::move(func));
+    loop->Dispatch(std::move(func));
 }
 
 void Connector::_OnFailed() {
@@ -0,0 +1,101 @@
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+
+#define ANANAS_BENCH_COUNT_ALLOCS
+#include "Bench.h"
+
+// Allocations and time per dispatched event in EventLoop: pipes are kept
+// readable, so every poll fires all of them.
+
+using namespace ananas;
+
+namespace {
+
+const int kPipes = 64;
+const uint64_t kWarmup = 1000 * kPipes;
+const uint64_t kEvents = 1000 * 1000 * 1000 / 100;
+
+struct Counter {
+    internal::EventLoopGroup* group = nullptr;
+    uint64_t events = 0;
+    uint64_t allocs = 0;
+    double cpu = 0;
+    bench::Stopwatch watch;
+    double seconds = 0;
+};
+
+class ReadyPipe : public internal::Channel {
+public:
+    ReadyPipe(int fd, Counter* counter) : fd_(fd), counter_(counter) {
+    }
+
+    ~ReadyPipe() {
+        ::close(fd_);
+    }
+
+    int Identifier() const override {
+        return fd_;
+    }
+
+    bool HandleReadEvent() override {
+        Counter& c = *counter_;
+        if (++ c.events == kWarmup) {
+            c.allocs = bench::Allocations();
+            c.cpu = bench::CpuSeconds();
+            c.watch = bench::Stopwatch();
+        } else if (c.events == kWarmup + kEvents) {
+            c.allocs = bench::Allocations() - c.allocs;
+            c.cpu = bench::CpuSeconds() - c.cpu;
+            c.seconds = c.watch.Seconds();
+            c.group->Stop();
+        }
+
+        return true; // never read, stay readable
+    }
+    bool HandleWriteEvent() override {
+        return true;
+    }
+    void HandleErrorEvent() override {
+    }
+
+private:
+    const int fd_;
+    Counter* const counter_;
+};
+
+} // end namespace
+
+int main() {
+    internal::EventLoopGroup group(0);
+    Counter counter;
+    counter.group = &group;
+
+    std::vector<int> writers;
+    {
+        EventLoop loop(&group);
+        for (int i = 0; i < kPipes; ++ i) {
+            int fds[2];
+            if (::pipe(fds) != 0)
+                return 1;
+
+            ::write(fds[1], "x", 1);
+            writers.push_back(fds[1]);
+            loop.Register(internal::eET_Read, std::make_shared<ReadyPipe>(fds[0], &counter));
+        }
+
+        loop.Run();
+    }
+
+    for (int fd : writers)
+        ::close(fd);
+
+    printf("%d ready channels, %llu events\n", kPipes, (unsigned long long)kEvents);
+    printf("allocations per event: %.4f\n", double(counter.allocs) / kEvents);
+    printf("ns per event: %.1f (cpu %.1f)\n",
+           counter.seconds * 1e9 / kEvents, counter.cpu * 1e9 / kEvents);
+    return 0;
+}
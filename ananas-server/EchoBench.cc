@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "net/Application.h"
+#include "net/Connection.h"
+#include "util/Logger.h"
+#include "Bench.h"
+
+// Echo server of 1 worker loop, epoll against io_uring completions:
+// syscalls of server per request, counted by ptrace, and latency of
+// rounds in another run without ptrace. A round is one request on each
+// connection, then waiting for all responses.
+// io_uring loop makes no syscall if completions are ready when it polls,
+// so fewer cores, or slower server, means fewer syscalls.
+
+using namespace ananas;
+
+namespace {
+
+const int kRequestSize = 64;
+const int kWarmupRounds = 500;
+const int kTracedRounds = 5000;
+const int kTimedRounds = 50000;
+
+// written by client process, read by tracer
+struct Shared {
+    std::atomic<int> measuring;
+    uint64_t requests;
+    double p50Us;
+    double p99Us;
+};
+
+void RunServer(PollerType type, uint16_t port) {
+    LogManager::Instance().Start();
+
+    auto& app = Application::Instance();
+    app.SetNumOfWorker(1);
+    app.SetPollerType(type);
+    app.Listen("127.0.0.1", port, [](Connection* conn) {
+        conn->SetOnMessage([](Connection* c, const char* data, PacketLen_t len) {
+            c->SendPacket(data, len);
+            return len;
+        });
+    });
+
+    app.Run(0, nullptr);
+}
+
+int ConnectRetry(uint16_t port) {
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (int i = 0; i < 500; ++ i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, (sockaddr* )&addr, sizeof addr) == 0) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            return fd;
+        }
+
+        ::close(fd);
+        ::usleep(10 * 1000);
+    }
+
+    ::_exit(1);
+}
+
+bool Round(const std::vector<int>& socks) {
+    char buf[kRequestSize];
+    ::memset(buf, 'x', sizeof buf);
+    for (int fd : socks) {
+        if (::send(fd, buf, sizeof buf, 0) != kRequestSize)
+            return false;
+    }
+
+    for (int fd : socks) {
+        int got = 0;
+        while (got < kRequestSize) {
+            const ssize_t n = ::recv(fd, buf, kRequestSize - got, 0);
+            if (n <= 0)
+                return false;
+
+            got += static_cast<int>(n);
+        }
+    }
+
+    return true;
+}
+
+void RunClient(uint16_t port, int conns, int rounds, Shared* shared) {
+    std::vector<int> socks;
+    for (int i = 0; i < conns; ++ i)
+        socks.push_back(ConnectRetry(port));
+
+    for (int i = 0; i < kWarmupRounds; ++ i) {
+        if (!Round(socks))
+            ::_exit(1);
+    }
+
+    std::vector<double> us;
+    us.reserve(rounds);
+
+    shared->measuring = 1;
+    for (int i = 0; i < rounds; ++ i) {
+        bench::Stopwatch watch;
+        if (!Round(socks))
+            ::_exit(1);
+        us.push_back(watch.Seconds() * 1e6);
+    }
+    shared->measuring = 0;
+
+    std::sort(us.begin(), us.end());
+    shared->requests = static_cast<uint64_t>(rounds) * conns;
+    shared->p50Us = us[us.size() / 2];
+    shared->p99Us = us[us.size() * 99 / 100];
+
+    for (int fd : socks)
+        ::close(fd);
+}
+
+pid_t ForkServer(PollerType type, uint16_t port, bool traced) {
+    fflush(stdout);
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        if (traced) {
+            ::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+            ::raise(SIGSTOP);
+        }
+
+        RunServer(type, port);
+        ::_exit(0);
+    }
+
+    return pid;
+}
+
+pid_t ForkClient(uint16_t port, int conns, int rounds, Shared* shared) {
+    fflush(stdout);
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        RunClient(port, conns, rounds, shared);
+        ::_exit(0);
+    }
+
+    return pid;
+}
+
+// Server syscalls while client is measuring
+uint64_t TracedRun(PollerType type, uint16_t port, int conns, Shared* shared) {
+    pid_t server = ForkServer(type, port, true);
+    int status = 0;
+    ::waitpid(server, &status, 0);
+    ::ptrace(PTRACE_SETOPTIONS, server, nullptr,
+             PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL);
+    ::ptrace(PTRACE_SYSCALL, server, nullptr, nullptr);
+
+    pid_t client = ForkClient(port, conns, kTracedRounds, shared);
+
+    uint64_t syscalls = 0;
+    while (true) {
+        pid_t pid = ::waitpid(-1, &status, __WALL);
+        if (pid < 0 || pid == client)
+            break;
+
+        if (!WIFSTOPPED(status))
+            continue;
+
+        const int sig = WSTOPSIG(status);
+        int inject = 0;
+        if (sig == (SIGTRAP | 0x80)) {
+            __ptrace_syscall_info info;
+            ::ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof info, &info);
+            if (info.op == PTRACE_SYSCALL_INFO_ENTRY && shared->measuring)
+                ++ syscalls;
+        } else if (sig != SIGTRAP && sig != SIGSTOP) {
+            inject = sig;
+        }
+
+        ::ptrace(PTRACE_SYSCALL, pid, nullptr, reinterpret_cast<void* >(static_cast<long>(inject)));
+    }
+
+    ::kill(server, SIGKILL);
+    while (::waitpid(-1, &status, __WALL) > 0)
+        ;
+
+    return syscalls;
+}
+
+void TimedRun(PollerType type, uint16_t port, int conns, Shared* shared) {
+    pid_t server = ForkServer(type, port, false);
+    pid_t client = ForkClient(port, conns, kTimedRounds, shared);
+
+    int status = 0;
+    ::waitpid(client, &status, 0);
+    ::kill(server, SIGKILL);
+    ::waitpid(server, &status, 0);
+}
+
+} // end namespace
+
+int main() {
+    void* mem = ::mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    Shared* shared = new (mem) Shared();
+
+    struct {
+        const char* name;
+        PollerType type;
+    } pollers[] = {
+        {"epoll", PollerType::eDefault},
+        {"io_uring", PollerType::eIoUring},
+    };
+
+    printf("%-9s %6s %14s %10s %10s\n", "poller", "conns", "syscalls/req", "p50 us", "p99 us");
+    uint16_t port = 19870;
+    for (int conns : {1, 16}) {
+        for (const auto& p : pollers) {
+            shared->requests = 0;
+            const uint64_t syscalls = TracedRun(p.type, port ++, conns, shared);
+            const double perRequest = shared->requests ?
+                                      static_cast<double>(syscalls) / shared->requests : -1;
+
+            shared->requests = 0;
+            TimedRun(p.type, port ++, conns, shared);
+            if (shared->requests == 0) {
+                printf("%-9s %6d failed\n", p.name, conns);
+                continue;
+            }
+
+            printf("%-9s %6d %14.2f %10.1f %10.1f\n",
+                   p.name, conns, perRequest, shared->p50Us, shared->p99Us);
+        }
+    }
+
+    return 0;
+}
@@ -4,6 +4,7 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <algorithm>
 
 #include "AnanasDebug.h"
 
@@ -15,14 +16,14 @@ namespace ananas {
 namespace internal {
 
 namespace Epoll {
-bool ModSocket(int epfd, int socket, uint32_t events, void* ptr);
+bool ModSocket(int epfd, int socket, uint32_t events, uint64_t data);
 
-bool AddSocket(int epfd, int socket, uint32_t events, void* ptr) {
+bool AddSocket(int epfd, int socket, uint32_t events, uint64_t data) {
     if (socket < 0)
         return false;
 
     epoll_event  ev;
-    ev.data.ptr= ptr;
+    ev.data.u64 = data;
     ev.events = 0;
 
     if (events & eET_Read)
@@ -41,12 +42,12 @@ bool DelSocket(int epfd, int socket) {
     return 0 == epoll_ctl(epfd, EPOLL_CTL_DEL, socket, &dummy) ;
 }
 
-bool ModSocket(int epfd, int socket, uint32_t events, void* ptr) {
+bool ModSocket(int epfd, int socket, uint32_t events, uint64_t data) {
     if (socket < 0)
         return false;
 
     epoll_event  ev;
-    ev.data.ptr= ptr;
+    ev.data.u64 = data;
     ev.events = 0;
 
     if (events & eET_Read)
@@ -59,9 +60,11 @@ bool ModSocket(int epfd, int socket, uint32_t events, void* ptr) {
 }
 
 
-Epoller::Epoller() {
+Epoller::Epoller(bool edgeTriggered) :
+    edgeTriggered_(edgeTriggered) {
     multiplexer_ = ::epoll_create(512);
-    ANANAS_DBG << "create epoll: " << multiplexer_;
+    ANANAS_DBG << "create epoll: " << multiplexer_
+               << (edgeTriggered_ ? " edge triggered" : "");
 }
 
 Epoller::~Epoller() {
@@ -71,27 +74,36 @@ Epoller::~Epoller() {
     }
 }
 
-bool Epoller::Register(int fd, int events, void* userPtr) {
+bool Epoller::Register(int fd, int events, uint64_t userData) {
 	cout<<"Epoller::Register"<<endl;
-    if (Epoll::AddSocket(multiplexer_, fd, events, userPtr))
+    if (edgeTriggered_)
+        return _RegisterET(fd, events, userData);
+
+    if (Epoll::AddSocket(multiplexer_, fd, events, userData))
         return true;
 
-    return (errno == EEXIST) && Modify(fd, events, userPtr);
+    return (errno == EEXIST) && Modify(fd, events, userData);
 }
 
 bool Epoller::Unregister(int fd, int events) {
+    if (edgeTriggered_)
+        return _UnregisterET(fd);
+
     return Epoll::DelSocket(multiplexer_, fd);
 }
 
 
-bool Epoller::Modify(int fd, int events, void* userPtr) {
+bool Epoller::Modify(int fd, int events, uint64_t userData) {
     if (events == 0)
         return Unregister(fd, 0);
 
-    if (Epoll::ModSocket(multiplexer_, fd, events, userPtr))
+    if (edgeTriggered_)
+        return _ModifyET(fd, events, userData);
+
+    if (Epoll::ModSocket(multiplexer_, fd, events, userData))
         return  true;
 
-    return  errno == ENOENT && Register(fd, events, userPtr);
+    return  errno == ENOENT && Register(fd, events, userData);
 }
 
 
@@ -99,6 +111,9 @@ int Epoller::Poll(size_t maxEvent, int timeoutMs) {
     if (maxEvent == 0)
         return 0;
 
+    if (edgeTriggered_)
+        return _PollET(maxEvent, timeoutMs);
+
     while (events_.size() < maxEvent)
         events_.resize(2 * events_.size() + 1);
 
@@ -113,7 +128,7 @@ int Epoller::Poll(size_t maxEvent, int timeoutMs) {
     for (int i = 0; i < nFired; ++ i) {
         FiredEvent& fired = events[i];
         fired.events   = 0;
-        fired.userdata = events_[i].data.ptr;
+        fired.userdata = events_[i].data.u64;
 
         if (events_[i].events & EPOLLIN)
             fired.events  |= eET_Read;
@@ -128,6 +143,131 @@ int Epoller::Poll(size_t maxEvent, int timeoutMs) {
     return nFired;
 }
 
+bool Epoller::_RegisterET(int fd, int events, uint64_t userData) {
+    if (fd < 0)
+        return false;
+
+    if (static_cast<std::size_t>(fd) >= fds_.size())
+        fds_.resize(std::max<std::size_t>(2 * fds_.size(), fd + 1));
+
+    FdState& state = fds_[fd];
+    if (state.interest != 0)
+        return _ModifyET(fd, events, userData);
+
+    // Always ask for both, the kernel reports current readiness on add.
+    epoll_event  ev;
+    ev.data.u64 = static_cast<uint64_t>(fd);
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+
+    if (0 != epoll_ctl(multiplexer_, EPOLL_CTL_ADD, fd, &ev))
+        return false;
+
+    state.userData = userData;
+    state.interest = events;
+    state.synthetic = 0;
+    return true;
+}
+
+bool Epoller::_ModifyET(int fd, int events, uint64_t userData) {
+    if (fd < 0 ||
+        static_cast<std::size_t>(fd) >= fds_.size() ||
+        fds_[fd].interest == 0)
+        return _RegisterET(fd, events, userData);
+
+    FdState& state = fds_[fd];
+
+    // The edge may have been consumed while interest was off, or the handler
+    // stopped before EAGAIN (eg. write complete), so assume newly enabled
+    // events are ready; a wrong guess costs only one EAGAIN.
+    const int enabled = events & ~state.interest;
+    if (enabled) {
+        if (state.synthetic == 0)
+            synthetics_.push_back(fd);
+        state.synthetic |= enabled;
+    }
+
+    state.userData = userData;
+    state.interest = events;
+    return true;
+}
+
+bool Epoller::_UnregisterET(int fd) {
+    if (fd < 0 ||
+        static_cast<std::size_t>(fd) >= fds_.size() ||
+        fds_[fd].interest == 0)
+        return false;
+
+    fds_[fd].interest = 0;
+    fds_[fd].synthetic = 0;
+    return Epoll::DelSocket(multiplexer_, fd);
+}
+
+int Epoller::_PollET(std::size_t maxEvent, int timeoutMs) {
+    while (events_.size() < maxEvent)
+        events_.resize(2 * events_.size() + 1);
+
+    // synthetic events are ready now
+    if (!synthetics_.empty())
+        timeoutMs = 0;
+
+    int nEpoll = TEMP_FAILURE_RETRY(::epoll_wait(multiplexer_, &events_[0], maxEvent, timeoutMs));
+    if (nEpoll == -1) {
+        if (errno != EINTR && errno != EWOULDBLOCK)
+            return -1;
+
+        nEpoll = 0;
+    }
+
+    auto& events = firedEvents_;
+    if (events.size() < nEpoll + synthetics_.size())
+        events.resize(nEpoll + synthetics_.size());
+
+    int nFired = 0;
+    for (int i = 0; i < nEpoll; ++ i) {
+        const int fd = static_cast<int>(events_[i].data.u64);
+        FdState& state = fds_[fd];
+        if (state.interest == 0)
+            continue;
+
+        int fired = state.synthetic;
+        state.synthetic = 0;
+
+        if (events_[i].events & EPOLLIN)
+            fired |= eET_Read;
+
+        if (events_[i].events & EPOLLOUT)
+            fired |= eET_Write;
+
+        // only report what channel is interested in, the edge is lost,
+        // Modify will synthesize it when interest is enabled.
+        fired &= state.interest;
+
+        if (events_[i].events & (EPOLLERR | EPOLLHUP))
+            fired |= eET_Error;
+
+        if (fired) {
+            events[nFired].events = fired;
+            events[nFired].userdata = state.userData;
+            ++ nFired;
+        }
+    }
+
+    for (int fd : synthetics_) {
+        FdState& state = fds_[fd];
+        const int fired = state.synthetic & state.interest;
+        state.synthetic = 0;
+
+        if (fired) {
+            events[nFired].events = fired;
+            events[nFired].userdata = state.userData;
+            ++ nFired;
+        }
+    }
+
+    synthetics_.clear();
+    return nFired;
+}
+
 } // end namespace internal
 } // end namespace ananas
 
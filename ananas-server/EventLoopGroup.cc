@@ -1,5 +1,11 @@
 #include "EventLoopGroup.h"
 #include "EventLoop.h"
+#include "Watchdog.h"
+#include "Socket.h"
+#include "AnanasDebug.h"
+
+#include <iostream>
+using namespace std;
 
 namespace ananas {
 
@@ -22,7 +28,42 @@ size_t EventLoopGroup::Size() const {
     return numLoop_;
 }
 
+void EventLoopGroup::SetPollerType(PollerType type) {
+    assert (state_ == eS_None);
+    pollerType_ = type;
+}
+
+void EventLoopGroup::SetWatchdog(Watchdog* watchdog) {
+    assert (state_ == eS_None);
+    watchdog_ = watchdog;
+}
+
+void EventLoopGroup::SetAffinity(const AffinityPolicy& policy) {
+    assert (state_ == eS_None);
+    affinity_ = policy;
+}
+
+void EventLoopGroup::SetBudget(const LoopBudget& budget) {
+    assert (state_ == eS_None);
+    budget_ = budget;
+}
+
+void EventLoopGroup::SetTimerBackend(TimerBackend backend) {
+    assert (state_ == eS_None);
+    timerBackend_ = backend;
+}
+
 void EventLoopGroup::Stop() {
+    MarkStopped();
+
+    // loops may block in poller without timeout,
+    // and threads of Start may still be adding to loops_
+    std::unique_lock<std::mutex> guard(mutex_);
+    for (auto loop : loops_)
+        loop->Wakeup();
+}
+
+void EventLoopGroup::MarkStopped() {
     state_ = eS_Stopped;
 }
 
@@ -38,12 +79,21 @@ void EventLoopGroup::Start() {
     pool_.SetMaxThreads(numLoop_);
     for (size_t i = 0; i < numLoop_; ++i) {
 		cout<<"before pool_.Execute"<<endl;
-        pool_.Execute([this]() {
+        pool_.Post([this, i]() {
 			cout<<"inside pool_Execute yet"<<endl;
-            EventLoop* loop = new EventLoop(this);
+            // pin me before loop allocates anything
+            const std::string placement = ApplyAffinity(affinity_, i);
+
+            EventLoop* loop = new EventLoop(this, pollerType_);
+            loop->SetBudget(budget_);
+            loop->SetTimerBackend(timerBackend_);
+            ANANAS_INF << "EventLoop " << loop->Id() << " placement: " << placement;
 
             {
                 std::unique_lock<std::mutex> guard(mutex_);
+                loop->EnableStats(statsEnabled_);
+                if (watchdog_)
+                    watchdog_->Watch(loop);
                 loops_.push_back(loop);
                 if (loops_.size() == numLoop_)
                     cond_.notify_one();
@@ -64,8 +114,13 @@ void EventLoopGroup::Start() {
 void EventLoopGroup::Wait() {
     pool_.JoinAll();
 
-    for (auto loop : loops_)
+    std::unique_lock<std::mutex> guard(mutex_);
+    for (auto loop : loops_) {
+        if (watchdog_)
+            watchdog_->Unwatch(loop);
+
         delete loop;
+    }
 
     loops_.clear();
 }
@@ -80,6 +135,103 @@ EventLoop* EventLoopGroup::Next() const {
     return loops_[currentLoop_++ % loops_.size()];
 }
 
+namespace {
+
+// the lighter one wins, the former if tie
+template <typename F>
+EventLoop* LeastLoaded(const std::vector<EventLoop* >& loops, F&& load) {
+    EventLoop* best = loops[0];
+    std::size_t bestLoad = load(best);
+    for (std::size_t i = 1; i < loops.size(); ++ i) {
+        const std::size_t l = load(loops[i]);
+        if (l < bestLoad) {
+            best = loops[i];
+            bestLoad = l;
+        }
+    }
+
+    return best;
+}
+
+std::size_t ConnectionLoad(const EventLoop* loop) {
+    // new connections are handed over by tasks, count them, or a burst
+    // of accepts goes to the same loop.
+    return loop->NumOfConnections() + loop->NumOfPendingTasks();
+}
+
+std::size_t TaskLoad(const EventLoop* loop) {
+    return loop->NumOfPendingTasks();
+}
+
+uint32_t FastRand() {
+    // xorshift, good enough for picking loops
+    static thread_local uint32_t seed = static_cast<uint32_t>(
+            reinterpret_cast<uintptr_t>(&seed) >> 4) | 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+} // end namespace
+
+EventLoop* EventLoopGroup::Next(LoadBalance lb, const SocketAddr& peer) const {
+    if (state_ != eS_Started)
+        return nullptr;
+
+    if (loops_.empty())
+        return nullptr;
+
+    const std::size_t n = loops_.size();
+    switch (lb) {
+    case LoadBalance::eRoundRobin:
+        break;
+
+    case LoadBalance::eLeastConnections:
+        return LeastLoaded(loops_, ConnectionLoad);
+
+    case LoadBalance::eLeastPendingTasks:
+        return LeastLoaded(loops_, TaskLoad);
+
+    case LoadBalance::ePowerOfTwoChoices: {
+        if (n == 1)
+            return loops_[0];
+
+        const std::size_t a = FastRand() % n;
+        const std::size_t b = (a + 1 + FastRand() % (n - 1)) % n;
+        return ConnectionLoad(loops_[b]) < ConnectionLoad(loops_[a]) ? loops_[b] : loops_[a];
+    }
+
+    case LoadBalance::eHashByPeer: {
+        // std::hash of integer is identity, and low byte of network order
+        // ip is the first octet: mix all bits, keep the high ones.
+        const uint32_t ip = ntohl(peer.GetAddr().sin_addr.s_addr);
+        const uint32_t h = static_cast<uint32_t>((ip * 0x9e3779b97f4a7c15ULL) >> 32);
+        return loops_[h % n];
+    }
+    }
+
+    return Next();
+}
+
+void EventLoopGroup::EnableStats(bool enable) {
+    statsEnabled_ = enable;
+
+    std::unique_lock<std::mutex> guard(mutex_);
+    for (auto loop : loops_)
+        loop->EnableStats(enable);
+}
+
+LoopStats EventLoopGroup::GetStats() const {
+    LoopStats stats;
+
+    std::unique_lock<std::mutex> guard(mutex_);
+    for (auto loop : loops_)
+        stats.Merge(loop->GetStats());
+
+    return stats;
+}
+
 } // end namespace internal
 
 } // end namespace ananas
@@ -0,0 +1,59 @@
+#include <atomic>
+#include <set>
+#include <thread>
+#include <arpa/inet.h>
+
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "net/Socket.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+
+TEST_CASE(HashByPeer) {
+    internal::EventLoopGroup group(4);
+    group.Start();
+
+    // same first octet, like clients of one network
+    std::set<EventLoop* > used;
+    for (uint32_t i = 0; i < 64; ++ i) {
+        const SocketAddr peer(htonl(0x0a000000 + i), htons(1000));
+        EventLoop* loop = group.Next(LoadBalance::eHashByPeer, peer);
+        EXPECT_TRUE(loop == group.Next(LoadBalance::eHashByPeer, SocketAddr(htonl(0x0a000000 + i), htons(2000))));
+        used.insert(loop);
+    }
+
+    EXPECT_EQ(used.size(), 4u);
+
+    group.Stop();
+    group.Wait();
+}
+
+// pending tasks are counted once asked for, the busy loop is avoided
+TEST_CASE(LeastPendingTasks) {
+    internal::EventLoopGroup group(2);
+    group.Start();
+
+    EventLoop* busy = group.Next(LoadBalance::eLeastPendingTasks, SocketAddr());
+    std::atomic<bool> release {false};
+    busy->Execute([&release]() {
+        while (!release)
+            std::this_thread::yield();
+    });
+    for (int i = 0; i < 3; ++ i)
+        busy->Execute([]() { });
+
+    EXPECT_TRUE(busy->NumOfPendingTasks() >= 3);
+    for (int i = 0; i < 4; ++ i)
+        EXPECT_TRUE(group.Next(LoadBalance::eLeastPendingTasks, SocketAddr()) != busy);
+
+    release = true;
+    for (int i = 0; i < 1000 && busy->NumOfPendingTasks() > 0; ++ i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(busy->NumOfPendingTasks(), 0u);
+
+    group.Stop();
+    group.Wait();
+}
+
+TEST_MAIN()
@@ -0,0 +1,91 @@
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "util/UniqueFunction.h"
+
+#define ANANAS_BENCH_COUNT_ALLOCS
+#include "Bench.h"
+
+// Allocations and time per scheduled task: the callable is wrapped, moved
+// into a queue and out, called and destroyed, std::function against
+// UniqueFunction. Move-only captures need a shared_ptr for std::function.
+
+using namespace ananas;
+
+namespace {
+
+const int kTasks = 1000 * 1000;
+
+template <std::size_t N>
+struct Capture {
+    char data[N] = {};
+};
+
+struct Result {
+    double ns;
+    double allocs;
+};
+
+// make(i) returns a callable
+template <typename Function, typename Make>
+Result Measure(Make&& make) {
+    std::vector<Function> queue;
+    queue.reserve(1);
+
+    long sum = 0;
+    const uint64_t allocs = bench::Allocations();
+    bench::Stopwatch watch;
+    for (int i = 0; i < kTasks; ++ i) {
+        queue.emplace_back(make(i));
+        Function task(std::move(queue.back()));
+        queue.pop_back();
+        sum += task();
+    }
+
+    Result r;
+    r.ns = watch.Seconds() * 1e9 / kTasks;
+    r.allocs = static_cast<double>(bench::Allocations() - allocs) / kTasks;
+    if (sum == 42)
+        printf("unlikely\n");
+
+    return r;
+}
+
+template <std::size_t N>
+void Row(const char* name) {
+    auto make = [](int i) {
+        Capture<N> c;
+        c.data[0] = static_cast<char>(i);
+        return [c]() { return static_cast<long>(c.data[0]); };
+    };
+
+    const Result f = Measure<std::function<long ()> >(make);
+    const Result u = Measure<UniqueFunction<long ()> >(make);
+    printf("%-16s %12.1f %8.2f %12.1f %8.2f\n", name, f.ns, f.allocs, u.ns, u.allocs);
+}
+
+void MoveOnlyRow() {
+    const Result f = Measure<std::function<long ()> >([](int i) {
+        auto p = std::make_shared<std::unique_ptr<int> >(new int(i));
+        return [p]() { return static_cast<long>(**p); };
+    });
+    const Result u = Measure<UniqueFunction<long ()> >([](int i) {
+        std::unique_ptr<int> p(new int(i));
+        return [p = std::move(p)]() { return static_cast<long>(*p); };
+    });
+    printf("%-16s %12.1f %8.2f %12.1f %8.2f\n", "unique_ptr", f.ns, f.allocs, u.ns, u.allocs);
+}
+
+} // end namespace
+
+int main() {
+    printf("%-16s %12s %8s %12s %8s\n", "capture", "function ns", "allocs", "unique ns", "allocs");
+    Row<8>("8 bytes");
+    Row<16>("16 bytes");
+    Row<kUniqueFunctionInlineSize>("inline size");
+    Row<64>("64 bytes");
+    MoveOnlyRow();
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include <string>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "net/IoUringPoller.h"
+#include "UnitTest.h"
+
+#ifdef ANANAS_HAS_IO_URING
+
+using namespace ananas::internal;
+
+namespace {
+
+// loopback socket bound to any port
+int BoundSocket(int type, sockaddr_in& addr) {
+    int fd = ::socket(AF_INET, type | SOCK_NONBLOCK, 0);
+    addr = sockaddr_in();
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd, (sockaddr* )&addr, sizeof addr);
+
+    socklen_t len = sizeof addr;
+    ::getsockname(fd, (sockaddr* )&addr, &len);
+    return fd;
+}
+
+// Poll until a completion of userData, false if none in time
+bool WaitCompletion(IoUringPoller& poller, uint64_t userData, Completion& c, std::string* data = nullptr) {
+    for (int i = 0; i < 100; ++ i) {
+        const int n = poller.Poll(64, 10);
+        for (int j = 0; j < n; ++ j) {
+            const FiredEvent& fired = poller.GetFiredEvents()[j];
+            if (fired.userdata == userData && (fired.events & eET_Completion)) {
+                c = fired.completion;
+                // buffer is recycled by next Poll
+                if (data && c.data && c.result > 0)
+                    data->assign(c.data, c.result);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Completion IO needs a recent kernel, it's fine to skip
+bool Supported(IoUringPoller& poller, int fd, CompletionOp op, uint64_t userData) {
+    if (!poller.IsValid() || !poller.StartCompletion(fd, op, userData)) {
+        fprintf(stderr, "completion IO is not supported, skipped\n");
+        return false;
+    }
+
+    return true;
+}
+
+} // end namespace
+
+TEST_CASE(AcceptAndRecv) {
+    IoUringPoller poller;
+    sockaddr_in addr;
+    int listenFd = BoundSocket(SOCK_STREAM, addr);
+    ::listen(listenFd, 16);
+    EXPECT_TRUE(poller.Register(listenFd, eET_Read, 1));
+    if (!Supported(poller, listenFd, CompletionOp::eAccept, 1)) {
+        ::close(listenFd);
+        return;
+    }
+
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_EQ(::connect(client, (sockaddr* )&addr, sizeof addr), 0);
+
+    Completion c;
+    EXPECT_TRUE(WaitCompletion(poller, 1, c));
+    const int conn = c.result;
+    EXPECT_TRUE(conn >= 0);
+
+    EXPECT_TRUE(poller.Register(conn, eET_Read, 2));
+    EXPECT_TRUE(poller.StartCompletion(conn, CompletionOp::eRecv, 2));
+
+    // multishot: one op for many reads
+    for (const char* msg : {"hello", "world"}) {
+        EXPECT_EQ(::send(client, msg, 5, 0), 5);
+        std::string data;
+        EXPECT_TRUE(WaitCompletion(poller, 2, c, &data));
+        EXPECT_EQ(c.result, 5);
+        EXPECT_EQ(data, std::string(msg));
+    }
+
+    // and accepts go on too
+    int client2 = ::socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_EQ(::connect(client2, (sockaddr* )&addr, sizeof addr), 0);
+    EXPECT_TRUE(WaitCompletion(poller, 1, c));
+    EXPECT_TRUE(c.result >= 0);
+    ::close(c.result);
+    ::close(client2);
+
+    ::close(client);
+    EXPECT_TRUE(WaitCompletion(poller, 2, c));
+    EXPECT_EQ(c.result, 0); // EOF
+
+    poller.Unregister(conn, 0);
+    poller.Unregister(listenFd, 0);
+    ::close(conn);
+    ::close(listenFd);
+}
+
+TEST_CASE(RecvMsgPeer) {
+    IoUringPoller poller;
+    sockaddr_in addr;
+    int fd = BoundSocket(SOCK_DGRAM, addr);
+    EXPECT_TRUE(poller.Register(fd, eET_Read, 3));
+    if (!Supported(poller, fd, CompletionOp::eRecvMsg, 3)) {
+        ::close(fd);
+        return;
+    }
+
+    sockaddr_in peerAddr;
+    int peer = BoundSocket(SOCK_DGRAM, peerAddr);
+    EXPECT_EQ(::sendto(peer, "ping", 4, 0, (sockaddr* )&addr, sizeof addr), 4);
+
+    Completion c;
+    std::string data;
+    EXPECT_TRUE(WaitCompletion(poller, 3, c, &data));
+    EXPECT_EQ(c.result, 4);
+    EXPECT_EQ(data, std::string("ping"));
+    EXPECT_TRUE(c.peerLen == sizeof(sockaddr_in));
+
+    poller.Unregister(fd, 0);
+    ::close(peer);
+    ::close(fd);
+}
+
+TEST_CASE(RecvMsgTruncated) {
+    IoUringPoller poller;
+    sockaddr_in addr;
+    int fd = BoundSocket(SOCK_DGRAM, addr);
+    EXPECT_TRUE(poller.Register(fd, eET_Read, 6));
+    if (!Supported(poller, fd, CompletionOp::eRecvMsg, 6)) {
+        ::close(fd);
+        return;
+    }
+
+    // larger than a provided buffer
+    int peer = ::socket(AF_INET, SOCK_DGRAM, 0);
+    const std::string big(IoUringPoller::kRecvBufferSize + 1000, 'b');
+    EXPECT_EQ(::sendto(peer, big.data(), big.size(), 0, (sockaddr* )&addr, sizeof addr),
+              static_cast<ssize_t>(big.size()));
+
+    Completion c;
+    std::string data;
+    EXPECT_TRUE(WaitCompletion(poller, 6, c, &data));
+    EXPECT_TRUE(c.truncated);
+    EXPECT_TRUE(c.result > 0 && static_cast<std::size_t>(c.result) < big.size());
+    EXPECT_EQ(data, big.substr(0, c.result));
+
+    EXPECT_EQ(::sendto(peer, "x", 1, 0, (sockaddr* )&addr, sizeof addr), 1);
+    EXPECT_TRUE(WaitCompletion(poller, 6, c, &data));
+    EXPECT_TRUE(!c.truncated);
+    EXPECT_EQ(data, std::string("x"));
+
+    poller.Unregister(fd, 0);
+    ::close(peer);
+    ::close(fd);
+}
+
+TEST_CASE(StaleAfterUnregister) {
+    IoUringPoller poller;
+    sockaddr_in addr;
+    int fd = BoundSocket(SOCK_DGRAM, addr);
+    EXPECT_TRUE(poller.Register(fd, eET_Read, 4));
+    if (!Supported(poller, fd, CompletionOp::eRecvMsg, 4)) {
+        ::close(fd);
+        return;
+    }
+
+    poller.Unregister(fd, 0);
+    int peer = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ::sendto(peer, "x", 1, 0, (sockaddr* )&addr, sizeof addr);
+
+    Completion c;
+    EXPECT_TRUE(!WaitCompletion(poller, 4, c));
+
+    ::close(peer);
+    ::close(fd);
+}
+
+TEST_CASE(BuffersRecycled) {
+    // more completions than buffers, each Poll gives them back
+    IoUringPoller poller;
+    sockaddr_in addr;
+    int fd = BoundSocket(SOCK_DGRAM, addr);
+    EXPECT_TRUE(poller.Register(fd, eET_Read, 5));
+    if (!Supported(poller, fd, CompletionOp::eRecvMsg, 5)) {
+        ::close(fd);
+        return;
+    }
+
+    int peer = ::socket(AF_INET, SOCK_DGRAM, 0);
+    const unsigned total = 3 * IoUringPoller::kRecvBuffers;
+    unsigned got = 0;
+    for (unsigned i = 0; i < total; ++ i) {
+        ::sendto(peer, "x", 1, 0, (sockaddr* )&addr, sizeof addr);
+
+        Completion c;
+        if (WaitCompletion(poller, 5, c))
+            ++ got;
+    }
+
+    EXPECT_EQ(got, total);
+
+    poller.Unregister(fd, 0);
+    ::close(peer);
+    ::close(fd);
+}
+
+#endif // end #ifdef ANANAS_HAS_IO_URING
+
+TEST_MAIN()
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "net/Connection.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "Bench.h"
+
+// Skewed load over EventLoopGroup::Next policies. Each client opens 4
+// connections in a burst: the first one is heavy and lives to the end,
+// the others are closed soon. Round robin puts heavy ones in lockstep;
+// max/mean of heavy connections per loop shows how even the load is,
+// 1.0 is ideal.
+
+using namespace ananas;
+
+namespace {
+
+const int kLoops = 4;
+const int kClients = 400;
+const int kConnsPerClient = 4;
+
+struct Conn {
+    EventLoop* loop;
+    std::shared_ptr<Connection> conn;
+    int peerFd;
+    int closeAt; // client index, -1 for heavy
+};
+
+void Open(Conn& c, const SocketAddr& peer) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        ::exit(1);
+    }
+
+    c.peerFd = fds[1];
+    c.conn = std::make_shared<Connection>(c.loop);
+    c.conn->Init(fds[0], peer);
+
+    EventLoop* loop = c.loop;
+    auto conn = c.conn;
+    loop->Post([loop, conn]() {
+        loop->Register(internal::eET_Read, conn);
+    });
+}
+
+void Close(Conn& c) {
+    EventLoop* loop = c.loop;
+    auto conn = std::move(c.conn);
+    const int peerFd = c.peerFd;
+    // not before, or conn sees EOF and closes itself
+    loop->Post([loop, conn, peerFd]() {
+        loop->Unregister(internal::eET_Read, conn);
+        ::close(peerFd);
+    });
+}
+
+void Drain(const std::vector<EventLoop* >& loops) {
+    for (auto loop : loops)
+        loop->Execute([]() { }).Wait();
+}
+
+double MaxOverMean(const std::vector<std::size_t>& v) {
+    std::size_t sum = 0;
+    for (auto n : v)
+        sum += n;
+
+    const double mean = static_cast<double>(sum) / v.size();
+    return mean > 0 ? *std::max_element(v.begin(), v.end()) / mean : 0;
+}
+
+void Run(const char* name, LoadBalance lb) {
+    internal::EventLoopGroup group(kLoops);
+    group.Start();
+
+    std::vector<EventLoop* > loops;
+    for (int i = 0; i < kLoops; ++ i)
+        loops.push_back(group.Next());
+
+    std::mt19937 rand(7);
+    std::vector<Conn> heavy;
+    std::vector<Conn> light;
+    double pickNs = 0;
+
+    for (int client = 0; client < kClients; ++ client) {
+        const SocketAddr peer(htonl(0x0a000000 + rand() % 0xffffff), htons(10000));
+        for (int i = 0; i < kConnsPerClient; ++ i) {
+            bench::Stopwatch watch;
+            Conn c;
+            c.loop = group.Next(lb, peer);
+            pickNs += watch.Seconds() * 1e9;
+
+            c.closeAt = i == 0 ? -1 : client + 1 + static_cast<int>(rand() % 4);
+            Open(c, peer);
+            (i == 0 ? heavy : light).push_back(std::move(c));
+        }
+
+        for (auto& c : light) {
+            if (c.conn && c.closeAt == client)
+                Close(c);
+        }
+
+        light.erase(std::remove_if(light.begin(), light.end(),
+                                   [](const Conn& c) { return !c.conn; }),
+                    light.end());
+    }
+
+    Drain(loops);
+
+    std::vector<std::size_t> heavyPerLoop(kLoops), connsPerLoop(kLoops);
+    for (const auto& c : heavy)
+        ++ heavyPerLoop[std::find(loops.begin(), loops.end(), c.loop) - loops.begin()];
+    for (int i = 0; i < kLoops; ++ i)
+        connsPerLoop[i] = loops[i]->NumOfConnections();
+
+    printf("%-18s %10.2f %10.2f %10.0f\n", name,
+           MaxOverMean(heavyPerLoop), MaxOverMean(connsPerLoop),
+           pickNs / (kClients * kConnsPerClient));
+
+    for (auto& c : heavy)
+        Close(c);
+    for (auto& c : light)
+        Close(c);
+
+    Drain(loops);
+    group.Stop();
+    group.Wait();
+}
+
+} // end namespace
+
+int main() {
+    printf("%d loops, %d clients of %d connections\n", kLoops, kClients, kConnsPerClient);
+    printf("%-18s %10s %10s %10s\n", "policy", "heavy", "conns", "ns/pick");
+
+    Run("round robin", LoadBalance::eRoundRobin);
+    Run("least conns", LoadBalance::eLeastConnections);
+    Run("least tasks", LoadBalance::eLeastPendingTasks);
+    Run("power of two", LoadBalance::ePowerOfTwoChoices);
+    Run("hash by peer", LoadBalance::eHashByPeer);
+
+    return 0;
+}
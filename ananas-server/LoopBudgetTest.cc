@@ -0,0 +1,96 @@
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "net/Connection.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+
+namespace {
+
+// connection of loop, and the peer socket
+std::shared_ptr<Connection> Connect(EventLoop& loop, int& peer) {
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    ::fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    peer = fds[1];
+
+    auto conn = std::make_shared<Connection>(&loop);
+    conn->Init(fds[0], SocketAddr());
+    loop.Register(internal::eET_Read, conn);
+    return conn;
+}
+
+// Fill socket buffer of peer, it stays readable for many iterations
+void Flood(int peer) {
+    std::vector<char> data(64 * 1024, 'x');
+    while (::write(peer, data.data(), data.size()) > 0)
+        ;
+}
+
+// One loop per thread
+void ReadOncePerIteration(PollerType type) {
+    internal::EventLoopGroup group(0);
+    int peerA = -1, peerB = -1;
+    int iteration = 0;
+    int readsOfA = 0;
+    int maxReadsOfA = 0; // in one iteration
+    int gotB = -1;       // iteration B is read in
+
+    EventLoop loop(&group, type);
+    LoopBudget budget;
+    budget.readBytes = 1; // one read per HandleReadEvent
+    loop.SetBudget(budget);
+
+    auto a = Connect(loop, peerA);
+    auto b = Connect(loop, peerB);
+    a->SetOnMessage([&](Connection* , const char* , PacketLen_t len) {
+        ++ readsOfA;
+        return len;
+    });
+    b->SetOnMessage([&](Connection* , const char* , PacketLen_t len) {
+        gotB = iteration;
+        return len;
+    });
+
+    Flood(peerA);
+    EXPECT_EQ(::write(peerB, "ping", 4), 4);
+
+    // tasks posted by loop run in next iteration
+    std::function<void ()> tick = [&]() {
+        maxReadsOfA = std::max(maxReadsOfA, readsOfA);
+        readsOfA = 0;
+        if (++ iteration < 20)
+            loop.Post(tick);
+        else
+            group.Stop();
+    };
+    loop.Post(tick);
+    loop.Run();
+
+    EXPECT_EQ(maxReadsOfA, 1);
+    // not starved by A
+    EXPECT_TRUE(gotB >= 0 && gotB <= 1);
+
+    ::close(peerA);
+    ::close(peerB);
+}
+
+} // end namespace
+
+TEST_CASE(ReadOncePerIterationLT) {
+    std::thread(ReadOncePerIteration, PollerType::eDefault).join();
+}
+
+TEST_CASE(ReadOncePerIterationET) {
+    std::thread(ReadOncePerIteration, PollerType::eEdgeTriggered).join();
+}
+
+TEST_MAIN()
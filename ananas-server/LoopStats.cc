@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <sstream>
+
+#include "LoopStats.h"
+
+namespace ananas {
+
+constexpr int Histogram::kBuckets;
+
+int Histogram::BucketOf(uint64_t value) {
+    if (value == 0)
+        return 0;
+
+    const int bits = 64 - __builtin_clzll(value);
+    return std::min(bits, kBuckets - 1);
+}
+
+double Histogram::Average() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+}
+
+uint64_t Histogram::Percentile(double p) const {
+    if (count == 0)
+        return 0;
+
+    const uint64_t rank = static_cast<uint64_t>(count * std::min(100.0, std::max(0.0, p)) / 100.0);
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++ i) {
+        seen += buckets[i];
+        if (seen > rank || seen == count)
+            return std::min<uint64_t>(max, i == 0 ? 0 : (1ULL << i) - 1);
+    }
+
+    return max;
+}
+
+void Histogram::Merge(const Histogram& other) {
+    for (int i = 0; i < kBuckets; ++ i)
+        buckets[i] += other.buckets[i];
+
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+void LoopStats::Merge(const LoopStats& other) {
+    iterations += other.iterations;
+    pollNs += other.pollNs;
+    handleNs += other.handleNs;
+    events += other.events;
+    eventsPerPoll.Merge(other.eventsPerPoll);
+
+    tasksRun += other.tasksRun;
+    tasksPending += other.tasksPending;
+    taskLatencyUs.Merge(other.taskLatencyUs);
+
+    timersFired += other.timersFired;
+    timerWakeups += other.timerWakeups;
+    timersCoalesced += other.timersCoalesced;
+
+    bufferAllocs += other.bufferAllocs;
+    bufferHits += other.bufferHits;
+    bufferRetainedBytes += other.bufferRetainedBytes;
+    bufferTrimmedBytes += other.bufferTrimmedBytes;
+
+    for (int i = 0; i < eCK_Max; ++ i)
+        channels[i] += other.channels[i];
+}
+
+std::string LoopStats::ToString() const {
+    std::ostringstream oss;
+    oss << "iterations " << iterations
+        << ", poll " << pollNs / 1000000 << "ms"
+        << ", handle " << handleNs / 1000000 << "ms"
+        << ", events " << events
+        << " (avg " << eventsPerPoll.Average()
+        << ", p99 " << eventsPerPoll.Percentile(99) << ")"
+        << ", tasks " << tasksRun
+        << ", pending " << tasksPending
+        << ", task latency avg " << taskLatencyUs.Average() << "us"
+        << ", p99 " << taskLatencyUs.Percentile(99) << "us"
+        << ", timers " << timersFired
+        << " (wakeups " << timerWakeups
+        << ", coalesced " << timersCoalesced << ")"
+        << ", buffer allocs " << bufferAllocs
+        << " (hits " << bufferHits
+        << ", retained " << bufferRetainedBytes / 1024 << "KB"
+        << ", trimmed " << bufferTrimmedBytes / 1024 << "KB)"
+        << ", acceptors " << channels[eCK_Acceptor]
+        << ", connections " << channels[eCK_Connection]
+        << ", datagrams " << channels[eCK_Datagram]
+        << ", others " << channels[eCK_Other];
+
+    return oss.str();
+}
+
+namespace internal {
+
+void LoopStatsCounters::AtomicHistogram::Record(uint64_t value) {
+    _Add(buckets[Histogram::BucketOf(value)], 1);
+    _Add(count, 1);
+    _Add(sum, value);
+    if (value > max.load(std::memory_order_relaxed))
+        max.store(value, std::memory_order_relaxed);
+}
+
+void LoopStatsCounters::AtomicHistogram::Load(Histogram& h) const {
+    for (int i = 0; i < Histogram::kBuckets; ++ i)
+        h.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+
+    h.count = count.load(std::memory_order_relaxed);
+    h.sum = sum.load(std::memory_order_relaxed);
+    h.max = max.load(std::memory_order_relaxed);
+}
+
+void LoopStatsCounters::OnPoll(int64_t ns, int events) {
+    _Add(pollNs_, static_cast<uint64_t>(std::max<int64_t>(0, ns)));
+    if (events > 0) {
+        _Add(events_, static_cast<uint64_t>(events));
+        eventsPerPoll_.Record(static_cast<uint64_t>(events));
+    } else {
+        eventsPerPoll_.Record(0);
+    }
+}
+
+void LoopStatsCounters::OnIteration(int64_t handleNs, std::size_t timersFired, std::size_t timersCoalesced) {
+    _Add(iterations_, 1);
+    _Add(handleNs_, static_cast<uint64_t>(std::max<int64_t>(0, handleNs)));
+    if (timersFired > 0) {
+        _Add(timersFired_, timersFired);
+        _Add(timerWakeups_, 1);
+        _Add(timersCoalesced_, timersCoalesced);
+    }
+}
+
+void LoopStatsCounters::OnTaskRun(int64_t latencyNs, bool counted) {
+    _Add(tasksRun_, 1);
+    if (counted)
+        _Add(countedRun_, 1);
+    if (latencyNs >= 0)
+        taskLatencyUs_.Record(static_cast<uint64_t>(latencyNs) / 1000);
+}
+
+uint64_t LoopStatsCounters::PendingTasks() const {
+    // counters are not loaded atomically as a whole, clamp it
+    const uint64_t run = countedRun_.load(std::memory_order_relaxed);
+    const uint64_t posted = tasksPosted_.load(std::memory_order_relaxed);
+    return posted > run ? posted - run : 0;
+}
+
+void LoopStatsCounters::OnChannel(LoopStats::ChannelKind kind, int delta) {
+    auto& c = channels_[kind];
+    c.store(c.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void LoopStatsCounters::ResetChannels() {
+    for (auto& c : channels_)
+        c.store(0, std::memory_order_relaxed);
+}
+
+void LoopStatsCounters::Snapshot(LoopStats& stats) const {
+    stats.iterations = iterations_.load(std::memory_order_relaxed);
+    stats.pollNs = pollNs_.load(std::memory_order_relaxed);
+    stats.handleNs = handleNs_.load(std::memory_order_relaxed);
+    stats.events = events_.load(std::memory_order_relaxed);
+    eventsPerPoll_.Load(stats.eventsPerPoll);
+
+    stats.tasksRun = tasksRun_.load(std::memory_order_relaxed);
+    stats.tasksPending = PendingTasks();
+    taskLatencyUs_.Load(stats.taskLatencyUs);
+
+    stats.timersFired = timersFired_.load(std::memory_order_relaxed);
+    stats.timerWakeups = timerWakeups_.load(std::memory_order_relaxed);
+    stats.timersCoalesced = timersCoalesced_.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < LoopStats::eCK_Max; ++ i)
+        stats.channels[i] = channels_[i].load(std::memory_order_relaxed);
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
@@ -0,0 +1,67 @@
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+
+namespace {
+
+using namespace std::chrono;
+
+const auto kDelay = milliseconds(20);
+
+// Busy for a while, so the cached clock of this iteration is stale,
+// then call schedule(loop, fired) and return how long the timer took.
+template <typename Schedule>
+steady_clock::duration AfterStaleClock(Schedule&& schedule) {
+    internal::EventLoopGroup group(0);
+    steady_clock::duration elapsed {0};
+
+    // one loop per thread
+    std::thread t([&]() {
+        EventLoop loop(&group);
+        loop.Post([&]() {
+            std::this_thread::sleep_for(milliseconds(50));
+
+            const auto start = steady_clock::now();
+            schedule(loop, [&group, &elapsed, start]() {
+                elapsed = steady_clock::now() - start;
+                group.Stop();
+            });
+        });
+        loop.Run();
+    });
+    t.join();
+
+    return elapsed;
+}
+
+} // end namespace
+
+TEST_CASE(ScheduleAfterNotEarly) {
+    const auto elapsed = AfterStaleClock([](EventLoop& loop, std::function<void ()> f) {
+        loop.ScheduleAfter(kDelay, std::move(f));
+    });
+    EXPECT_TRUE(elapsed >= kDelay);
+}
+
+TEST_CASE(RepeatNotEarly) {
+    const auto elapsed = AfterStaleClock([](EventLoop& loop, std::function<void ()> f) {
+        loop.ScheduleAfterWithRepeat<1>(kDelay, std::move(f));
+    });
+    EXPECT_TRUE(elapsed >= kDelay);
+}
+
+TEST_CASE(RescheduleAfterNotEarly) {
+    const auto elapsed = AfterStaleClock([](EventLoop& loop, std::function<void ()> f) {
+        auto id = loop.ScheduleAfter(seconds(10), std::move(f));
+        loop.RescheduleAfter(id, kDelay);
+    });
+    EXPECT_TRUE(elapsed >= kDelay);
+}
+
+TEST_MAIN()
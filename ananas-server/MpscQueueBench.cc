@@ -0,0 +1,108 @@
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/MpscQueue.h"
+#include "util/UniqueFunction.h"
+#include "Bench.h"
+
+// Cost of posting tasks to one consumer from 1/4/16 producers:
+// MpscQueue as EventLoop uses it, against the mutex + vector swap it
+// replaced.
+
+using ananas::bench::Stopwatch;
+
+namespace {
+
+const int kTasks = 4 * 1000 * 1000;
+
+struct Task : public ananas::internal::MpscNode {
+    explicit Task(ananas::UniqueFunction<void ()> f) : func(std::move(f)) {
+    }
+
+    ananas::UniqueFunction<void ()> func;
+};
+
+class MpscPath {
+public:
+    void Post(ananas::UniqueFunction<void ()> f) {
+        queue_.Push(new Task(std::move(f)));
+    }
+
+    void Drain() {
+        queue_.Consume([](Task* t) {
+            t->func();
+            delete t;
+        });
+    }
+
+private:
+    ananas::internal::MpscQueue<Task> queue_;
+};
+
+class MutexPath {
+public:
+    void Post(std::function<void ()> f) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        tasks_.push_back(std::move(f));
+    }
+
+    void Drain() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            running_.swap(tasks_);
+        }
+
+        for (auto& f : running_)
+            f();
+        running_.clear();
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::function<void ()> > tasks_;
+    std::vector<std::function<void ()> > running_;
+};
+
+template <typename Path>
+double Run(int producers) {
+    Path path;
+    std::atomic<int> done {0};
+    const int perProducer = kTasks / producers;
+
+    Stopwatch watch;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++ p) {
+        threads.emplace_back([&path, &done, perProducer]() {
+            for (int i = 0; i < perProducer; ++ i)
+                path.Post([&done]() {
+                    done.store(done.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+                });
+        });
+    }
+
+    while (done.load(std::memory_order_relaxed) < perProducer * producers)
+        path.Drain();
+
+    const double seconds = watch.Seconds();
+    for (auto& t : threads)
+        t.join();
+
+    return seconds * 1e9 / (perProducer * producers);
+}
+
+} // end namespace
+
+int main() {
+    printf("%-10s %14s %14s\n", "producers", "mutex ns/task", "mpsc ns/task");
+    for (int producers : {1, 4, 16}) {
+        const double mutex = Run<MutexPath>(producers);
+        const double mpsc = Run<MpscPath>(producers);
+        printf("%-10d %14.1f %14.1f\n", producers, mutex, mpsc);
+    }
+
+    return 0;
+}
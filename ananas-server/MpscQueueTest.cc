@@ -0,0 +1,231 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/time.h>
+
+#include "util/MpscQueue.h"
+#include "UnitTest.h"
+
+using ananas::internal::MpscNode;
+using ananas::internal::MpscQueue;
+
+namespace {
+
+std::atomic<int> g_alive {0};
+
+struct Item : public MpscNode {
+    explicit Item(int p, int s) : producer(p), seq(s) {
+        ++ g_alive;
+    }
+    ~Item() {
+        -- g_alive;
+    }
+
+    int producer;
+    int seq;
+};
+
+} // end namespace
+
+TEST_CASE(Fifo) {
+    MpscQueue<Item> q;
+    EXPECT_TRUE(q.Empty());
+    EXPECT_TRUE(q.Pop() == nullptr);
+
+    for (int i = 0; i < 10; ++ i)
+        q.Push(new Item(0, i));
+
+    EXPECT_TRUE(!q.Empty());
+    for (int i = 0; i < 10; ++ i) {
+        Item* item = q.Pop();
+        EXPECT_TRUE(item && item->seq == i);
+        delete item;
+    }
+
+    EXPECT_TRUE(q.Empty());
+    EXPECT_TRUE(q.Pop() == nullptr);
+}
+
+TEST_CASE(ConsumeMax) {
+    MpscQueue<Item> q;
+    for (int i = 0; i < 10; ++ i)
+        q.Push(new Item(0, i));
+
+    int next = 0;
+    auto f = [&next](Item* item) {
+        EXPECT_EQ(item->seq, next ++);
+        delete item;
+    };
+
+    EXPECT_EQ(q.Consume(f, 3), 3u);
+    EXPECT_EQ(q.Consume(f, 3), 3u);
+    EXPECT_EQ(q.Consume(f), 4u);
+    EXPECT_EQ(q.Consume(f), 0u);
+    EXPECT_TRUE(q.Empty());
+}
+
+TEST_CASE(ConsumeOnlyOldNodes) {
+    MpscQueue<Item> q;
+    q.Push(new Item(0, 0));
+    q.Push(new Item(0, 1));
+
+    // nodes pushed by f are left to next call
+    std::size_t n = q.Consume([&q](Item* item) {
+        q.Push(new Item(0, item->seq + 2));
+        delete item;
+    });
+    EXPECT_EQ(n, 2u);
+
+    n = q.Consume([](Item* item) {
+        delete item;
+    });
+    EXPECT_EQ(n, 2u);
+    EXPECT_TRUE(q.Empty());
+}
+
+TEST_CASE(DestructorDeletes) {
+    {
+        MpscQueue<Item> q;
+        for (int i = 0; i < 5; ++ i)
+            q.Push(new Item(0, i));
+    }
+
+    EXPECT_EQ(g_alive.load(), 0);
+}
+
+// Consume races with producers, every node must be consumed in the order
+// of its producer, and Consume must not return 0 while queue is not empty.
+TEST_CASE(Stress) {
+    const int kProducers = 4;
+    const int kPerProducer = 200000;
+
+    MpscQueue<Item> q;
+    std::atomic<int> started {0};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++ p) {
+        producers.emplace_back([&q, &started, p]() {
+            ++ started;
+            while (started < kProducers)
+                ;
+            for (int i = 0; i < kPerProducer; ++ i)
+                q.Push(new Item(p, i));
+        });
+    }
+
+    std::vector<int> next(kProducers, 0);
+    bool ordered = true;
+    auto f = [&next, &ordered](Item* item) {
+        if (item->seq != next[item->producer] ++)
+            ordered = false;
+        delete item;
+    };
+
+    int consumed = 0;
+    while (started < kProducers)
+        ;
+    while (consumed < kProducers * kPerProducer / 2)
+        consumed += static_cast<int>(q.Consume(f, 1 + consumed % 3));
+
+    for (auto& t : producers)
+        t.join();
+
+    int stuck = 0;
+    while (!q.Empty() && stuck < 1000) {
+        if (q.Consume(f, 1 + consumed % 3) == 0)
+            ++ stuck;
+        else
+            stuck = 0;
+
+        consumed = 0;
+        for (int n : next)
+            consumed += n;
+    }
+
+    EXPECT_EQ(stuck, 0);
+    EXPECT_TRUE(q.Empty());
+    EXPECT_TRUE(ordered);
+    for (int n : next)
+        EXPECT_EQ(n, kPerProducer);
+}
+
+namespace {
+
+struct Node : public MpscNode {
+};
+
+const int kSignalNodes = 20000;
+Node g_nodes[kSignalNodes * 2];
+std::atomic<int> g_used {0};
+MpscQueue<Node>* g_queue = nullptr;
+
+void PushOnSignal(int ) {
+    const int i = g_used.fetch_add(1);
+    if (i < kSignalNodes * 2)
+        g_queue->Push(&g_nodes[i]);
+}
+
+} // end namespace
+
+// Pop of the last node pushes stub behind it. A push between its check and
+// pushing stub leaves head as stub but the new node not consumed yet.
+// Real producers rarely hit that window, but a signal handler pushing on
+// the consumer thread interrupts Pop at any instruction.
+TEST_CASE(PushInterruptsPop) {
+    MpscQueue<Node> q;
+    g_queue = &q;
+
+    struct sigaction sa, old;
+    sa.sa_handler = PushOnSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, &old);
+
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+
+    itimerval interval {{0, 20}, {0, 20}};
+    setitimer(ITIMER_REAL, &interval, nullptr);
+
+    int consumed = 0;
+    int stuck = 0;
+    auto f = [&consumed](Node* ) {
+        ++ consumed;
+    };
+
+    while (g_used < kSignalNodes) {
+        // queue has only one node, so Pop always pushes stub
+        const int i = g_used.fetch_add(1);
+        q.Push(&g_nodes[i]);
+        q.Consume(f);
+
+        // no more push, must be drained
+        sigprocmask(SIG_BLOCK, &alarm, nullptr);
+        while (!q.Empty()) {
+            if (q.Consume(f) == 0) {
+                ++ stuck;
+                while (Node* node = q.Pop())
+                    f(node);
+                break;
+            }
+        }
+        sigprocmask(SIG_UNBLOCK, &alarm, nullptr);
+    }
+
+    itimerval stop {{0, 0}, {0, 0}};
+    setitimer(ITIMER_REAL, &stop, nullptr);
+    sigaction(SIGALRM, &old, nullptr);
+
+    sigprocmask(SIG_BLOCK, &alarm, nullptr);
+    while (Node* node = q.Pop())
+        f(node);
+    sigprocmask(SIG_UNBLOCK, &alarm, nullptr);
+
+    EXPECT_EQ(stuck, 0);
+    EXPECT_EQ(consumed, std::min(g_used.load(), kSignalNodes * 2));
+    g_queue = nullptr;
+}
+
+TEST_MAIN()
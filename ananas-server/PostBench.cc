@@ -0,0 +1,87 @@
+#include <atomic>
+#include <thread>
+
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "util/ThreadPool.h"
+
+#define ANANAS_BENCH_COUNT_ALLOCS
+#include "Bench.h"
+
+// Cost of posting a task from another thread: Post against Execute whose
+// future is ignored, on EventLoop and ThreadPool. Time is from the first
+// post until the last task runs, allocations are of both threads.
+
+using namespace ananas;
+
+namespace {
+
+const int kTasks = 1000 * 1000;
+
+struct Result {
+    double ns;
+    double allocs;
+};
+
+template <typename PostFunc>
+Result Measure(PostFunc&& post) {
+    std::atomic<int> done {0};
+
+    const uint64_t allocs = bench::Allocations();
+    bench::Stopwatch watch;
+    for (int i = 0; i < kTasks; ++ i) {
+        post([&done]() {
+            done.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+
+    while (done.load(std::memory_order_relaxed) < kTasks)
+        std::this_thread::yield();
+
+    Result r;
+    r.ns = watch.Seconds() * 1e9 / kTasks;
+    r.allocs = static_cast<double>(bench::Allocations() - allocs) / kTasks;
+    return r;
+}
+
+void Print(const char* name, const Result& r) {
+    printf("%-22s %10.1f %10.2f\n", name, r.ns, r.allocs);
+}
+
+} // end namespace
+
+int main() {
+    printf("%-22s %10s %10s\n", "", "ns/task", "allocs");
+
+    {
+        internal::EventLoopGroup group(1);
+        group.Start();
+        EventLoop* loop = group.Next();
+
+        Print("EventLoop::Post", Measure([loop](auto f) {
+            loop->Post(std::move(f));
+        }));
+        Print("EventLoop::Execute", Measure([loop](auto f) {
+            loop->Execute(std::move(f));
+        }));
+
+        group.Stop();
+        group.Wait();
+    }
+
+    {
+        ThreadPool pool;
+        pool.SetMaxThreads(1);
+
+        Print("ThreadPool::Post", Measure([&pool](auto f) {
+            pool.Post(std::move(f));
+        }));
+        Print("ThreadPool::Execute", Measure([&pool](auto f) {
+            pool.Execute(std::move(f));
+        }));
+
+        pool.JoinAll();
+    }
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "net/ReadSizer.h"
+#include "UnitTest.h"
+
+using ananas::internal::ReadSizer;
+
+TEST_CASE(GrowOnFullRead) {
+    ReadSizer sizer;
+    EXPECT_EQ(sizer.Guess(), ReadSizer::kInitSize);
+
+    // filled the space, may be more
+    EXPECT_TRUE(!sizer.Record(ReadSizer::kInitSize, ReadSizer::kInitSize));
+    EXPECT_EQ(sizer.Guess(), 2 * ReadSizer::kInitSize);
+
+    // space is larger than guess, reaching guess is enough
+    sizer.Record(2 * ReadSizer::kInitSize, 8 * ReadSizer::kInitSize);
+    EXPECT_EQ(sizer.Guess(), 4 * ReadSizer::kInitSize);
+
+    for (int i = 0; i < 20; ++ i)
+        sizer.Record(sizer.Guess(), sizer.Guess());
+    EXPECT_EQ(sizer.Guess(), ReadSizer::kMaxSize);
+}
+
+TEST_CASE(ShrinkAfterSmallReads) {
+    ReadSizer sizer;
+    const std::size_t guess = sizer.Guess();
+
+    for (int i = 1; i < ReadSizer::kShrinkAfter; ++ i)
+        EXPECT_TRUE(!sizer.Record(100, guess));
+    EXPECT_EQ(sizer.Guess(), guess);
+
+    EXPECT_TRUE(sizer.Record(100, guess));
+    EXPECT_EQ(sizer.Guess(), guess / 2);
+
+    for (int i = 0; i < 100; ++ i)
+        sizer.Record(100, sizer.Guess());
+    EXPECT_EQ(sizer.Guess(), ReadSizer::kMinSize);
+}
+
+// a burst does not make the guess thrash
+TEST_CASE(Hysteresis) {
+    ReadSizer sizer;
+    const std::size_t guess = sizer.Guess();
+
+    for (int round = 0; round < 10; ++ round) {
+        for (int i = 1; i < ReadSizer::kShrinkAfter; ++ i)
+            EXPECT_TRUE(!sizer.Record(100, guess));
+
+        // more than half of guess, not small
+        EXPECT_TRUE(!sizer.Record(guess / 2 + 1, guess));
+    }
+    EXPECT_EQ(sizer.Guess(), guess);
+
+    // a full read grows at once, then small reads take long to shrink it back
+    sizer.Record(guess, guess);
+    EXPECT_EQ(sizer.Guess(), 2 * guess);
+    for (int i = 1; i < ReadSizer::kShrinkAfter; ++ i)
+        sizer.Record(100, 2 * guess);
+    EXPECT_EQ(sizer.Guess(), 2 * guess);
+}
+
+TEST_MAIN()
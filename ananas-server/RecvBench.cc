@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "net/Connection.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "Bench.h"
+
+// Receive throughput of a Connection over TCP loopback, the peer writes
+// 1GB in chunks of several sizes. Reads per MB shows how far the read
+// size follows the peer; plain read(2) into a fixed 64KB buffer, with no
+// loop and no delivery, is the ceiling.
+
+using namespace ananas;
+
+namespace {
+
+const std::size_t kTotal = 1024 * 1024 * 1024;
+const std::size_t kPlainBuffer = 64 * 1024;
+
+void WriteAll(int fd, std::size_t chunk) {
+    std::vector<char> data(chunk, 'x');
+    for (std::size_t sent = 0; sent < kTotal; ) {
+        const ssize_t n = ::write(fd, data.data(), std::min(chunk, kTotal - sent));
+        if (n <= 0) {
+            perror("write");
+            ::exit(1);
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+}
+
+void Print(const char* name, std::size_t chunk, double seconds, uint64_t reads, double cpu) {
+    const double mb = static_cast<double>(kTotal) / (1024 * 1024);
+    printf("%-12s %8zuK %10.0f %12.2f %10.2f\n", name, chunk / 1024,
+           mb / seconds, reads / mb, cpu);
+}
+
+void RunConnection(std::size_t chunk) {
+    internal::EventLoopGroup group(1);
+    group.Start();
+    EventLoop* loop = group.Next();
+
+    int fds[2];
+    bench::TcpPair(fds); // reader, writer
+
+    std::atomic<uint64_t> received {0};
+    uint64_t reads = 0;
+    auto conn = std::make_shared<Connection>(loop);
+    conn->Init(fds[0], SocketAddr());
+    conn->SetOnMessage([&](Connection* , const char* , PacketLen_t len) {
+        ++ reads;
+        received.store(received.load(std::memory_order_relaxed) + len, std::memory_order_release);
+        return len;
+    });
+    loop->Execute([loop, conn]() {
+        loop->Register(internal::eET_Read, conn);
+    }).Wait();
+
+    const double cpu = bench::CpuSeconds();
+    bench::Stopwatch watch;
+    WriteAll(fds[1], chunk);
+    while (received.load(std::memory_order_acquire) < kTotal)
+        std::this_thread::yield();
+
+    Print("Connection", chunk, watch.Seconds(), reads, bench::CpuSeconds() - cpu);
+
+    loop->Execute([loop, conn]() {
+        loop->Unregister(internal::eET_Read, conn);
+    }).Wait();
+    ::close(fds[1]);
+
+    group.Stop();
+    group.Wait();
+}
+
+void RunPlain(std::size_t chunk) {
+    int fds[2];
+    bench::TcpPair(fds); // reader, writer
+
+    uint64_t reads = 0;
+    std::thread reader([&]() {
+        std::vector<char> buf(kPlainBuffer);
+        for (std::size_t got = 0; got < kTotal; ++ reads) {
+            const ssize_t n = ::read(fds[0], buf.data(), buf.size());
+            if (n <= 0) {
+                perror("read");
+                ::exit(1);
+            }
+            got += static_cast<std::size_t>(n);
+        }
+    });
+
+    const double cpu = bench::CpuSeconds();
+    bench::Stopwatch watch;
+    WriteAll(fds[1], chunk);
+    reader.join();
+
+    Print("plain 64K", chunk, watch.Seconds(), reads, bench::CpuSeconds() - cpu);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+} // end namespace
+
+int main() {
+    printf("1GB over TCP loopback\n");
+    printf("%-12s %9s %10s %12s %10s\n", "reader", "chunk", "MB/s", "reads/MB", "cpu s");
+
+    for (std::size_t chunk : {std::size_t(1024), std::size_t(64 * 1024), std::size_t(4 * 1024 * 1024)}) {
+        RunConnection(chunk);
+        RunPlain(chunk);
+    }
+
+    return 0;
+}
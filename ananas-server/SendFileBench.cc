@@ -0,0 +1,134 @@
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "net/Connection.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "Bench.h"
+
+// Send a 1GB file over TCP loopback: Connection::SendFile against pread
+// into a 1MB buffer then SendPacket, next chunk on write complete. The
+// file is in page cache. CPU is of both sides, the reader is the same.
+
+using namespace ananas;
+
+namespace {
+
+const std::size_t kFileSize = 1024 * 1024 * 1024;
+const std::size_t kChunk = 1024 * 1024;
+
+int MakeFile() {
+    char path[] = "/tmp/ananas_sendfile_XXXXXX";
+    const int fd = ::mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        ::exit(1);
+    }
+    ::unlink(path);
+
+    std::vector<char> data(kChunk);
+    for (std::size_t i = 0; i < data.size(); ++ i)
+        data[i] = static_cast<char>(i * 31);
+    for (std::size_t off = 0; off < kFileSize; off += kChunk) {
+        if (::write(fd, data.data(), kChunk) != static_cast<ssize_t>(kChunk)) {
+            perror("write");
+            ::exit(1);
+        }
+    }
+
+    return fd;
+}
+
+// pread chunk by chunk, next one when the last is sent
+struct Copier {
+    int fd;
+    off_t offset = 0;
+    std::vector<char> buf = std::vector<char>(kChunk);
+
+    void Next(Connection* conn) {
+        if (offset >= static_cast<off_t>(kFileSize))
+            return;
+
+        const ssize_t n = ::pread(fd, buf.data(), buf.size(), offset);
+        if (n <= 0) {
+            perror("pread");
+            ::exit(1);
+        }
+
+        offset += n;
+        conn->SendPacket(buf.data(), static_cast<std::size_t>(n));
+    }
+};
+
+void Run(const char* name, int file, bool sendfile) {
+    internal::EventLoopGroup group(1);
+    group.Start();
+    EventLoop* loop = group.Next();
+
+    int fds[2];
+    bench::TcpPair(fds); // sender, reader
+
+    auto conn = std::make_shared<Connection>(loop);
+    conn->Init(fds[0], SocketAddr());
+    auto copier = std::make_shared<Copier>();
+    copier->fd = file;
+
+    const double cpu = bench::CpuSeconds();
+    bench::Stopwatch watch;
+    loop->Execute([=]() {
+        loop->Register(internal::eET_Read, conn);
+        if (sendfile) {
+            conn->SendFile(file, 0, kFileSize);
+        } else {
+            conn->SetOnWriteComplete([copier](Connection* c) {
+                copier->Next(c);
+            });
+            copier->Next(conn.get());
+        }
+    });
+
+    std::vector<char> buf(kChunk);
+    for (std::size_t got = 0; got < kFileSize; ) {
+        const ssize_t n = ::read(fds[1], buf.data(), buf.size());
+        if (n <= 0) {
+            perror("read");
+            ::exit(1);
+        }
+        got += static_cast<std::size_t>(n);
+    }
+
+    const double seconds = watch.Seconds();
+    printf("%-12s %10.0f %10.2f\n", name, kFileSize / (1024.0 * 1024) / seconds,
+           bench::CpuSeconds() - cpu);
+
+    loop->Execute([loop, conn]() {
+        loop->Unregister(internal::eET_Read, conn);
+    }).Wait();
+    ::close(fds[1]);
+
+    group.Stop();
+    group.Wait();
+}
+
+} // end namespace
+
+int main() {
+    const int file = MakeFile();
+
+    // warm page cache
+    std::vector<char> buf(kChunk);
+    for (off_t off = 0; ::pread(file, buf.data(), buf.size(), off) > 0; off += kChunk)
+        ;
+
+    printf("1GB file over TCP loopback\n");
+    printf("%-12s %10s %10s\n", "sender", "MB/s", "cpu s");
+    Run("SendFile", file, true);
+    Run("pread+send", file, false);
+
+    ::close(file);
+    return 0;
+}
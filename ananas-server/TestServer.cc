@@ -5,6 +5,9 @@
 #include "net/Application.h"
 #include "util/Logger.h"
 
+#include <iostream>
+using namespace std;
+
 std::shared_ptr<ananas::Logger> logger;
 
 ananas::PacketLen_t OnMessage(ananas::Connection* conn, const char* data, ananas::PacketLen_t len) {
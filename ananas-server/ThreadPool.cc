@@ -1,6 +1,9 @@
 #include <cassert>
 #include "ThreadPool.h"
 
+#include <iostream>
+using namespace std;
+
 namespace ananas {
 
 thread_local bool ThreadPool::working_ = true;
@@ -75,7 +78,7 @@ void ThreadPool::_WorkerRoutine() {
     working_ = true;
 
     while (working_) {
-        std::function<void ()> task;
+        UniqueFunction<void ()> task;
 
         {
             std::unique_lock<std::mutex> guard(mutex_);
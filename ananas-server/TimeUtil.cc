@@ -1,12 +1,32 @@
 #include <cstring>
+#include <time.h>
 #include "TimeUtil.h"
 
 namespace ananas {
 
+#if defined(__gnu_linux__)
+std::chrono::system_clock::time_point CoarseClock::SystemNow() {
+    using namespace std::chrono;
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return system_clock::time_point(duration_cast<system_clock::duration>(seconds(ts.tv_sec) +
+                                                                          nanoseconds(ts.tv_nsec)));
+}
+#else
+std::chrono::system_clock::time_point CoarseClock::SystemNow() {
+    return std::chrono::system_clock::now();
+}
+#endif
+
 Time::Time() : valid_(false) {
     this->Now();
 }
 
+Time::Time(const std::chrono::system_clock::time_point& tp) :
+    now_(tp),
+    valid_(false) {
+}
+
 int64_t Time::MilliSeconds() const {
     return std::chrono::duration_cast<std::chrono::milliseconds>(now_.time_since_epoch()).count();
 }
@@ -0,0 +1,72 @@
+#include <random>
+#include <vector>
+
+#include "util/Timer.h"
+#include "Bench.h"
+
+// 1M pending timers spread over 60s, map against wheel backend: schedule,
+// reschedule (idle timeout refresh), cancel, and expiry while time steps
+// by 1ms. Time is driven by Update(now).
+
+using namespace ananas;
+using ananas::internal::TimerManager;
+
+namespace {
+
+using namespace std::chrono;
+
+const int kTimers = 1000 * 1000;
+const int64_t kSpanUs = 60LL * 1000 * 1000;
+
+void Run(const char* name, TimerBackend backend) {
+    TimerManager timers(backend);
+    const TimePoint base = steady_clock::now();
+
+    std::mt19937 rand(3);
+    std::vector<TimePoint> when(kTimers);
+    for (auto& w : when)
+        w = base + microseconds(rand() % kSpanUs);
+
+    std::vector<TimerId> ids(kTimers);
+    long fired = 0;
+
+    bench::Stopwatch watch;
+    for (int i = 0; i < kTimers; ++ i)
+        ids[i] = timers.ScheduleAt(when[i], [&fired]() { ++ fired; });
+    const double scheduleNs = watch.Seconds() * 1e9 / kTimers;
+
+    watch = bench::Stopwatch();
+    for (int i = 0; i < kTimers; ++ i)
+        timers.RescheduleAt(ids[i], when[kTimers - 1 - i]);
+    const double rescheduleNs = watch.Seconds() * 1e9 / kTimers;
+
+    // half canceled
+    watch = bench::Stopwatch();
+    for (int i = 0; i < kTimers; i += 2)
+        timers.Cancel(ids[i]);
+    const double cancelNs = watch.Seconds() * 1e9 / (kTimers / 2);
+
+    std::size_t updates = 0;
+    watch = bench::Stopwatch();
+    for (TimePoint now = base; timers.Size() > 0; now += milliseconds(1)) {
+        timers.Update(now);
+        ++ updates;
+    }
+    const double expireNs = watch.Seconds() * 1e9 / fired;
+
+    printf("%-8s %12.1f %12.1f %12.1f %12.1f %10zu\n", name,
+           scheduleNs, rescheduleNs, cancelNs, expireNs, updates);
+}
+
+} // end namespace
+
+int main() {
+    printf("%d timers over %lds, ns per timer\n", kTimers, static_cast<long>(kSpanUs / 1000000));
+    printf("%-8s %12s %12s %12s %12s %10s\n", "backend", "schedule", "reschedule",
+           "cancel", "expire", "updates");
+
+    Run("map", TimerBackend::eMap);
+    Run("wheel", TimerBackend::eWheel);
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <random>
+
+#include "util/Timer.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+using ananas::internal::TimerManager;
+
+namespace {
+
+using namespace std::chrono;
+
+const int kTimers = 1000;
+
+struct Wakeups {
+    std::size_t wakeups = 0;
+    std::size_t fired = 0;
+    uint64_t coalesced = 0;
+};
+
+// 1000 timers over 1s, woken exactly at the nearest deadline
+Wakeups Run(TimerBackend backend, TimerSlack slack) {
+    TimerManager timers(backend);
+    const TimePoint base = steady_clock::now();
+
+    std::mt19937 rand(5);
+    for (int i = 0; i < kTimers; ++ i)
+        timers.ScheduleAt(base + microseconds(rand() % 1000000), slack, []() { });
+
+    Wakeups w;
+    while (timers.Size() > 0) {
+        // wheel may stop at a cascade point
+        const std::size_t n = timers.Update(timers.NearestTimePoint());
+        if (n > 0) {
+            ++ w.wakeups;
+            w.fired += n;
+        }
+    }
+
+    w.coalesced = timers.Coalesced();
+    return w;
+}
+
+void ExpectFewerWakeups(TimerBackend backend) {
+    const Wakeups exact = Run(backend, TimerSlack());
+    EXPECT_EQ(exact.fired, static_cast<std::size_t>(kTimers));
+    EXPECT_EQ(exact.coalesced, 0u);
+
+    const Wakeups slack = Run(backend, TimerSlack(milliseconds(50)));
+    EXPECT_EQ(slack.fired, static_cast<std::size_t>(kTimers));
+    // grid of 32.768ms
+    EXPECT_TRUE(slack.wakeups <= 1000 / 32 + 1);
+    EXPECT_TRUE(slack.wakeups * 10 < exact.wakeups);
+    // every timer but the first of a wakeup was merged
+    EXPECT_EQ(slack.coalesced, slack.fired - slack.wakeups);
+}
+
+} // end namespace
+
+TEST_CASE(FewerWakeupsMap) {
+    ExpectFewerWakeups(TimerBackend::eMap);
+}
+
+TEST_CASE(FewerWakeupsWheel) {
+    ExpectFewerWakeups(TimerBackend::eWheel);
+}
+
+// Overdue together is not coalescing
+TEST_CASE(OverdueNotCoalesced) {
+    TimerManager timers;
+    const TimePoint base = steady_clock::now();
+    for (int i = 0; i < 10; ++ i)
+        timers.ScheduleAt(base + milliseconds(i), []() { });
+
+    EXPECT_EQ(timers.Update(base + seconds(1)), 10u);
+    EXPECT_EQ(timers.Coalesced(), 0u);
+}
+
+// Deferred into the wakeup of a timer without slack
+TEST_CASE(MergedIntoExact) {
+    TimerManager timers;
+    const TimePoint base = steady_clock::now();
+    // slack grid is in power of 2 microseconds
+    const auto step = microseconds(1 << 16);
+    const TimePoint grid = base + step - base.time_since_epoch() % step;
+
+    timers.ScheduleAt(grid, []() { });
+    timers.ScheduleAt(grid - milliseconds(10), TimerSlack(milliseconds(40)), []() { });
+
+    EXPECT_TRUE(timers.NearestTimePoint() == grid);
+    EXPECT_EQ(timers.Update(grid), 2u);
+    EXPECT_EQ(timers.Coalesced(), 1u);
+}
+
+TEST_MAIN()
@@ -0,0 +1,83 @@
+
+#ifdef __gnu_linux__
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <cassert>
+
+#include "TimerfdChannel.h"
+
+namespace ananas {
+
+namespace internal {
+
+TimerfdChannel::TimerfdChannel() :
+    deadline_(TimePoint::max()) {
+    // steady_clock is CLOCK_MONOTONIC on linux
+    timerFd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    assert (timerFd_ >= 0);
+}
+
+TimerfdChannel::~TimerfdChannel() {
+    ::close(timerFd_);
+}
+
+int TimerfdChannel::Identifier() const {
+    return timerFd_;
+}
+
+bool TimerfdChannel::HandleReadEvent() {
+    // timers are run by loop, just reset the expiration count
+    uint64_t cnt = 0;
+    auto n = ::read(timerFd_, &cnt, sizeof cnt);
+
+    // one shot, fired
+    deadline_ = TimePoint::max();
+    return n == sizeof cnt || errno == EAGAIN;
+}
+
+bool TimerfdChannel::HandleWriteEvent() {
+    assert (false);
+    return false;
+}
+
+void TimerfdChannel::HandleErrorEvent() {
+}
+
+bool TimerfdChannel::SetDeadline(const TimePoint& deadline) {
+    if (deadline == deadline_)
+        return true;
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 0;
+
+    if (deadline == TimePoint::max()) {
+        // disarm
+        spec.it_value.tv_sec = 0;
+        spec.it_value.tv_nsec = 0;
+    } else {
+        using namespace std::chrono;
+        auto ns = duration_cast<nanoseconds>(deadline.time_since_epoch()).count();
+        if (ns <= 0)
+            ns = 1; // zero value means disarm
+
+        spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+        spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+    }
+
+    if (::timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0)
+        return false;
+
+    deadline_ = deadline;
+    return true;
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif // end #ifdef __gnu_linux__
+
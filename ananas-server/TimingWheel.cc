@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cassert>
+#include "TimingWheel.h"
+
+namespace ananas {
+namespace internal {
+
+constexpr uint32_t TimerManager::TimingWheel::kNil;
+constexpr int TimerManager::TimingWheel::kLevels;
+constexpr int TimerManager::TimingWheel::kRootBits;
+constexpr int TimerManager::TimingWheel::kLevelBits;
+constexpr uint64_t TimerManager::TimingWheel::kRootSlots;
+constexpr uint64_t TimerManager::TimingWheel::kLevelSlots;
+constexpr uint64_t TimerManager::TimingWheel::kMaxDelta;
+constexpr uint64_t TimerManager::TimingWheel::kNever;
+constexpr uint32_t TimerManager::TimingWheel::kNumSlots;
+constexpr uint32_t TimerManager::TimingWheel::kDueList;
+
+// distance from start to the first set bit, circularly; -1 if none
+static int FindNextBit(const uint64_t* words, int nbits, int start) {
+    for (int d = 0; d < nbits; ) {
+        const int i = (start + d) % nbits;
+        const uint64_t w = words[i / 64] >> (i % 64);
+        if (w)
+            return d + __builtin_ctzll(w);
+
+        d += 64 - i % 64;
+    }
+
+    return -1;
+}
+
+TimerManager::TimingWheel::TimingWheel(const TimePoint& base) :
+    base_(base) {
+    std::fill(std::begin(heads_), std::end(heads_), kNil);
+    std::fill(std::begin(occupied_), std::end(occupied_), 0);
+}
+
+void TimerManager::TimingWheel::Add(uint32_t index, const TimePoint& when) {
+    if (index >= links_.size())
+        links_.resize(index + 1);
+
+    assert (links_[index].list == kNil);
+    links_[index].tick = _TickOf(when, true);
+    _Place(index);
+    ++ size_;
+}
+
+void TimerManager::TimingWheel::Remove(uint32_t index) {
+    _Unlink(index);
+    -- size_;
+}
+
+uint32_t TimerManager::TimingWheel::PopExpired(const TimePoint& now) {
+    const uint64_t nowTick = _TickOf(now, false);
+
+    while (heads_[kDueList] == kNil) {
+        if (current_ >= nowTick)
+            return kNil;
+
+        const uint64_t next = _NextTick();
+        if (next > nowTick) {
+            current_ = nowTick;
+            return kNil;
+        }
+
+        current_ = next;
+        for (int level = 1; level < kLevels; ++ level) {
+            if (current_ & ((uint64_t(1) << _Shift(level)) - 1))
+                break;
+
+            _Cascade(level);
+        }
+        _ExpireRoot();
+    }
+
+    const uint32_t index = heads_[kDueList];
+    Remove(index);
+    return index;
+}
+
+TimePoint TimerManager::TimingWheel::NearestTimePoint() const {
+    if (size_ == 0)
+        return TimePoint::max();
+
+    const uint64_t next = heads_[kDueList] != kNil ? current_ : _NextTick();
+    if (next == kNever)
+        return TimePoint::max();
+
+    return base_ + DurationMs(next);
+}
+
+int TimerManager::TimingWheel::_Shift(int level) {
+    return level == 0 ? 0 : kRootBits + (level - 1) * kLevelBits;
+}
+
+uint64_t TimerManager::TimingWheel::_TickOf(const TimePoint& tp, bool roundUp) const {
+    if (tp <= base_)
+        return 0;
+
+    const auto elapsed = tp - base_;
+    const auto ms = std::chrono::duration_cast<DurationMs>(elapsed);
+    uint64_t tick = static_cast<uint64_t>(ms.count());
+    if (roundUp && ms < elapsed)
+        ++ tick;
+
+    return tick;
+}
+
+void TimerManager::TimingWheel::_Place(uint32_t index) {
+    const uint64_t tick = links_[index].tick;
+    if (tick <= current_) {
+        _Link(index, kDueList);
+        return;
+    }
+
+    const uint64_t delta = tick - current_;
+    if (delta < kRootSlots) {
+        _Link(index, static_cast<uint32_t>(tick & (kRootSlots - 1)));
+        return;
+    }
+
+    // too far, wait in the last level and be placed again when cascaded
+    const uint64_t t = delta < kMaxDelta ? tick : current_ + kMaxDelta - 1;
+    int level = 1;
+    while (level < kLevels - 1 && delta >= (uint64_t(1) << _Shift(level + 1)))
+        ++ level;
+
+    const uint64_t slot = (t >> _Shift(level)) & (kLevelSlots - 1);
+    _Link(index, static_cast<uint32_t>(kRootSlots + (level - 1) * kLevelSlots + slot));
+}
+
+void TimerManager::TimingWheel::_Link(uint32_t index, uint32_t list) {
+    Link& l = links_[index];
+    l.list = list;
+    l.prev = kNil;
+    l.next = heads_[list];
+    if (l.next != kNil)
+        links_[l.next].prev = index;
+    heads_[list] = index;
+
+    if (list < kNumSlots)
+        occupied_[list / 64] |= uint64_t(1) << (list % 64);
+}
+
+void TimerManager::TimingWheel::_Unlink(uint32_t index) {
+    Link& l = links_[index];
+    const uint32_t list = l.list;
+    assert (list <= kDueList);
+
+    if (l.prev != kNil)
+        links_[l.prev].next = l.next;
+    else
+        heads_[list] = l.next;
+
+    if (l.next != kNil)
+        links_[l.next].prev = l.prev;
+
+    l.prev = l.next = kNil;
+    l.list = kNil;
+
+    if (list < kNumSlots && heads_[list] == kNil)
+        occupied_[list / 64] &= ~(uint64_t(1) << (list % 64));
+}
+
+void TimerManager::TimingWheel::_Cascade(int level) {
+    const uint64_t slot = (current_ >> _Shift(level)) & (kLevelSlots - 1);
+    const uint32_t list = static_cast<uint32_t>(kRootSlots + (level - 1) * kLevelSlots + slot);
+
+    while (heads_[list] != kNil) {
+        const uint32_t index = heads_[list];
+        _Unlink(index);
+        _Place(index);
+    }
+}
+
+void TimerManager::TimingWheel::_ExpireRoot() {
+    const uint32_t list = static_cast<uint32_t>(current_ & (kRootSlots - 1));
+    while (heads_[list] != kNil) {
+        const uint32_t index = heads_[list];
+        _Unlink(index);
+        _Place(index); // to due list
+    }
+}
+
+uint64_t TimerManager::TimingWheel::_NextTick() const {
+    uint64_t next = kNever;
+
+    // level 0 holds ticks in (current_, current_ + kRootSlots)
+    int d = FindNextBit(occupied_, static_cast<int>(kRootSlots), static_cast<int>((current_ + 1) & (kRootSlots - 1)));
+    if (d >= 0)
+        next = current_ + 1 + d;
+
+    // slot of higher level is due when current_ reaches its start
+    for (int level = 1; level < kLevels; ++ level) {
+        const uint64_t* word = &occupied_[(kRootSlots + (level - 1) * kLevelSlots) / 64];
+        const uint64_t base = current_ >> _Shift(level);
+        d = FindNextBit(word, static_cast<int>(kLevelSlots), static_cast<int>((base + 1) & (kLevelSlots - 1)));
+        if (d >= 0)
+            next = std::min(next, (base + 1 + d) << _Shift(level));
+    }
+
+    return next;
+}
+
+} // end namespace internal
+} // end namespace ananas
+
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "util/Timer.h"
+#include "UnitTest.h"
+
+// Time is driven by Update(now), so days pass in no time.
+
+using namespace ananas;
+using ananas::internal::TimerManager;
+
+namespace {
+
+using namespace std::chrono;
+
+TimePoint Start() {
+    return steady_clock::now();
+}
+
+} // end namespace
+
+TEST_CASE(AllLevels) {
+    TimerManager timers(TimerBackend::eWheel);
+    const TimePoint base = Start();
+
+    // both sides of every level boundary, plus a sub-tick part
+    const std::vector<int64_t> ms = {
+        3, 255, 258, 16383, 16386, 1048575, 1048578,
+        67108863, 67108866, 4294967295LL, 4294967298LL,
+        // beyond the last level, 60 days
+        5184000000LL,
+    };
+
+    std::vector<TimePoint> deadlines;
+    std::vector<TimePoint> firedAt;
+    TimePoint now = base;
+    for (auto d : ms) {
+        deadlines.push_back(base + milliseconds(d) + microseconds(300));
+        timers.ScheduleAt(deadlines.back(), [&firedAt, &now]() {
+            firedAt.push_back(now);
+        });
+    }
+
+    for (std::size_t i = 0; i < deadlines.size(); ++ i) {
+        now = deadlines[i] - milliseconds(1);
+        timers.Update(now);
+        EXPECT_EQ(firedAt.size(), i);
+
+        now = deadlines[i] + milliseconds(1);
+        timers.Update(now);
+        EXPECT_EQ(firedAt.size(), i + 1);
+    }
+
+    for (std::size_t i = 0; i < firedAt.size(); ++ i)
+        EXPECT_TRUE(firedAt[i] >= deadlines[i]);
+
+    EXPECT_EQ(timers.Size(), 0u);
+    EXPECT_TRUE(timers.NearestTimePoint() == TimePoint::max());
+}
+
+TEST_CASE(NeverEarlyNeverLate) {
+    TimerManager timers(TimerBackend::eWheel);
+    const TimePoint base = Start();
+    const int kTimers = 10000;
+    const auto kSpan = milliseconds(20 * 1000);
+
+    std::mt19937 rand(17);
+    std::vector<TimePoint> deadlines(kTimers);
+    std::vector<TimerId> ids(kTimers);
+    std::vector<bool> fired(kTimers), canceled(kTimers);
+
+    // time steps by 1ms, so not fired in the step before means not late
+    TimePoint now = base;
+    bool early = false, late = false;
+    for (int i = 0; i < kTimers; ++ i) {
+        deadlines[i] = base + microseconds(rand() % (kSpan.count() * 1000));
+        ids[i] = timers.ScheduleAt(deadlines[i], [&, i]() {
+            early |= now < deadlines[i];
+            late |= now - deadlines[i] >= milliseconds(2);
+            fired[i] = true;
+        });
+    }
+
+    // a quarter canceled, a quarter moved
+    for (int i = 0; i < kTimers; ++ i) {
+        if (i % 4 == 1) {
+            EXPECT_TRUE(timers.Cancel(ids[i]));
+            canceled[i] = true;
+        } else if (i % 4 == 2) {
+            deadlines[i] = base + microseconds(rand() % (kSpan.count() * 1000));
+            EXPECT_TRUE(timers.RescheduleAt(ids[i], deadlines[i]));
+        }
+    }
+
+    for (now = base; now <= base + kSpan + milliseconds(2); now += milliseconds(1))
+        timers.Update(now);
+
+    EXPECT_TRUE(!early);
+    EXPECT_TRUE(!late);
+    EXPECT_EQ(timers.Size(), 0u);
+    for (int i = 0; i < kTimers; ++ i)
+        EXPECT_TRUE(fired[i] != canceled[i]);
+}
+
+TEST_CASE(RepeatAndCancelSelf) {
+    TimerManager timers(TimerBackend::eWheel);
+    const TimePoint base = Start();
+
+    int count = 0;
+    TimerId id;
+    id = timers.ScheduleAtWithRepeat<kForever>(base + milliseconds(10), milliseconds(10),
+                                               [&]() {
+        if (++ count == 3)
+            timers.Cancel(id);
+    });
+
+    for (int ms = 0; ms <= 100; ++ ms)
+        timers.Update(base + milliseconds(ms));
+
+    EXPECT_EQ(count, 3);
+    EXPECT_EQ(timers.Size(), 0u);
+    EXPECT_TRUE(!timers.Cancel(id)); // stale
+}
+
+TEST_CASE(MaxPerUpdate) {
+    TimerManager timers(TimerBackend::eWheel);
+    const TimePoint base = Start();
+
+    int count = 0;
+    for (int i = 0; i < 10; ++ i)
+        timers.ScheduleAt(base + milliseconds(5), [&count]() { ++ count; });
+
+    EXPECT_EQ(timers.Update(base + milliseconds(10), 4), 4u);
+    EXPECT_EQ(timers.Update(base + milliseconds(10), 4), 4u);
+    EXPECT_EQ(timers.Update(base + milliseconds(10), 4), 2u);
+    EXPECT_EQ(count, 10);
+}
+
+TEST_CASE(SwitchBackend) {
+    TimerManager timers(TimerBackend::eMap);
+    const TimePoint base = Start();
+
+    std::vector<int> order;
+    for (int i = 0; i < 3; ++ i)
+        timers.ScheduleAt(base + seconds(3 - i), [&order, i]() { order.push_back(i); });
+
+    timers.SetBackend(TimerBackend::eWheel);
+    EXPECT_TRUE(timers.Backend() == TimerBackend::eWheel);
+    EXPECT_EQ(timers.Size(), 3u);
+    // lower bound, may be a cascade point
+    EXPECT_TRUE(timers.NearestTimePoint() <= base + seconds(1) + milliseconds(1));
+
+    for (int s = 1; s <= 3; ++ s)
+        timers.Update(base + seconds(s) + milliseconds(1));
+
+    EXPECT_TRUE(order == std::vector<int>({2, 1, 0}));
+}
+
+TEST_MAIN()
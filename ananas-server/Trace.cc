@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include "Trace.h"
+
+namespace ananas {
+
+namespace {
+
+// Single writer: the owner thread.
+// Fields are relaxed atomics so that collecting from another thread is
+// not a data race, they're plain moves on common platforms.
+class TraceRing {
+public:
+    static constexpr uint64_t kCapacity = 4096; // power of 2
+
+    explicit
+    TraceRing(uint64_t thread) : thread_(thread) {
+    }
+
+    void Record(const char* name, uint64_t arg) {
+        const uint64_t seq = next_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[seq & (kCapacity - 1)];
+
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now().time_since_epoch()).count();
+        slot.ns.store(ns, std::memory_order_relaxed);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.arg.store(arg, std::memory_order_relaxed);
+
+        next_.store(seq + 1, std::memory_order_release);
+    }
+
+    void Collect(std::vector<TraceEvent>& out) const {
+        const uint64_t end = next_.load(std::memory_order_acquire);
+        const uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+
+        const size_t base = out.size();
+        for (uint64_t seq = begin; seq < end; ++ seq) {
+            const Slot& slot = slots_[seq & (kCapacity - 1)];
+
+            TraceEvent ev;
+            ev.ns = slot.ns.load(std::memory_order_relaxed);
+            ev.thread = thread_;
+            ev.name = slot.name.load(std::memory_order_relaxed);
+            ev.arg = slot.arg.load(std::memory_order_relaxed);
+            out.push_back(ev);
+        }
+
+        // drop slots the writer may have reused while we were reading
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t now = next_.load(std::memory_order_relaxed);
+        if (now > begin + kCapacity) {
+            const uint64_t lost = std::min(now - begin - kCapacity, end - begin);
+            out.erase(out.begin() + base, out.begin() + base + lost);
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<int64_t> ns {0};
+        std::atomic<const char* > name {nullptr};
+        std::atomic<uint64_t> arg {0};
+    };
+
+    const uint64_t thread_;
+    std::atomic<uint64_t> next_ {0};
+    Slot slots_[kCapacity];
+};
+
+std::mutex s_ringsMutex;
+// rings outlive their threads, so traces of exited threads can be dumped
+std::vector<std::shared_ptr<TraceRing> > s_rings;
+
+TraceRing* ThisThreadRing() {
+    thread_local TraceRing* ring = nullptr;
+    if (!ring) {
+        std::unique_lock<std::mutex> guard(s_ringsMutex);
+        s_rings.push_back(std::make_shared<TraceRing>(s_rings.size() + 1));
+        ring = s_rings.back().get();
+    }
+
+    return ring;
+}
+
+} // end namespace
+
+namespace internal {
+
+void TraceRecord(const char* name, uint64_t arg) {
+    ThisThreadRing()->Record(name, arg);
+}
+
+} // end namespace internal
+
+std::vector<TraceEvent> CollectTraces() {
+    decltype(s_rings) rings;
+    {
+        std::unique_lock<std::mutex> guard(s_ringsMutex);
+        rings = s_rings;
+    }
+
+    std::vector<TraceEvent> events;
+    for (const auto& ring : rings)
+        ring->Collect(events);
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TraceEvent& a, const TraceEvent& b) {
+                         return a.ns < b.ns;
+                     });
+    return events;
+}
+
+void DumpTraces(FILE* fp) {
+    const auto events = CollectTraces();
+    for (const auto& ev : events) {
+        fprintf(fp, "%lld.%09lld [%llu] %s %#llx\n",
+                static_cast<long long>(ev.ns / 1000000000),
+                static_cast<long long>(ev.ns % 1000000000),
+                static_cast<unsigned long long>(ev.thread),
+                ev.name,
+                static_cast<unsigned long long>(ev.arg));
+    }
+}
+
+} // end namespace ananas
+
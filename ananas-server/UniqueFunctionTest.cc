@@ -0,0 +1,104 @@
+#include <memory>
+#include <string>
+
+#include "util/UniqueFunction.h"
+#include "UnitTest.h"
+
+using ananas::UniqueFunction;
+
+namespace {
+
+int Twice(int x) {
+    return 2 * x;
+}
+
+} // end namespace
+
+TEST_CASE(Empty) {
+    UniqueFunction<void ()> f;
+    EXPECT_TRUE(!f);
+    EXPECT_TRUE(!UniqueFunction<void ()>(nullptr));
+
+    int (*null)(int) = nullptr;
+    EXPECT_TRUE(!UniqueFunction<int (int)>(null));
+    EXPECT_TRUE(!UniqueFunction<void ()>(std::function<void ()>()));
+}
+
+TEST_CASE(InlineAndHeap) {
+    UniqueFunction<int (int)> small(Twice);
+    EXPECT_TRUE(small.IsInline());
+    EXPECT_EQ(small(21), 42);
+
+    char big[128] = "big";
+    UniqueFunction<std::size_t ()> large([big]() { return std::string(big).size(); });
+    EXPECT_TRUE(!large.IsInline());
+    EXPECT_EQ(large(), 3u);
+
+    // more inline storage
+    UniqueFunction<std::size_t (), 256> roomy([big]() { return std::string(big).size(); });
+    EXPECT_TRUE(roomy.IsInline());
+    EXPECT_EQ(roomy(), 3u);
+}
+
+TEST_CASE(MoveOnly) {
+    std::unique_ptr<int> p(new int(7));
+    UniqueFunction<int ()> f([p = std::move(p)]() { return *p; });
+    EXPECT_EQ(f(), 7);
+
+    UniqueFunction<int ()> g(std::move(f));
+    EXPECT_TRUE(!f);
+    EXPECT_EQ(g(), 7);
+
+    f = std::move(g);
+    EXPECT_TRUE(!g);
+    EXPECT_EQ(f(), 7);
+}
+
+TEST_CASE(Destroy) {
+    // captured object is destroyed exactly once, inline or not
+    auto alive = std::make_shared<int>(0);
+    char big[128] = {};
+    {
+        UniqueFunction<void ()> small([alive]() { });
+        UniqueFunction<void ()> large([alive, big]() { (void)big; });
+        EXPECT_EQ(alive.use_count(), 3);
+
+        UniqueFunction<void ()> moved(std::move(large));
+        EXPECT_EQ(alive.use_count(), 3);
+
+        small = nullptr;
+        EXPECT_EQ(alive.use_count(), 2);
+
+        moved = []() { };
+        EXPECT_EQ(alive.use_count(), 1);
+
+        small = [alive]() { };
+    }
+
+    EXPECT_EQ(alive.use_count(), 1);
+}
+
+TEST_CASE(Swap) {
+    char big[128] = {};
+    UniqueFunction<int ()> a([]() { return 1; });
+    UniqueFunction<int ()> b([big]() { return 2 + big[0]; });
+    a.Swap(b);
+    EXPECT_EQ(a(), 2);
+    EXPECT_EQ(b(), 1);
+    EXPECT_TRUE(!a.IsInline());
+    EXPECT_TRUE(b.IsInline());
+}
+
+TEST_CASE(MutableAndConvert) {
+    UniqueFunction<int ()> counter([n = 0]() mutable { return ++ n; });
+    counter();
+    EXPECT_EQ(counter(), 2);
+
+    // result converted, or dropped for void
+    UniqueFunction<long (int)> widen(Twice);
+    EXPECT_EQ(widen(2), 4L);
+    UniqueFunction<void (int)> drop(Twice);
+    drop(1);
+}
+
+TEST_MAIN()
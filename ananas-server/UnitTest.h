@@ -0,0 +1,80 @@
+#ifndef BERT_UNITTEST_H
+#define BERT_UNITTEST_H
+
+#include <cstdio>
+#include <vector>
+
+// Minimal unit test support, each *Test.cc is a program:
+//
+//   TEST_CASE(Foo) {
+//       EXPECT_EQ(1 + 1, 2);
+//   }
+//
+//   TEST_MAIN()
+
+namespace ananas {
+
+namespace test {
+
+struct TestCase {
+    const char* name;
+    void (*func)();
+};
+
+inline std::vector<TestCase>& AllCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int& Failures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct Registrar {
+    Registrar(const char* name, void (*func)()) {
+        AllCases().push_back(TestCase {name, func});
+    }
+};
+
+inline int RunAll(const char* program) {
+    int failedCases = 0;
+    for (const auto& c : AllCases()) {
+        const int before = Failures();
+        c.func();
+        const bool ok = (Failures() == before);
+        if (!ok)
+            ++ failedCases;
+
+        fprintf(stderr, "[%s] %s.%s\n", ok ? "  OK  " : " FAIL ", program, c.name);
+    }
+
+    return failedCases == 0 ? 0 : 1;
+}
+
+} // end namespace test
+
+} // end namespace ananas
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static ::ananas::test::Registrar name##Registrar_(#name, name); \
+    static void name()
+
+#define EXPECT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            ++ ::ananas::test::Failures(); \
+            fprintf(stderr, "%s:%d: expect %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define EXPECT_EQ(a, b) EXPECT_TRUE((a) == (b))
+
+#define TEST_MAIN() \
+    int main(int , char* argv[]) { \
+        return ::ananas::test::RunAll(argv[0]); \
+    }
+
+#endif
+
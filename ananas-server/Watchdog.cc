@@ -0,0 +1,234 @@
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Watchdog.h"
+#include "EventLoop.h"
+#include "AnanasDebug.h"
+
+namespace ananas {
+
+namespace internal {
+
+const char* Heartbeat::Name(int kind) {
+    switch (kind) {
+    case eIdle:  return "idle";
+    case eRead:  return "read";
+    case eWrite: return "write";
+    case eError: return "error";
+    case eTimer: return "timer";
+    case eTask:  return "task";
+    default:     return "unknown";
+    }
+}
+
+} // end namespace internal
+
+namespace {
+
+// the handler is process wide, shared by all watchdogs
+std::mutex g_signalMutex;
+int g_signalUsers = 0;
+int g_signo = 0;
+struct sigaction g_oldAction;
+
+void DumpBacktrace(int signo, siginfo_t* info, void* ctx) {
+    // sent by Watchdog::_Check
+    if (info->si_code == SI_TKILL && info->si_pid == ::getpid()) {
+        // backtrace_symbols_fd does not malloc
+        void* frames[64];
+        const int n = ::backtrace(frames, 64);
+        ::backtrace_symbols_fd(frames, n, STDERR_FILENO);
+        return;
+    }
+
+    if (g_oldAction.sa_flags & SA_SIGINFO) {
+        g_oldAction.sa_sigaction(signo, info, ctx);
+    } else if (g_oldAction.sa_handler != SIG_DFL &&
+               g_oldAction.sa_handler != SIG_IGN) {
+        g_oldAction.sa_handler(signo);
+    }
+}
+
+std::string Demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0)
+        return name;
+
+    std::string result(demangled);
+    ::free(demangled);
+    return result;
+}
+
+void DefaultStallCallback(const StallInfo& info) {
+    const std::string tag = info.tag ? ", callable " + Demangle(info.tag) : "";
+    if (info.finished)
+        ANANAS_WRN << "EventLoop " << info.loopId
+                   << " stalled " << info.duration.count() << "ms in "
+                   << info.what << " of fd " << info.fd << tag << ", finished";
+    else
+        ANANAS_ERR << "EventLoop " << info.loopId
+                   << " stalled " << info.duration.count() << "ms in "
+                   << info.what << " of fd " << info.fd << tag;
+}
+
+} // end namespace
+
+Watchdog::Watchdog(DurationMs budget) :
+    budget_(std::max(budget, DurationMs(1))),
+    onStall_(DefaultStallCallback) {
+}
+
+Watchdog::~Watchdog() {
+    Stop();
+
+    if (backtrace_) {
+        std::unique_lock<std::mutex> guard(g_signalMutex);
+        if (-- g_signalUsers == 0) {
+            ::sigaction(g_signo, &g_oldAction, NULL);
+            g_signo = 0;
+        }
+    }
+}
+
+void Watchdog::SetStallCallback(StallCallback cb) {
+    assert (!thread_.joinable());
+    onStall_ = std::move(cb);
+}
+
+void Watchdog::EnableBacktrace(bool enable, int signo) {
+    assert (!thread_.joinable());
+    if (!enable || backtrace_)
+        return;
+
+    std::unique_lock<std::mutex> guard(g_signalMutex);
+    if (g_signalUsers > 0 && g_signo != signo) {
+        ANANAS_ERR << "Watchdog backtrace already uses signal " << g_signo;
+        return;
+    }
+
+    backtrace_ = true;
+    signo_ = signo;
+    if (g_signalUsers ++ > 0)
+        return;
+
+    // load libgcc now, backtrace may malloc at the first call
+    void* dummy[1];
+    ::backtrace(dummy, 1);
+
+    struct sigaction sig;
+    ::memset(&sig, 0, sizeof(sig));
+    sig.sa_sigaction = DumpBacktrace;
+    sig.sa_flags = SA_RESTART | SA_SIGINFO;
+    ::sigaction(signo, &sig, &g_oldAction);
+    g_signo = signo;
+}
+
+void Watchdog::Start() {
+    assert (!thread_.joinable());
+
+    stop_ = false;
+    thread_ = std::thread(&Watchdog::_Run, this);
+}
+
+void Watchdog::Stop() {
+    {
+        std::unique_lock<std::mutex> guard(mutex_);
+        stop_ = true;
+    }
+
+    cond_.notify_one();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void Watchdog::Watch(EventLoop* loop) {
+    Entry e;
+    e.loop = loop;
+    e.seq = loop->heartbeat_.seq.load(std::memory_order_acquire);
+    e.since = std::chrono::steady_clock::now();
+    e.reported = false;
+    e.kind = internal::Heartbeat::eIdle;
+    e.fd = -1;
+    e.tag = nullptr;
+
+    std::unique_lock<std::mutex> guard(mutex_);
+    loops_.push_back(e);
+}
+
+void Watchdog::Unwatch(EventLoop* loop) {
+    std::unique_lock<std::mutex> guard(mutex_);
+    loops_.erase(std::remove_if(loops_.begin(), loops_.end(),
+                                [loop](const Entry& e) {
+                                    return e.loop == loop;
+                                }),
+                 loops_.end());
+}
+
+void Watchdog::_Run() {
+    const auto period = std::max<DurationMs>(budget_ / 4, DurationMs(1));
+
+    std::unique_lock<std::mutex> guard(mutex_);
+    while (!stop_) {
+        cond_.wait_for(guard, period, [this]() { return stop_; });
+
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& e : loops_)
+            _Check(e, now);
+    }
+}
+
+void Watchdog::_Check(Entry& e, const TimePoint& now) {
+    const internal::Heartbeat& hb = e.loop->heartbeat_;
+
+    const uint64_t seq = hb.seq.load(std::memory_order_acquire);
+    const int kind = hb.kind.load(std::memory_order_relaxed);
+    const int fd = hb.fd.load(std::memory_order_relaxed);
+    const char* tag = hb.tag.load(std::memory_order_relaxed);
+
+    if (seq != e.seq || kind == internal::Heartbeat::eIdle) {
+        // the stalled one is finished
+        if (e.reported)
+            _Report(e, now, true);
+
+        e.seq = seq;
+        e.since = now;
+        e.reported = false;
+        return;
+    }
+
+    if (e.reported || now - e.since < budget_)
+        return;
+
+    e.reported = true;
+    e.kind = kind;
+    e.fd = fd;
+    e.tag = tag;
+    _Report(e, now, false);
+
+    if (backtrace_)
+        ::pthread_kill(e.loop->thread_, signo_);
+}
+
+void Watchdog::_Report(const Entry& e, const TimePoint& now, bool finished) {
+    StallInfo info;
+    info.loopId = e.loop->Id();
+    info.what = internal::Heartbeat::Name(e.kind);
+    info.fd = e.fd;
+    info.tag = e.tag;
+    info.duration = std::chrono::duration_cast<DurationMs>(now - e.since);
+    info.finished = finished;
+
+    onStall_(info);
+}
+
+} // end namespace ananas
+
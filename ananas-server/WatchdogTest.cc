@@ -0,0 +1,152 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "net/Watchdog.h"
+#include "UnitTest.h"
+
+using namespace ananas;
+
+namespace {
+
+std::atomic<int> g_oldHandlerCalls {0};
+
+void OldHandler(int ) {
+    ++ g_oldHandlerCalls;
+}
+
+struct Stalls {
+    std::mutex mutex;
+    int reported = 0;
+    std::string what;
+    const char* tag = nullptr;
+};
+
+// Run f on a watched loop, return when it's done, and done is set if given
+template <typename F>
+void RunWatched(Watchdog& watchdog, F&& f, const std::atomic<bool>* done = nullptr) {
+    internal::EventLoopGroup group(1);
+    group.SetWatchdog(&watchdog);
+    group.Start();
+    watchdog.Start();
+
+    group.Next()->Execute(std::forward<F>(f)).Wait();
+    while (done && !*done)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    // let watchdog see it finished
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    watchdog.Stop();
+    group.Stop();
+    group.Wait();
+}
+
+void SlowTask() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+} // end namespace
+
+TEST_CASE(TaskTag) {
+    Stalls stalls;
+    Watchdog watchdog(DurationMs(10));
+    watchdog.SetStallCallback([&stalls](const StallInfo& info) {
+        std::unique_lock<std::mutex> guard(stalls.mutex);
+        ++ stalls.reported;
+        stalls.what = info.what;
+        stalls.tag = info.tag;
+    });
+
+    RunWatched(watchdog, []() {
+        SlowTask();
+    });
+
+    EXPECT_EQ(stalls.reported, 2); // detected and finished
+    EXPECT_EQ(stalls.what, std::string("task"));
+    // lambda is named after its enclosing function
+    EXPECT_TRUE(stalls.tag && std::string(stalls.tag).find("TaskTag") != std::string::npos);
+}
+
+TEST_CASE(TimerTag) {
+    Stalls stalls;
+    Watchdog watchdog(DurationMs(10));
+    watchdog.SetStallCallback([&stalls](const StallInfo& info) {
+        std::unique_lock<std::mutex> guard(stalls.mutex);
+        ++ stalls.reported;
+        stalls.what = info.what;
+        stalls.tag = info.tag;
+    });
+
+    std::atomic<bool> done {false};
+    RunWatched(watchdog, [&done]() {
+        EventLoop::Self()->ScheduleAfter(std::chrono::milliseconds(1), [&done]() {
+            SlowTask();
+            done = true;
+        });
+    }, &done);
+
+    EXPECT_EQ(stalls.reported, 2);
+    EXPECT_EQ(stalls.what, std::string("timer"));
+    EXPECT_TRUE(stalls.tag && std::string(stalls.tag).find("TimerTag") != std::string::npos);
+}
+
+// Timers due together, each within budget: not a stall of their sum
+TEST_CASE(ShortTimers) {
+    std::atomic<int> reported {0};
+    Watchdog watchdog(DurationMs(50));
+    watchdog.SetStallCallback([&reported](const StallInfo& ) {
+        ++ reported;
+    });
+
+    const int kTimers = 20;
+    std::atomic<int> fired {0};
+    std::atomic<bool> done {false};
+    RunWatched(watchdog, [&]() {
+        const auto when = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+        for (int i = 0; i < kTimers; ++ i) {
+            EventLoop::Self()->ScheduleAt(when, [&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                if (++ fired == kTimers)
+                    done = true;
+            });
+        }
+    }, &done);
+
+    EXPECT_EQ(fired.load(), kTimers);
+    EXPECT_EQ(reported.load(), 0);
+}
+
+TEST_CASE(ChainSignal) {
+    struct sigaction old;
+    ::memset(&old, 0, sizeof old);
+    old.sa_handler = OldHandler;
+    ::sigaction(SIGUSR2, &old, nullptr);
+
+    {
+        Watchdog watchdog(DurationMs(10));
+        watchdog.SetStallCallback([](const StallInfo& ) { });
+        watchdog.EnableBacktrace(true, SIGUSR2);
+
+        // not from watchdog
+        ::kill(::getpid(), SIGUSR2);
+        EXPECT_EQ(g_oldHandlerCalls.load(), 1);
+
+        // from watchdog, backtrace only
+        RunWatched(watchdog, SlowTask);
+        EXPECT_EQ(g_oldHandlerCalls.load(), 1);
+    }
+
+    // restored
+    struct sigaction now;
+    ::sigaction(SIGUSR2, nullptr, &now);
+    EXPECT_TRUE(now.sa_handler == OldHandler);
+}
+
+TEST_MAIN()
@@ -0,0 +1,150 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "net/Connection.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopGroup.h"
+#include "Bench.h"
+
+// CPU of the sender for 1GB over TCP: SendPacket against SendZeroCopy of
+// the same buffer, next chunk on write complete. The reader is another
+// process, so CPU is of the sender only.
+// Loopback makes kernel copy zero-copy pages for the receiver, so gains
+// show up on a real NIC; here it shows the cost of completion handling.
+
+using namespace ananas;
+
+namespace {
+
+const std::size_t kTotal = 1024 * 1024 * 1024;
+
+void ReadAll(int fd) {
+    std::vector<char> buf(1024 * 1024);
+    for (std::size_t got = 0; got < kTotal; ) {
+        const ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n <= 0)
+            ::_exit(1);
+        got += static_cast<std::size_t>(n);
+    }
+
+    // tell sender, then wait for it to close
+    if (::write(fd, "x", 1) != 1)
+        ::_exit(1);
+    while (::read(fd, buf.data(), buf.size()) > 0)
+        ;
+
+    ::_exit(0);
+}
+
+struct Sender {
+    std::vector<char> payload;
+    bool zeroCopy = false;
+    std::size_t sent = 0;
+    std::size_t sends = 0;
+    std::atomic<std::size_t> released {0};
+    std::atomic<bool> received {false}; // by reader
+
+    void Next(Connection* conn) {
+        if (sent >= kTotal)
+            return;
+
+        sent += payload.size();
+        ++ sends;
+        if (zeroCopy) {
+            conn->SendZeroCopy(payload.data(), payload.size(), [this](ZeroCopyStatus ) {
+                ++ released;
+            });
+        } else {
+            conn->SendPacket(payload.data(), payload.size());
+            ++ released;
+        }
+    }
+};
+
+void Run(const char* name, std::size_t chunk, bool zeroCopy) {
+    int fds[2];
+    bench::TcpPair(fds); // sender, reader
+
+    fflush(stdout);
+    const pid_t reader = ::fork();
+    if (reader == 0) {
+        ::close(fds[0]);
+        ReadAll(fds[1]);
+    }
+    ::close(fds[1]);
+
+    internal::EventLoopGroup group(1);
+    group.Start();
+    EventLoop* loop = group.Next();
+
+    auto conn = std::make_shared<Connection>(loop);
+    conn->Init(fds[0], SocketAddr());
+    auto sender = std::make_shared<Sender>();
+    sender->payload.assign(chunk, 'z');
+    sender->zeroCopy = zeroCopy;
+
+    const double cpu = bench::CpuSeconds();
+    bench::Stopwatch watch;
+    const bool ok = loop->Execute([=]() {
+        loop->Register(internal::eET_Read, conn);
+        if (sender->zeroCopy && !conn->EnableZeroCopy(chunk))
+            return false;
+
+        conn->SetOnWriteComplete([sender](Connection* c) {
+            sender->Next(c);
+        });
+        conn->SetOnMessage([sender](Connection* , const char* , PacketLen_t len) {
+            sender->received = true;
+            return len;
+        });
+        sender->Next(conn.get());
+        return true;
+    }).Wait();
+
+    if (ok) {
+        // released after the reader got all, last ones may lag
+        while (loop->Execute([sender]() {
+                   return !sender->received || sender->released < sender->sends;
+               }).Wait())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        printf("%-14s %8zuK %10.0f %10.2f\n", name, chunk / 1024,
+               kTotal / (1024.0 * 1024) / watch.Seconds(), bench::CpuSeconds() - cpu);
+    } else {
+        printf("%-14s %8zuK %21s\n", name, chunk / 1024, "not supported");
+        ::kill(reader, SIGKILL);
+    }
+
+    // closes the socket
+    loop->Execute([loop, conn]() {
+        loop->Unregister(internal::eET_Read, conn);
+    }).Wait();
+    conn.reset();
+
+    int status = 0;
+    ::waitpid(reader, &status, 0);
+
+    group.Stop();
+    group.Wait();
+}
+
+} // end namespace
+
+int main() {
+    printf("1GB over TCP loopback, CPU of sender\n");
+    printf("%-14s %9s %10s %10s\n", "sender", "chunk", "MB/s", "cpu s");
+
+    for (std::size_t chunk : {std::size_t(1024 * 1024), std::size_t(16 * 1024 * 1024),
+                              std::size_t(64 * 1024 * 1024)}) {
+        Run("SendPacket", chunk, false);
+        Run("SendZeroCopy", chunk, true);
+    }
+
+    return 0;
+}
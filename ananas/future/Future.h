@@ -10,6 +10,7 @@
 #include "Helper.h"
 #include "Try.h"
 #include "ananas/util/Scheduler.h"
+#include "ananas/util/UniqueFunction.h"
 
 namespace ananas {
 
@@ -22,7 +23,7 @@ enum class Progress {
     Retrieved,
 };
 
-using TimeoutCallback = std::function<void ()>;
+using TimeoutCallback = UniqueFunction<void ()>;
 
 template <typename T>
 struct State {
@@ -40,10 +41,10 @@ struct State {
 
     using ValueType = typename TryWrapper<T>::Type;
     ValueType value_;
-    std::function<void (ValueType&& )> then_;
+    UniqueFunction<void (ValueType&& )> then_;
     Progress progress_;
 
-    std::function<void (TimeoutCallback&& )> onTimeout_;
+    UniqueFunction<void (TimeoutCallback&& )> onTimeout_;
     std::atomic<bool> retrieved_;
 
     bool IsRoot() const {
@@ -66,10 +67,8 @@ public:
         state_(std::make_shared<State<T>>()) {
     }
 
-    // The lambda with movable capture can not be stored in
-    // std::function, just for compile, do NOT copy promise!
-    Promise(const Promise& ) = default;
-    Promise& operator= (const Promise& ) = default;
+    Promise(const Promise& ) = delete;
+    Promise& operator= (const Promise& ) = delete;
 
     Promise(Promise&& pm) = default;
     Promise& operator= (Promise&& pm) = default;
@@ -601,11 +600,11 @@ public:
     }
 
 private:
-    void _SetCallback(std::function<void (typename TryWrapper<T>::Type&& )>&& func) {
+    void _SetCallback(UniqueFunction<void (typename TryWrapper<T>::Type&& )>&& func) {
         state_->then_ = std::move(func);
     }
 
-    void _SetOnTimeout(std::function<void (TimeoutCallback&& )>&& func) {
+    void _SetOnTimeout(UniqueFunction<void (TimeoutCallback&& )>&& func) {
         state_->onTimeout_ = std::move(func);
     }
 
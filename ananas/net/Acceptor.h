@@ -18,15 +18,22 @@ public:
     void operator= (const Acceptor& ) = delete;
 
     void SetNewConnCallback(NewTcpConnCallback cb);
+    void SetLoadBalance(LoadBalance lb);
     bool Bind(const SocketAddr& addr);
 
     int Identifier() const override;
+    LoopStats::ChannelKind Kind() const override {
+        return LoopStats::eCK_Acceptor;
+    }
     bool HandleReadEvent() override;
     bool HandleWriteEvent() override;
     void HandleErrorEvent() override;
+    bool HandleCompletion(const Completion& c) override;
 
 private:
     int _Accept();
+    // hand connfd over to a loop, peer_ is its address
+    void _NewConnection(int connfd);
 
     SocketAddr peer_;
     int localSock_;
@@ -37,6 +44,8 @@ private:
     //register msg callback and on connect callback for conn
     NewTcpConnCallback newConnCallback_;
 
+    LoadBalance loadBalance_ = LoadBalance::eRoundRobin;
+
     static const int kListenQueue;
 };
 
@@ -0,0 +1,46 @@
+#ifndef BERT_AFFINITY_H
+#define BERT_AFFINITY_H
+
+#include <string>
+#include <vector>
+
+namespace ananas {
+
+// Placement of event loop threads, see EventLoopGroup::SetAffinity.
+// Only linux is supported, ignored on other platforms.
+//
+// Loops are pinned before EventLoop is constructed in its thread, so the
+// loop's channel table, buffers... are first touched, that is, allocated
+// on the local NUMA node.
+struct AffinityPolicy {
+    enum Mode {
+        eNone,       // no placement
+        eCpuList,    // loop i is pinned to cpus[i % cpus.size()]
+        eOnePerCore, // loop i is pinned to the first thread of core i, skip SMT siblings
+        eNumaNode,   // loop is pinned to cpus of a node, memory prefers the node
+    };
+
+    Mode mode = eNone;
+    std::vector<int> cpus;
+    int node = -1; // for eNumaNode, -1 spread loops over nodes round robin
+
+    static AffinityPolicy CpuList(std::vector<int> cpus);
+    static AffinityPolicy OnePerCore();
+    static AffinityPolicy NumaNode(int node = -1);
+};
+
+namespace internal {
+
+// "0-3,8,10-11" of sysfs cpulist, malformed ranges are skipped
+std::vector<int> ParseCpuList(const std::string& list);
+
+// Pin current thread as the index-th loop.
+// Return the placement description for report.
+std::string ApplyAffinity(const AffinityPolicy& policy, std::size_t index);
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif
+
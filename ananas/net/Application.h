@@ -9,6 +9,8 @@
 #include "EventLoop.h"
 #include "Typedefs.h"
 #include "Poller.h"
+#include "Watchdog.h"
+#include "Affinity.h"
 #include "ananas/util/Timer.h"
 
 namespace ananas {
@@ -42,6 +44,15 @@ public:
     void Listen(const char* ip, uint16_t hostPort,
                 NewTcpConnCallback cb,
                 BindCallback bfcb = &Application::_DefaultBindCallback);
+    // lb: how new connections are distributed over workers
+    void Listen(const SocketAddr& listenAddr,
+                NewTcpConnCallback cb,
+                LoadBalance lb,
+                BindCallback bfcb = &Application::_DefaultBindCallback);
+    void Listen(const char* ip, uint16_t hostPort,
+                NewTcpConnCallback cb,
+                LoadBalance lb,
+                BindCallback bfcb = &Application::_DefaultBindCallback);
 
     void ListenUDP(const SocketAddr& listenAddr,
                    UDPMessageCallback mcb,
@@ -72,8 +83,22 @@ public:
                  EventLoop* loop = nullptr);
 
     EventLoop* Next();
-    void SetNumOfWorker(size_t n);
+    EventLoop* Next(LoadBalance lb, const SocketAddr& peer);
+    // policy: placement of worker threads, see AffinityPolicy
+    void SetNumOfWorker(size_t n, const AffinityPolicy& policy = AffinityPolicy());
     size_t NumOfWorker() const;
+    // Poller of worker loops, base loop always uses the default one
+    void SetPollerType(PollerType type);
+    // Work limits of every loop iteration, see LoopBudget.
+    // Must be called before Run.
+    void SetBudget(const LoopBudget& budget);
+    // Timer storage of all loops, see TimerBackend.
+    // Must be called before Run.
+    void SetTimerBackend(TimerBackend backend);
+    // Report handlers, timers and tasks blocking a loop longer than budget.
+    // Backtrace is dumped by signo, see Watchdog::EnableBacktrace.
+    // Must be called before Run.
+    void EnableWatchdog(DurationMs budget, bool backtrace = false, int signo = SIGURG);
 
 private:
     Application();
@@ -86,6 +111,8 @@ private:
 
     std::unique_ptr<internal::EventLoopGroup> workerGroup_;
 
+    std::unique_ptr<Watchdog> watchdog_;
+
     enum class State {
         eS_None,
         eS_Started,
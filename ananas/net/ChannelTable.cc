@@ -0,0 +1,86 @@
+
+#include <algorithm>
+
+#include "ChannelTable.h"
+
+namespace ananas {
+
+namespace internal {
+
+ChannelTable::ChannelTable() :
+    size_(0) {
+}
+
+bool ChannelTable::Insert(std::shared_ptr<Channel> channel) {
+    const int fd = channel->Identifier();
+    if (fd < 0)
+        return false;
+
+    const std::size_t idx = static_cast<std::size_t>(fd);
+    if (idx >= slots_.size()) {
+        std::size_t newSize = std::max<std::size_t>(64, 2 * slots_.size());
+        while (newSize <= idx)
+            newSize *= 2;
+
+        slots_.resize(newSize);
+    }
+
+    Slot& slot = slots_[idx];
+    if (slot.channel)
+        return false;
+
+    if (++ slot.generation == 0) // wrap around, 0 means unregistered
+        slot.generation = 1;
+
+    channel->SetUniqueId(slot.generation);
+    slot.channel = std::move(channel);
+    ++ size_;
+
+    return true;
+}
+
+std::shared_ptr<Channel> ChannelTable::Erase(const Channel* channel) {
+    if (!Contains(channel))
+        return nullptr;
+
+    Slot& slot = slots_[static_cast<std::size_t>(channel->Identifier())];
+    -- size_;
+
+    return std::move(slot.channel);
+}
+
+Channel* ChannelTable::Get(uint64_t token) const {
+    const std::size_t idx = static_cast<uint32_t>(token);
+    const unsigned int generation = static_cast<unsigned int>(token >> 32);
+    if (idx >= slots_.size())
+        return nullptr;
+
+    const Slot& slot = slots_[idx];
+    if (slot.generation != generation)
+        return nullptr;
+
+    return slot.channel.get();
+}
+
+bool ChannelTable::Contains(const Channel* channel) const {
+    const int fd = channel->Identifier();
+    if (fd < 0 || static_cast<std::size_t>(fd) >= slots_.size())
+        return false;
+
+    const Slot& slot = slots_[static_cast<std::size_t>(fd)];
+    return slot.channel.get() == channel &&
+           slot.generation == channel->GetUniqueId();
+}
+
+void ChannelTable::Clear() {
+    // generations are kept, in case of late events
+    for (auto& slot : slots_)
+        slot.channel.reset();
+
+    size_ = 0;
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
@@ -0,0 +1,82 @@
+
+#ifndef BERT_CHANNELTABLE_H
+#define BERT_CHANNELTABLE_H
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "Poller.h"
+
+namespace ananas {
+
+namespace internal {
+
+// Channels of one eventloop, indexed by fd.
+//
+// Slots are contiguous and grow on demand, fd is bounded by EventLoop with
+// max open fd.
+// Every slot has a generation, bumped when a channel is put in it. The
+// generation is carried in poller's user data with fd, so an event fired for
+// a closed channel will not be dispatched to a new channel reusing the fd.
+class ChannelTable {
+public:
+    ChannelTable();
+
+    ChannelTable(const ChannelTable& ) = delete;
+    void operator= (const ChannelTable& ) = delete;
+
+    // Return false if fd is invalid or occupied.
+    // On success, channel's unique id is set to its generation.
+    bool Insert(std::shared_ptr<Channel> channel);
+    // Return the owner reference, nullptr if not found
+    std::shared_ptr<Channel> Erase(const Channel* channel);
+
+    // Return nullptr if token is stale
+    Channel* Get(uint64_t token) const;
+
+    bool Contains(const Channel* channel) const;
+
+    // for poller user data
+    static uint64_t Token(const Channel* channel) {
+        return (static_cast<uint64_t>(channel->GetUniqueId()) << 32) |
+               static_cast<uint32_t>(channel->Identifier());
+    }
+
+    std::size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    template <typename F>
+    void ForEach(F&& f) const;
+
+    void Clear();
+
+private:
+    struct Slot {
+        std::shared_ptr<Channel> channel;
+        unsigned int generation = 0;
+    };
+
+    std::vector<Slot> slots_;
+    std::size_t size_;
+};
+
+template <typename F>
+void ChannelTable::ForEach(F&& f) const {
+    for (const auto& slot : slots_) {
+        if (slot.channel)
+            f(slot.channel.get());
+    }
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif
+
@@ -3,12 +3,15 @@
 #define BERT_CONNECTION_H
 
 #include <sys/types.h>
+#include <deque>
 #include <string>
 
 #include "Socket.h"
 #include "Poller.h"
 #include "Typedefs.h"
+#include "ReadSizer.h"
 #include "ananas/util/Buffer.h"
+#include "ananas/util/UniqueFunction.h"
 
 namespace ananas {
 
@@ -23,6 +26,12 @@ enum class ShutdownMode {
     eSM_Write,
 };
 
+// Passed to release of SendZeroCopy
+enum class ZeroCopyStatus {
+    eZC_Released, // kernel has done with data, or never took it
+    eZC_Aborted,  // connection is destroyed first, kernel may still refer to data
+};
+
 class Connection : public internal::Channel {
 public:
     explicit
@@ -52,9 +61,14 @@ public:
     void SetNodelay(bool enable);
 
     int Identifier() const override;
+    LoopStats::ChannelKind Kind() const override {
+        return LoopStats::eCK_Connection;
+    }
     bool HandleReadEvent() override;
     bool HandleWriteEvent() override;
     void HandleErrorEvent() override;
+    bool HandleCompletion(const internal::Completion& c) override;
+    bool HandleIdleTrim() override;
 
     // NOT thread-safe
     bool SendPacket(const void* data, std::size_t len);
@@ -63,6 +77,28 @@ public:
     bool SendPacket(const BufferVector& datum);
     bool SendPacket(const SliceVector& slice);
 
+    // NOT thread-safe
+    // Send len bytes of file from offset by sendfile(2), no copy to user
+    // space. It's queued in order with packets, write complete callback is
+    // called when all are sent. fd is duplicated, caller can close it at once.
+    bool SendFile(int fd, off_t offset, std::size_t len);
+
+    // Enable MSG_ZEROCOPY for SendZeroCopy of at least threshold bytes,
+    // smaller ones are cheaper to copy. Return false if not supported.
+    bool EnableZeroCopy(std::size_t threshold = 256 * 1024);
+
+    // NOT thread-safe
+    // Send without copy to kernel, queued in order with packets. data must
+    // be valid and unchanged until release is called with eZC_Released.
+    // If the connection is destroyed before completions are notified, the
+    // rest are called with eZC_Aborted: the pages stay pinned by kernel,
+    // but unacked bytes may still be sent from them, so keep data unchanged
+    // if those bytes matter.
+    // If zero copy is not enabled or len is below threshold, data is copied
+    // and release is called before return.
+    bool SendZeroCopy(const void* data, std::size_t len,
+                      UniqueFunction<void (ZeroCopyStatus )> release);
+
     // Thread safe
     bool SafeSend(const void* data, std::size_t len);
     bool SafeSend(const std::string& data);
@@ -106,10 +142,36 @@ private:
         eS_Closed,
     };
 
+    // file or zero copy data to send after sendBuf_ is sent up to `after` bytes
+    struct Segment {
+        int fd; // kInvalid for zero copy data
+        off_t offset;
+        const char* data;
+        std::size_t len;
+        uint64_t after;
+        bool zeroCopied; // any byte sent by MSG_ZEROCOPY
+        UniqueFunction<void (ZeroCopyStatus )> release;
+    };
+
     friend class internal::Acceptor;
     friend class internal::Connector;
     void _OnConnect();
+    // Call onMessage_ until it takes no more, return bytes consumed
+    std::size_t _Deliver(const char* data, std::size_t len, std::size_t& nMessages);
     int _Send(const void* data, size_t len);
+    // Write sendBuf_ and segments_ in order.
+    // Return 1 if all sent, 0 if socket is not writable, kError on error.
+    int _FlushSendQueue();
+    bool _HasPendingSend() const {
+        return !sendBuf_.Empty() || !segments_.empty();
+    }
+    void _ClearSendQueue();
+    bool _QueueSegment(Segment&& seg);
+    ssize_t _SendZeroCopyChunk(Segment& seg);
+    void _FinishSegment(Segment& seg);
+    void _ReleaseZeroCopied();
+    // Read completions from socket error queue, return false if none.
+    bool _ReapZeroCopy();
 
     EventLoop* const loop_;
     State state_ = State::eS_None;
@@ -118,8 +180,24 @@ private:
     size_t sendBufHighWater_;
 
     Buffer recvBuf_;
+    internal::ReadSizer readSizer_;
     BufferVector sendBuf_;
 
+    std::deque<Segment> segments_;
+    uint64_t bufSent_ = 0; // bytes of sendBuf_ ever sent
+
+    // zero copy is disabled if 0
+    std::size_t zeroCopyThreshold_ = 0;
+    // kernel numbers MSG_ZEROCOPY sends from 0 on each socket
+    uint32_t zcSeq_ = 0;
+    uint32_t zcCompleted_ = 0; // sends before it are completed
+    // release when completion of send `lastSeq` is notified
+    struct ZeroCopyRelease {
+        uint32_t lastSeq;
+        UniqueFunction<void (ZeroCopyStatus )> release;
+    };
+    std::deque<ZeroCopyRelease> zcReleases_;
+
     // When processing read event, pipeline requests made us handle many
     // requests at one time. If each response is ::send to network directyly,
     // there will be many small packets, lead to poor performance.
@@ -1,4 +1,6 @@
 #include <errno.h>
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
 #include "DatagramSocket.h"
@@ -52,6 +54,9 @@ bool DatagramSocket::Bind(const SocketAddr* addr) {
         return false;
     }
 
+    // recvmsg by io_uring if possible
+    loop_->StartCompletion(internal::CompletionOp::eRecvMsg, this);
+
     if (onCreate_)
         onCreate_(this);
 
@@ -90,6 +95,29 @@ bool DatagramSocket::HandleReadEvent() {
     return  true;
 }
 
+bool DatagramSocket::HandleCompletion(const internal::Completion& c) {
+    if (c.result < 0) {
+        ANANAS_ERR << "UDP fd " << localSock_
+                   << ", HandleCompletion error = " << -c.result;
+        return true;
+    }
+
+    // Cut by poller's buffer shorter than recvfrom would do, the rest is
+    // lost, don't pass a broken datagram.
+    if (c.truncated && static_cast<std::size_t>(c.result) < maxPacketSize_) {
+        ANANAS_ERR << "UDP fd " << localSock_
+                   << ", datagram truncated to " << c.result
+                   << " bytes by poller buffer, dropped";
+        return true;
+    }
+
+    ::memcpy(&srcAddr_, c.peer, std::min<std::size_t>(c.peerLen, sizeof srcAddr_));
+    // longer than maxPacketSize_ is truncated like recvfrom
+    const std::size_t bytes = std::min<std::size_t>(c.result, maxPacketSize_);
+    onMessage_(this, c.data, bytes);
+    return true;
+}
+
 void DatagramSocket::_PutSendBuf(const void* data, size_t size, const SocketAddr* dst) {
     Package pkg;
     pkg.dst = *dst;
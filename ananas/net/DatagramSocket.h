@@ -24,9 +24,13 @@ public:
     bool Bind(const SocketAddr* addr);
 
     int Identifier() const override;
+    LoopStats::ChannelKind Kind() const override {
+        return LoopStats::eCK_Datagram;
+    }
     bool HandleReadEvent() override;
     bool HandleWriteEvent() override;
     void HandleErrorEvent() override;
+    bool HandleCompletion(const internal::Completion& c) override;
 
     bool SendPacket(const void*, size_t, const SocketAddr* = nullptr);
 
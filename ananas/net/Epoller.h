@@ -10,22 +10,41 @@
 namespace ananas {
 namespace internal {
 
+// If edgeTriggered, fd is added with EPOLLIN | EPOLLOUT | EPOLLET once,
+// interest of channel is tracked here, so Modify costs no syscall.
+// Handlers must read/write until EAGAIN.
 class Epoller : public Poller {
 public:
-    Epoller();
+    explicit
+    Epoller(bool edgeTriggered = false);
     ~Epoller();
 
     Epoller(const Epoller& ) = delete;
     void operator= (const Epoller& ) = delete;
 
-    bool Register(int fd, int events, void* userPtr) override;
-    bool Modify(int fd, int events, void* userPtr) override;
+    bool Register(int fd, int events, uint64_t userData) override;
+    bool Modify(int fd, int events, uint64_t userData) override;
     bool Unregister(int fd, int events) override;
 
     int Poll(std::size_t maxEvent, int timeoutMs) override;
 
 private:
+    bool _RegisterET(int fd, int events, uint64_t userData);
+    bool _ModifyET(int fd, int events, uint64_t userData);
+    bool _UnregisterET(int fd);
+    int _PollET(std::size_t maxEvent, int timeoutMs);
+
     std::vector<epoll_event> events_;
+
+    // for edge triggered mode, indexed by fd
+    struct FdState {
+        uint64_t userData = 0;
+        int interest = 0;  // 0 : not registered
+        int synthetic = 0; // events to report without edge
+    };
+    const bool edgeTriggered_;
+    std::vector<FdState> fds_;
+    std::vector<int> synthetics_;
 };
 
 } // end namespace internal
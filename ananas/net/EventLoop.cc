@@ -1,6 +1,6 @@
 
 #include <cassert>
-#include <thread>
+#include <limits>
 
 #include "EventLoop.h"
 #include "EventLoopGroup.h"
@@ -14,6 +14,7 @@
 #include "Kqueue.h"
 #elif defined(__gnu_linux__)
 #include "Epoller.h"
+#include "IoUringPoller.h"
 #else
 #error "Only support osx and linux"
 #endif
@@ -34,23 +35,46 @@ void EventLoop::SetMaxOpenFd(rlim_t maxfdPlus1) {
         s_maxOpenFdPlus1 = maxfdPlus1;
 }
 
-EventLoop::EventLoop(internal::EventLoopGroup* group) :
+EventLoop::EventLoop(internal::EventLoopGroup* group, PollerType type) :
     group_(group) {
     assert (!g_thisLoop && "There must be only one EventLoop per thread");
     g_thisLoop = this;
+    thread_ = pthread_self();
+    internal::BufferPool::SetCurrent(&bufferPool_);
 
     internal::InitDebugLog(logALL);
 
 #if defined(__APPLE__)
     poller_.reset(new internal::Kqueue);
 #elif defined(__gnu_linux__)
-    poller_.reset(new internal::Epoller);
+#if defined(ANANAS_HAS_IO_URING)
+    if (type == PollerType::eIoUring) {
+        std::unique_ptr<internal::IoUringPoller> uring(new internal::IoUringPoller);
+        if (uring->IsValid())
+            poller_ = std::move(uring);
+        else
+            ANANAS_WRN << "io_uring is not available, fallback to epoll";
+    }
+#endif
+    if (!poller_)
+        poller_.reset(new internal::Epoller(type == PollerType::eEdgeTriggered));
 #else
 #error "Only support mac os and linux"
 #endif
 
+#if defined(__gnu_linux__)
+    notifier_ = std::make_shared<internal::EventfdChannel>();
+    timerfd_ = std::make_shared<internal::TimerfdChannel>();
+#else
     notifier_ = std::make_shared<internal::PipeChannel>();
+#endif
     id_ = s_evId ++;
+
+    // stamp every timer, not the whole Update: short ones don't add up
+    // to a stall, and the slow one is named
+    timers_.SetOnFire([this](const char* tag) {
+        heartbeat_.Enter(internal::Heartbeat::eTimer, -1, tag);
+    });
 }
 
 EventLoop::~EventLoop() {
@@ -58,19 +82,22 @@ EventLoop::~EventLoop() {
 
 bool EventLoop::Listen(const char* ip,
                        uint16_t hostPort,
-                       NewTcpConnCallback newConnCallback) {
+                       NewTcpConnCallback newConnCallback,
+                       LoadBalance lb) {
     SocketAddr addr;
     addr.Init(ip, hostPort);
 
-    return Listen(addr, std::move(newConnCallback));
+    return Listen(addr, std::move(newConnCallback), lb);
 }
 
 bool EventLoop::Listen(const SocketAddr& listenAddr,
-                       NewTcpConnCallback newConnCallback) {
+                       NewTcpConnCallback newConnCallback,
+                       LoadBalance lb) {
     using internal::Acceptor;
 
     auto s = std::make_shared<Acceptor>(this);
     s->SetNewConnCallback(std::move(newConnCallback));
+    s->SetLoadBalance(lb);
     if (!s->Bind(listenAddr))
         return false;
 
@@ -141,8 +168,6 @@ bool EventLoop::Connect(const SocketAddr& dst,
 }
 
 
-thread_local unsigned int EventLoop::s_id = 0;
-
 std::atomic<int> EventLoop::s_evId {0};
 
 rlim_t EventLoop::s_maxOpenFdPlus1 = ananas::GetMaxOpenFd();
@@ -169,116 +194,412 @@ bool EventLoop::Register(int events, std::shared_ptr<internal::Channel> src) {
         return false;
     }
 
-    ++ s_id;
-    if (s_id == 0) // wrap around
-        s_id = 1;
+    if (!channels_.Insert(src)) {
+        ANANAS_ERR << "Register failed! fd " << src->Identifier()
+                   << " is already registered";
+        return false;
+    }
 
-    src->SetUniqueId(s_id);
-    ANANAS_INF << "Register " << s_id << " to me " << pthread_self();
+    ANANAS_TRACE_POINT("EventLoop::Register", src->Identifier());
 
-    if (poller_->Register(src->Identifier(), events, src.get()))
-        return channelSet_.insert({src->GetUniqueId(), src}).second;
+    if (poller_->Register(src->Identifier(), events, internal::ChannelTable::Token(src.get()))) {
+        stats_.OnChannel(src->Kind(), 1);
+        return true;
+    }
 
+    channels_.Erase(src.get()).reset();
+    src->SetUniqueId(0);
     return false;
 }
 
 bool EventLoop::Modify(int events, std::shared_ptr<internal::Channel> src) {
-    assert (channelSet_.count(src->GetUniqueId()));
-    return poller_->Modify(src->Identifier(), events, src.get());
+    assert (channels_.Contains(src.get()));
+    return poller_->Modify(src->Identifier(), events, internal::ChannelTable::Token(src.get()));
+}
+
+bool EventLoop::StartCompletion(internal::CompletionOp op, internal::Channel* src) {
+    assert (InThisLoop());
+    if (!channels_.Contains(src))
+        return false;
+
+    return poller_->StartCompletion(src->Identifier(), op, internal::ChannelTable::Token(src));
 }
 
 void EventLoop::Unregister(int events, std::shared_ptr<internal::Channel> src) {
     const int fd = src->Identifier();
-    ANANAS_INF << "Unregister socket id " << fd;
+    ANANAS_TRACE_POINT("EventLoop::Unregister", fd);
     poller_->Unregister(fd, events);
 
-    size_t nTask = channelSet_.erase(src->GetUniqueId());
-    if (nTask != 1) {
+    auto dead = channels_.Erase(src.get());
+    if (!dead) {
         ANANAS_ERR << "Can not find socket id " << fd;
         assert (false);
+        return;
     }
+
+    src->SetUniqueId(0);
+    trimList_.Erase(src.get());
+    stats_.OnChannel(src->Kind(), -1);
+    deadChannels_.emplace_back(std::move(dead));
 }
 
 bool EventLoop::Cancel(TimerId id) {
     return timers_.Cancel(id);
 }
 
-void EventLoop::Run() {
-    const DurationMs kDefaultPollTime(10);
-    const DurationMs kMinPollTime(1);
+bool EventLoop::RescheduleAt(TimerId id, const TimePoint& triggerTime) {
+    return timers_.RescheduleAt(id, triggerTime);
+}
+
+// block until events or notified
+static const DurationMs kInfinitePollTime(-1);
+static const DurationMs kBufferTrimInterval(1000);
 
+void EventLoop::Run() {
     Register(internal::eET_Read, notifier_);
+#if defined(__gnu_linux__)
+    Register(internal::eET_Read, timerfd_);
+#endif
+
+    trimTimer_ = ScheduleAfterWithRepeat<kForever>(kBufferTrimInterval,
+                                                   TimerSlack(kBufferTrimInterval / 2),
+                                                   [this]() {
+        _TrimIdle();
+    });
 
     while (!group_->IsStopped()) {
-        auto timeout = std::min(kDefaultPollTime, timers_.NearestTimer());
-        timeout = std::max(kMinPollTime, timeout);
+        const DurationMs timeout = _PollTimeout();
 
-        _Loop(timeout);
+        const std::chrono::microseconds busyPoll(busyPollUs_.load(std::memory_order_relaxed));
+        if (busyPoll.count() > 0)
+            _BusyLoop(timeout, busyPoll);
+        else
+            _Loop(timeout);
     }
 
-    for (auto& kv : channelSet_) {
-        poller_->Unregister(internal::eET_Read | internal::eET_Write,
-                            kv.second->Identifier());
-    }
+    channels_.ForEach([this](internal::Channel* src) {
+        poller_->Unregister(src->Identifier(),
+                            internal::eET_Read | internal::eET_Write);
+    });
 
-    channelSet_.clear();
+    trimList_.Clear();
+    channels_.Clear();
+    deadChannels_.clear();
+    stats_.ResetChannels();
     poller_.reset();
+
+    Cancel(trimTimer_);
+    clockCached_ = false;
 }
 
 bool EventLoop::_Loop(DurationMs timeout) {
-    ANANAS_DEFER {
-        timers_.Update();
-
-        // do not block
-        if (fctrMutex_.try_lock()) {
-            // Use tmp : if f add callback to functors_
-            decltype(functors_) funcs;
-            funcs.swap(functors_);
-            fctrMutex_.unlock();
-
-            for (const auto& f : funcs)
-                f();
-        }
+    statsOn_ = statsEnabled_.load(std::memory_order_relaxed);
+
+    const int ready = _Poll(timeout);
+
+    // timers and tasks stamp themselves
+    heartbeat_.Leave();
+    const uint64_t coalesced = timers_.Coalesced();
+    const std::size_t nTimers = budget_.timers ? timers_.Update(now_, budget_.timers) : timers_.Update(now_);
+
+    const std::size_t nTasks = _RunTasks();
+    heartbeat_.Leave();
+
+    // Keep capacity, no allocation in steady state
+    deadChannels_.clear();
+
+    if (statsOn_)
+        stats_.OnIteration(internal::LoopStatsCounters::NowNs() - pollEndNs_, nTimers,
+                           static_cast<std::size_t>(timers_.Coalesced() - coalesced));
+
+    return ready > 0 || nTasks > 0;
+}
+
+std::size_t EventLoop::_RunTasks() {
+    auto run = [this](Task* t) {
+        std::unique_ptr<Task> task(t);
+        stats_.OnTaskRun(task->postNs_ == 0 ? -1 :
+                         internal::LoopStatsCounters::NowNs() - task->postNs_,
+                         task->counted_);
+
+        heartbeat_.Enter(internal::Heartbeat::eTask, -1, task->Tag());
+        task->Run();
     };
 
-    if (channelSet_.empty()) {
-        std::this_thread::sleep_for(timeout);
-        return false;
+    // Only run tasks posted before now: if f post another task,
+    // it'll be run in next iteration.
+    std::size_t n = urgentFunctors_.Consume(run);
+    if (budget_.tasks)
+        n += functors_.Consume(run, budget_.tasks);
+    else
+        n += functors_.Consume(run);
+
+    return n;
+}
+
+void EventLoop::ContinueRead(internal::Channel* src) {
+    assert (InThisLoop());
+    carriedReads_.push_back(internal::ChannelTable::Token(src));
+}
+
+std::size_t EventLoop::_HandleCarriedReads() {
+    if (carriedReads_.empty())
+        return 0;
+
+    // handler may call ContinueRead again
+    handlingReads_.swap(carriedReads_);
+    for (uint64_t token : handlingReads_) {
+        auto src = channels_.Get(token);
+        if (!src)
+            continue; // closed
+
+        if (src->ReadIteration() == iteration_)
+            continue; // read by fired event already
+
+        src->SetReadIteration(iteration_);
+        heartbeat_.Enter(internal::Heartbeat::eRead, src->Identifier());
+        if (!src->HandleReadEvent())
+            src->HandleErrorEvent();
+    }
+
+    const std::size_t n = handlingReads_.size();
+    handlingReads_.clear();
+    return n;
+}
+
+bool EventLoop::_HasCarriedWork() const {
+    return !carriedReads_.empty() ||
+           !urgentFunctors_.Empty() ||
+           !functors_.Empty();
+}
+
+void EventLoop::_TrimIdle() {
+    // read in the iteration of last trim counts as not idle
+    const uint64_t since = trimIteration_;
+    trimIteration_ = iteration_;
+
+    trimList_.Filter([since](internal::Channel* c) {
+        return c->ReadIteration() >= since || c->HandleIdleTrim();
+    });
+
+    // released blocks stay in pool till next trim
+    bufferPool_.Trim();
+}
+
+DurationMs EventLoop::_PollTimeout() {
+#if defined(__gnu_linux__)
+    // timerfd wake me up, no need for poll timeout
+    timerfd_->SetDeadline(timers_.NearestTimePoint());
+    return kInfinitePollTime;
+#else
+    const auto nearest = timers_.NearestTimer();
+    if (nearest == DurationMs::max())
+        return kInfinitePollTime;
+    if (nearest <= DurationMs(0))
+        return DurationMs(0);
+
+    // avoid overflow of int
+    return std::min(nearest, DurationMs(std::numeric_limits<int>::max()));
+#endif
+}
+
+int EventLoop::_Poll(DurationMs timeout) {
+    int timeoutMs = static_cast<int>(timeout.count());
+    if (timeoutMs != 0) {
+        // Pair with _Notify: either producer see sleeping_, or I see its task.
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_HasCarriedWork())
+            timeoutMs = 0;
     }
 
-    const int ready = poller_->Poll(static_cast<int>(channelSet_.size()),
-                                    static_cast<int>(timeout.count()));
+    const int64_t pollStartNs = statsOn_ ? internal::LoopStatsCounters::NowNs() : 0;
+    const int ready = poller_->Poll(static_cast<int>(channels_.Size()),
+                                    timeoutMs);
+    sleeping_.store(false, std::memory_order_relaxed);
+    ++ iteration_;
+
+    // cached for handlers, timers and stats of this iteration
+    now_ = std::chrono::steady_clock::now();
+    clockCached_ = true;
+
+    if (statsOn_) {
+        pollEndNs_ = std::chrono::duration_cast<std::chrono::nanoseconds>(now_.time_since_epoch()).count();
+        stats_.OnPoll(pollEndNs_ - pollStartNs, ready);
+    }
     if (ready < 0)
-        return false;
+        return ready;
 
     const auto& fired = poller_->GetFiredEvents();
 
-    // Consider stale event, DO NOT unregister another socket in event handler!
-
-    std::vector<std::shared_ptr<internal::Channel>> sources(ready);
+    // Stale events of closed channel are dropped by generation check.
+    // If a channel is unregistered by handler, it's moved to deadChannels_,
+    // so src is valid in this iteration.
     for (int i = 0; i < ready; ++ i) {
-        auto src = (internal::Channel* )fired[i].userdata;
-        sources[i] = src->shared_from_this();
+        auto src = channels_.Get(fired[i].userdata);
+        if (!src) {
+            ANANAS_DBG << "Skip stale event for fd " << static_cast<uint32_t>(fired[i].userdata);
+            continue;
+        }
+
+        const int fd = src->Identifier();
+        if (fired[i].events & (internal::eET_Completion | internal::eET_Read))
+            src->SetReadIteration(iteration_);
+
+        if (fired[i].events & internal::eET_Completion) {
+            heartbeat_.Enter(internal::Heartbeat::eRead, fd);
+            if (!src->HandleCompletion(fired[i].completion)) {
+                src->HandleErrorEvent();
+            }
+        }
 
         if (fired[i].events & internal::eET_Read) {
+            heartbeat_.Enter(internal::Heartbeat::eRead, fd);
             if (!src->HandleReadEvent()) {
                 src->HandleErrorEvent();
             }
         }
 
         if (fired[i].events & internal::eET_Write) {
+            heartbeat_.Enter(internal::Heartbeat::eWrite, fd);
             if (!src->HandleWriteEvent()) {
                 src->HandleErrorEvent();
             }
         }
 
         if (fired[i].events & internal::eET_Error) {
-            ANANAS_ERR << "eET_Error for " << src->Identifier();
+            // not always an error, eg. MSG_ZEROCOPY completion
+            ANANAS_DBG << "eET_Error for " << fd;
+            heartbeat_.Enter(internal::Heartbeat::eError, fd);
             src->HandleErrorEvent();
         }
     }
 
-    return ready >= 0;
+    return ready + static_cast<int>(_HandleCarriedReads());
+}
+
+void EventLoop::_BusyLoop(DurationMs timeout, std::chrono::microseconds maxWindow) {
+    using namespace std::chrono;
+
+    const auto minWindow = std::max(microseconds(1), maxWindow / 32);
+    if (spinWindow_ > maxWindow || spinWindow_ < minWindow)
+        spinWindow_ = maxWindow; // first time or reconfigured
+
+    const auto start = steady_clock::now();
+    if (start - lastBusy_ < spinWindow_) {
+        // spin: poll without blocking, producers need not notify me
+        const bool busy = _Loop(DurationMs(0));
+        const auto end = steady_clock::now();
+
+        if (busy) {
+            lastBusy_ = end;
+            busyPollStats_.spinHits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            const auto ns = duration_cast<nanoseconds>(end - start).count();
+            busyPollStats_.spinNs.fetch_add(ns, std::memory_order_relaxed);
+        }
+
+        return;
+    }
+
+    // nothing to do in spin window, park
+    const bool busy = _Loop(timeout);
+    const auto end = steady_clock::now();
+
+    busyPollStats_.parks.fetch_add(1, std::memory_order_relaxed);
+    busyPollStats_.parkNs.fetch_add(duration_cast<nanoseconds>(end - start).count(),
+                                    std::memory_order_relaxed);
+
+    if (busy) {
+        lastBusy_ = end;
+
+        // Work came soon after parking, a longer spin would have caught it.
+        if (end - start < maxWindow)
+            spinWindow_ = std::min(maxWindow, spinWindow_ * 2);
+        else
+            spinWindow_ = std::max(minWindow, spinWindow_ / 2);
+    } else {
+        // idle, back off
+        spinWindow_ = std::max(minWindow, spinWindow_ / 2);
+    }
+}
+
+void EventLoop::SetBusyPoll(std::chrono::microseconds window) {
+    busyPollUs_.store(std::max<int64_t>(0, window.count()), std::memory_order_relaxed);
+}
+
+std::size_t EventLoop::NumOfConnections() const {
+    return static_cast<std::size_t>(std::max<int64_t>(0, stats_.Channels(LoopStats::eCK_Connection)));
+}
+
+std::size_t EventLoop::NumOfPendingTasks() const {
+    if (!countPending_.load(std::memory_order_relaxed))
+        countPending_.store(true, std::memory_order_relaxed);
+
+    return static_cast<std::size_t>(stats_.PendingTasks());
+}
+
+void EventLoop::EnableStats(bool enable) {
+    statsEnabled_.store(enable, std::memory_order_relaxed);
+    if (enable)
+        countPending_.store(true, std::memory_order_relaxed);
+}
+
+LoopStats EventLoop::GetStats() const {
+    LoopStats stats;
+    stats_.Snapshot(stats);
+
+    const auto pool = bufferPool_.GetStats();
+    stats.bufferAllocs = pool.allocs;
+    stats.bufferHits = pool.hits;
+    stats.bufferRetainedBytes = pool.retainedBytes;
+    stats.bufferTrimmedBytes = pool.trimmedBytes;
+    return stats;
+}
+
+EventLoop::BusyPollStats EventLoop::GetBusyPollStats() const {
+    BusyPollStats stats;
+    stats.spinNs = busyPollStats_.spinNs.load(std::memory_order_relaxed);
+    stats.parkNs = busyPollStats_.parkNs.load(std::memory_order_relaxed);
+    stats.spinHits = busyPollStats_.spinHits.load(std::memory_order_relaxed);
+    stats.parks = busyPollStats_.parks.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void EventLoop::Wakeup() {
+    notifier_->Notify();
+}
+
+void EventLoop::ExecuteUrgent(UniqueFunction<void ()> f) {
+    if (InThisLoop())
+        f();
+    else
+        _Post(std::move(f), true);
+}
+
+void EventLoop::_Enqueue(Task* task, bool urgent) {
+    if (statsEnabled_.load(std::memory_order_relaxed))
+        task->postNs_ = internal::LoopStatsCounters::NowNs();
+
+    if (countPending_.load(std::memory_order_relaxed)) {
+        task->counted_ = true;
+        stats_.OnTaskPosted();
+    }
+
+    if (urgent)
+        urgentFunctors_.Push(task);
+    else
+        functors_.Push(task);
+    _Notify();
+}
+
+void EventLoop::_Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Only the first producer pays the syscall, and never if loop is busy.
+    if (sleeping_.load(std::memory_order_relaxed) &&
+        sleeping_.exchange(false, std::memory_order_acq_rel))
+        notifier_->Notify();
 }
 
 bool EventLoop::InThisLoop() const {
@@ -286,18 +607,18 @@ bool EventLoop::InThisLoop() const {
 }
 
 void EventLoop::ScheduleLater(std::chrono::milliseconds duration,
-                              std::function<void()> f) {
+                              UniqueFunction<void()> f) {
     if (InThisLoop()) {
         ScheduleAfterWithRepeat<1>(duration, std::move(f));
     } else {
-        Execute([=]() {
+        Post([this, duration, f = std::move(f)]() mutable {
             ScheduleAfterWithRepeat<1>(duration, std::move(f));
         });
     }
 }
 
-void EventLoop::Schedule(std::function<void()> f) {
-    Execute(std::move(f));
+void EventLoop::Schedule(UniqueFunction<void()> f) {
+    Dispatch(std::move(f));
 }
 
 } // end namespace ananas
@@ -2,21 +2,29 @@
 #ifndef BERT_EVENTLOOP_H
 #define BERT_EVENTLOOP_H
 
-#include <map>
 #include <memory>
+#include <typeinfo>
+#include <pthread.h>
 #include <sys/resource.h>
 
 #include "Poller.h"
+#include "ChannelTable.h"
+#include "LoopStats.h"
+#include "Watchdog.h"
+#if defined(__gnu_linux__)
+#include "EventfdChannel.h"
+#include "TimerfdChannel.h"
+#else
 #include "PipeChannel.h"
+#endif
 #include "Typedefs.h"
 #include "ananas/util/Timer.h"
+#include "ananas/util/BufferPool.h"
 #include "ananas/util/Scheduler.h"
+#include "ananas/util/MpscQueue.h"
+#include "ananas/util/Trace.h"
 #include "ananas/future/Future.h"
 
-#include <iostream>
-
-using namespace std;
-
 namespace ananas {
 
 struct SocketAddr;
@@ -31,7 +39,7 @@ class EventLoopGroup;
 class EventLoop : public Scheduler {
 public:
     explicit
-    EventLoop(internal::EventLoopGroup* group);
+    EventLoop(internal::EventLoopGroup* group, PollerType type = PollerType::eDefault);
     ~EventLoop();
 
     EventLoop(const EventLoop& ) = delete;
@@ -40,8 +48,10 @@ public:
     void operator= (EventLoop&& ) = delete;
 
     // listener
-    bool Listen(const SocketAddr& addr, NewTcpConnCallback cb);
-    bool Listen(const char* ip, uint16_t hostPort, NewTcpConnCallback cb);
+    bool Listen(const SocketAddr& addr, NewTcpConnCallback cb,
+                LoadBalance lb = LoadBalance::eRoundRobin);
+    bool Listen(const char* ip, uint16_t hostPort, NewTcpConnCallback cb,
+                LoadBalance lb = LoadBalance::eRoundRobin);
     bool ListenUDP(const SocketAddr& listenAddr,
                    UDPMessageCallback mcb,
                    UDPCreateCallback ccb);
@@ -68,7 +78,19 @@ public:
                  DurationMs timeout = DurationMs::max(),
                  EventLoop* dstLoop = nullptr);
 
+    // clock : NOT thread-safe
+    // Monotonic time cached once per iteration, when poller returns.
+    // Out of Run, it's read from clock directly.
+    TimePoint Now() const {
+        return clockCached_ ? now_ : std::chrono::steady_clock::now();
+    }
+
     // timer : NOT thread-safe
+    // Duration can be any std::chrono::duration, precision is microseconds.
+    // Durations count from the clock read at the call, not the cached Now(),
+    // so a timer never expires early however long this iteration has run.
+    // A TimerSlack can be passed before f, to share wakeups with nearby
+    // timers, eg. ScheduleAfter(timeout, TimerSlack(DurationMs(100)), f);
     // See `Timer::ScheduleAtWithRepeat`
     template <int RepeatCount, typename Duration, typename F, typename... Args>
     TimerId ScheduleAtWithRepeat(const TimePoint& , const Duration& , F&& , Args&&...);
@@ -76,6 +98,10 @@ public:
     template <int RepeatCount, typename Duration, typename F, typename... Args>
     TimerId ScheduleAfterWithRepeat(const Duration& , F&& , Args&&...);
     bool Cancel(TimerId id);
+    // See `Timer::RescheduleAt`, push back idle timer without cancel
+    bool RescheduleAt(TimerId id, const TimePoint& );
+    template <typename Duration>
+    bool RescheduleAfter(TimerId id, const Duration& );
 
     // See `Timer::ScheduleAt`
     template <typename F, typename... Args>
@@ -87,8 +113,8 @@ public:
 
     // thread-safe
     // Internal use for future
-    void ScheduleLater(std::chrono::milliseconds , std::function<void ()> ) override;
-    void Schedule(std::function<void ()> ) override;
+    void ScheduleLater(std::chrono::milliseconds , UniqueFunction<void ()> ) override;
+    void Schedule(UniqueFunction<void ()> ) override;
 
     // thread-safe
     // F return non-void
@@ -100,6 +126,7 @@ public:
     //
     // my_work_func will be executed ASAP, but you SHOULD assure that
     // it will NOT block, otherwise EventLoop will be hang!
+    // Use Watchdog to find out the blocking ones.
     template <typename F, typename... Args,
               typename = typename std::enable_if<!std::is_void<typename std::result_of<F (Args...)>::type>::value, void>::type,
               typename Dummy = void>
@@ -110,16 +137,100 @@ public:
               typename = typename std::enable_if<std::is_void<typename std::result_of<F (Args...)>::type>::value, void>::type>
     auto Execute(F&& , Args&&...) -> Future<void>;
 
+    // thread-safe
+    // Fire-and-forget: f is a callable without arguments, can be move-only.
+    // No promise or future is created, prefer them to Execute if result
+    // is not needed.
+    // Post always queues f, even if called in this loop;
+    // Dispatch runs f at once if called in this loop.
+    template <typename F>
+    void Post(F&& f);
+    template <typename F>
+    void Dispatch(F&& f);
+
+    // thread-safe
+    // For control tasks, such as close or stop: they run before tasks posted
+    // by Execute, and are not limited by LoopBudget.
+    void ExecuteUrgent(UniqueFunction<void ()> f);
+
     void Run();
 
+    // thread-safe, async-signal-safe
+    // Interrupt poller, for example let loop see it's stopped.
+    void Wakeup();
+
+    // thread-safe
+    // Busy poll mode for latency critical loop, disabled by default.
+    // After the last work, loop spins on poller and tasks without blocking
+    // for at most window, then park. The spin window adapts: it shrinks when
+    // loop is idle, and grows when work comes soon after parking.
+    // window: 0 to disable.
+    void SetBusyPoll(std::chrono::microseconds window);
+
+    // NOT thread-safe, call it before Run or in loop
+    void SetBudget(const LoopBudget& budget) {
+        budget_ = budget;
+    }
+    const LoopBudget& GetBudget() const {
+        return budget_;
+    }
+
+    // NOT thread-safe, call it before Run or in loop but not in timer.
+    // Pending timers are kept.
+    void SetTimerBackend(TimerBackend backend) {
+        timers_.SetBackend(backend);
+    }
+
+    // NOT thread-safe, call it before Run or in loop
+    // Max bytes of free buffer memory kept by this loop, 0 to disable pool.
+    // Idle memory is released every second anyway.
+    void SetBufferPoolLimit(std::size_t bytes) {
+        bufferPool_.SetLimit(bytes);
+    }
+
+    // Channel stopped reading because of LoopBudget, call its
+    // HandleReadEvent again in next iteration, even if no event fired.
+    // Only once: not if its read event fires too, eg. level triggered.
+    void ContinueRead(internal::Channel* src);
+
+    // Registered channel keeps memory for reading: call its HandleIdleTrim
+    // when it's not read for a trim period, till it returns false.
+    void TrimWhenIdle(internal::Channel* src) {
+        trimList_.Push(src);
+    }
+
+    struct BusyPollStats {
+        uint64_t spinNs = 0;   // time of spin iterations which did nothing
+        uint64_t parkNs = 0;   // time of iterations which may block
+        uint64_t spinHits = 0; // work found by spinning
+        uint64_t parks = 0;
+    };
+    // thread-safe
+    BusyPollStats GetBusyPollStats() const;
+
+    // thread-safe
+    // Runtime statistics, disabled by default. When disabled, the loop reads
+    // no clock; channel counts are always maintained.
+    void EnableStats(bool enable);
+    LoopStats GetStats() const;
+
     bool Register(int events, std::shared_ptr<internal::Channel> src);
     bool Modify(int events, std::shared_ptr<internal::Channel> src);
     void Unregister(int events, std::shared_ptr<internal::Channel> src);
+    // Let poller read or accept for registered src, see CompletionOp.
+    // Return false if poller doesn't support it.
+    bool StartCompletion(internal::CompletionOp op, internal::Channel* src);
 
     std::size_t Size() const {
-        return channelSet_.size();
+        return channels_.Size();
     }
 
+    // thread-safe, for load balance
+    std::size_t NumOfConnections() const;
+    // Tasks are counted by posting threads only since the first call, or
+    // since stats are enabled, it saves them a shared counter otherwise.
+    std::size_t NumOfPendingTasks() const;
+
     // check if current thread is same as this loop's thread
     bool InThisLoop() const;
 
@@ -132,26 +243,124 @@ public:
     static void SetMaxOpenFd(rlim_t maxfdPlus1);
 
 private:
+    // return true if any event or task is handled
     bool _Loop(DurationMs timeout);
+    int _Poll(DurationMs timeout);
+    DurationMs _PollTimeout();
+    void _BusyLoop(DurationMs timeout, std::chrono::microseconds maxWindow);
+    // wake up loop if it's parked in poller
+    void _Notify();
+    // thread-safe
+    struct Task;
+    template <typename F>
+    void _Post(F&& f, bool urgent = false);
+    void _Enqueue(Task* task, bool urgent);
+    // return the number of tasks run
+    std::size_t _RunTasks();
+    std::size_t _HandleCarriedReads();
+    bool _HasCarriedWork() const;
+    // release buffers of channels not read since last trim, and of pool
+    void _TrimIdle();
+
+    friend class Watchdog;
+
+    // Buffers of this thread draw from it, destructed after all of them
+    internal::BufferPool bufferPool_;
+    TimerId trimTimer_;
+    uint64_t trimIteration_ = 0; // iteration of last trim
+    internal::TrimList trimList_; // see TrimWhenIdle
 
     internal::EventLoopGroup* group_;
     std::unique_ptr<internal::Poller> poller_;
 
+#if defined(__gnu_linux__)
+    std::shared_ptr<internal::EventfdChannel> notifier_;
+    std::shared_ptr<internal::TimerfdChannel> timerfd_;
+#else
     std::shared_ptr<internal::PipeChannel> notifier_;
+#endif
+    // true when loop may block in poller, see _Notify
+    std::atomic<bool> sleeping_ {false};
+
+    // see Now()
+    bool clockCached_ = false;
+    TimePoint now_;
 
     internal::TimerManager timers_;
 
-    // channelSet_ must be destructed before timers_
-    std::map<unsigned int, std::shared_ptr<internal::Channel> > channelSet_;
+    // channels_ must be destructed before timers_
+    internal::ChannelTable channels_;
+
+    // Unregistered channels are kept alive until the end of iteration,
+    // so dispatch need not hold a reference to every fired channel.
+    std::vector<std::shared_ptr<internal::Channel> > deadChannels_;
+
+    // posted by other threads, drained by this loop every iteration
+    struct Task : public internal::MpscNode {
+        virtual ~Task() {
+        }
+
+        virtual void Run() = 0;
+        // for Watchdog, see StallInfo::tag
+        virtual const char* Tag() const = 0;
+
+        int64_t postNs_ = 0; // for stats, 0 if not stamped
+        bool counted_ = false; // by OnTaskPosted, see NumOfPendingTasks
+    };
+
+    // callable is stored in the node, the only allocation of a post
+    template <typename F>
+    struct FuncTask : public Task {
+        template <typename U>
+        explicit
+        FuncTask(U&& f) : func_(std::forward<U>(f)) {
+        }
+
+        void Run() override {
+            func_();
+        }
+
+        const char* Tag() const override {
+            return typeid(F).name();
+        }
 
-    std::mutex fctrMutex_;
-    std::vector<std::function<void ()> > functors_;
+        F func_;
+    };
+
+    internal::MpscQueue<Task> functors_;
+    internal::MpscQueue<Task> urgentFunctors_;
+
+    LoopBudget budget_;
+    // tokens of channels to read in next iteration, see ContinueRead
+    std::vector<uint64_t> carriedReads_;
+    std::vector<uint64_t> handlingReads_;
+    uint64_t iteration_ = 0; // see Channel::ReadIteration
+
+    // busy poll, see SetBusyPoll
+    std::atomic<int64_t> busyPollUs_ {0};
+    std::chrono::microseconds spinWindow_ {0};
+    TimePoint lastBusy_;
+    struct {
+        std::atomic<uint64_t> spinNs {0};
+        std::atomic<uint64_t> parkNs {0};
+        std::atomic<uint64_t> spinHits {0};
+        std::atomic<uint64_t> parks {0};
+    } busyPollStats_;
+
+    // stats, see EnableStats
+    std::atomic<bool> statsEnabled_ {false};
+    bool statsOn_ = false; // statsEnabled_ of current iteration
+    mutable std::atomic<bool> countPending_ {false}; // see NumOfPendingTasks
+    int64_t pollEndNs_ = 0;
+    internal::LoopStatsCounters stats_;
+
+    // for Watchdog
+    internal::Heartbeat heartbeat_;
+    pthread_t thread_;
 
     int id_;
     static std::atomic<int> s_evId;
 
-    static thread_local unsigned int s_id;
-
     // max open fd + 1
     static rlim_t s_maxOpenFdPlus1;
 };
@@ -172,9 +381,16 @@ template <int RepeatCount, typename Duration, typename F, typename... Args>
 TimerId EventLoop::ScheduleAfterWithRepeat(const Duration& period,
                                            F&& f, Args&&... args) {
     assert (InThisLoop());
-    return timers_.ScheduleAfterWithRepeat<RepeatCount>(period,
-                                                        std::forward<F>(f),
-                                                        std::forward<Args>(args)...);
+    return timers_.ScheduleAtWithRepeat<RepeatCount>(std::chrono::steady_clock::now() + period,
+                                                     period,
+                                                     std::forward<F>(f),
+                                                     std::forward<Args>(args)...);
+}
+
+template <typename Duration>
+bool EventLoop::RescheduleAfter(TimerId id, const Duration& duration) {
+    assert (InThisLoop());
+    return timers_.RescheduleAt(id, std::chrono::steady_clock::now() + duration);
 }
 
 template <typename F, typename... Args>
@@ -190,9 +406,28 @@ template <typename Duration, typename F, typename... Args>
 TimerId EventLoop::ScheduleAfter(const Duration& duration,
                                  F&& f, Args&&... args) {
     assert (InThisLoop());
-    return timers_.ScheduleAfter(duration,
-                                 std::forward<F>(f),
-                                 std::forward<Args>(args)...);
+    return timers_.ScheduleAt(std::chrono::steady_clock::now() + duration,
+                              std::forward<F>(f),
+                              std::forward<Args>(args)...);
+}
+
+template <typename F>
+void EventLoop::Post(F&& f) {
+    _Post(std::forward<F>(f));
+}
+
+template <typename F>
+void EventLoop::Dispatch(F&& f) {
+    if (InThisLoop())
+        std::forward<F>(f)();
+    else
+        _Post(std::forward<F>(f));
+}
+
+template <typename F>
+void EventLoop::_Post(F&& f, bool urgent) {
+    using Func = typename std::decay<F>::type;
+    _Enqueue(new FuncTask<Func>(std::forward<F>(f)), urgent);
 }
 
 // If F return something not void, or return Future
@@ -200,18 +435,15 @@ template <typename F, typename... Args, typename, typename >
 
 Future<typename std::result_of<F (Args...)>::type>
 EventLoop::Execute(F&& f, Args&&... args) {
-	cout<<"EventLoop::Execute not void"<<endl;
-
     using resultType = typename std::result_of<F (Args...)>::type;
 
     Promise<resultType> promise;
     auto future = promise.GetFuture();
 
+    ANANAS_TRACE_POINT("EventLoop::Execute", InThisLoop());
     if (InThisLoop()) {
-		cout<<"EventLoop::Execute not void InThisLoop"<<endl;
         promise.SetValue(std::forward<F>(f)(std::forward<Args>(args)...));
     } else {
-		cout<<"EventLoop::Execute not void not InThisLoop"<<endl;
         auto task = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
         auto func = [t = std::move(task), pm = std::move(promise)]() mutable {
             try {
@@ -221,12 +453,7 @@ EventLoop::Execute(F&& f, Args&&... args) {
             }
         };
 
-        {
-            std::unique_lock<std::mutex> guard(fctrMutex_);
-            functors_.emplace_back(std::move(func));
-        }
-
-        notifier_->Notify();
+        _Post(std::move(func));
     }
 
     return future;
@@ -235,25 +462,17 @@ EventLoop::Execute(F&& f, Args&&... args) {
 // F return void
 template <typename F, typename... Args, typename >
 Future<void> EventLoop::Execute(F&& f, Args&&... args) {
-	cout<<"EventLoop::Execute void"<<endl;
-
     using resultType = typename std::result_of<F (Args...)>::type;
-	cout<<"EventLoop::Execute void resultType"<<endl;
     static_assert(std::is_void<resultType>::value, "must be void");
 
     Promise<void> promise;
     auto future = promise.GetFuture();
 
-	cout<<"EventLoop::Execute void future"<<endl;
-
+    ANANAS_TRACE_POINT("EventLoop::Execute", InThisLoop());
     if (InThisLoop()) {
-		cout<<"EventLoop::Execute void InThisLoop"<<endl;
         std::forward<F>(f)(std::forward<Args>(args)...);
-		cout<<"EventLoop::Execute void InThisLoop SetValue before"<<endl;
         promise.SetValue();
-		cout<<"EventLoop::Execute void InThisLoop SetValue after"<<endl;
     } else {
-		cout<<"EventLoop::Execute void  not InThisLoop"<<endl;
         auto task = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
         auto func = [t = std::move(task), pm = std::move(promise)]() mutable {
             try {
@@ -264,12 +483,7 @@ Future<void> EventLoop::Execute(F&& f, Args&&... args) {
             }
         };
 
-        {
-            std::unique_lock<std::mutex> guard(fctrMutex_);
-            functors_.emplace_back(std::move(func));
-        }
-
-        notifier_->Notify();
+        _Post(std::move(func));
     }
 
     return future;
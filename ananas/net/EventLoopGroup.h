@@ -5,10 +5,16 @@
 #include <vector>
 
 #include "ananas/util/ThreadPool.h"
+#include "ananas/util/Timer.h"
+#include "Typedefs.h"
+#include "LoopStats.h"
+#include "Affinity.h"
 
 namespace ananas {
 
 class EventLoop;
+class Watchdog;
+struct SocketAddr;
 
 namespace internal {
 
@@ -27,13 +33,32 @@ public:
     void SetNumOfEventLoop(size_t n);
     size_t Size() const;
 
+    // Must be called before Start
+    void SetPollerType(PollerType type);
+    // Loops are watched until destructed, watchdog must outlive them.
+    void SetWatchdog(Watchdog* watchdog);
+    // Placement of loop threads, reported in log when started.
+    void SetAffinity(const AffinityPolicy& policy);
+    void SetBudget(const LoopBudget& budget);
+    void SetTimerBackend(TimerBackend backend);
+
+    // Set stopped and wake up loops, NOT for signal handler.
     void Stop();
+    // Only set stopped, async-signal-safe; loops see it when they wake up.
+    void MarkStopped();
     bool IsStopped() const;
 
     void Start();
     void Wait();
 
+    // round robin
     EventLoop* Next() const;
+    // peer is only for LoadBalance::eHashByPeer
+    EventLoop* Next(LoadBalance lb, const SocketAddr& peer) const;
+
+    // thread-safe, sum of all loops' stats, see EventLoop::EnableStats
+    void EnableStats(bool enable);
+    LoopStats GetStats() const;
 
 private:
     enum State {
@@ -45,12 +70,18 @@ private:
 
     ThreadPool pool_;
 
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
     std::condition_variable cond_;
     // Use raw-pointer because unique_ptr needs complete type
     std::vector<EventLoop* > loops_;
 
     size_t numLoop_;
+    PollerType pollerType_ {PollerType::eDefault};
+    Watchdog* watchdog_ {nullptr};
+    AffinityPolicy affinity_;
+    LoopBudget budget_;
+    TimerBackend timerBackend_ {TimerBackend::eMap};
+    std::atomic<bool> statsEnabled_ {false};
     mutable std::atomic<size_t> currentLoop_ {0};
 };
 
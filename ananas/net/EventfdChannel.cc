@@ -0,0 +1,55 @@
+
+#ifdef __gnu_linux__
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <cassert>
+
+#include "EventfdChannel.h"
+
+namespace ananas {
+
+namespace internal {
+
+EventfdChannel::EventfdChannel() {
+    eventFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert (eventFd_ >= 0);
+}
+
+EventfdChannel::~EventfdChannel() {
+    ::close(eventFd_);
+}
+
+int EventfdChannel::Identifier() const {
+    return eventFd_;
+}
+
+bool EventfdChannel::HandleReadEvent() {
+    // reset counter, coalesce all notifies
+    uint64_t cnt = 0;
+    auto n = ::read(eventFd_, &cnt, sizeof cnt);
+    return n == sizeof cnt || errno == EAGAIN;
+}
+
+bool EventfdChannel::HandleWriteEvent() {
+    assert (false);
+    return false;
+}
+
+void EventfdChannel::HandleErrorEvent() {
+}
+
+bool EventfdChannel::Notify() {
+    uint64_t one = 1;
+    auto n = ::write(eventFd_, &one, sizeof one);
+    return n == sizeof one;
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif // end #ifdef __gnu_linux__
+
@@ -0,0 +1,41 @@
+
+#ifndef BERT_EVENTFDCHANNEL_H
+#define BERT_EVENTFDCHANNEL_H
+
+#ifdef __gnu_linux__
+
+#include "Poller.h"
+
+namespace ananas {
+
+namespace internal {
+
+// Like PipeChannel, but only one fd and one counter in kernel:
+// any number of Notify are consumed by one read.
+class EventfdChannel : public internal::Channel {
+public:
+    EventfdChannel();
+    ~EventfdChannel();
+
+    EventfdChannel(const EventfdChannel& ) = delete;
+    void operator= (const EventfdChannel& ) = delete;
+
+    int Identifier() const override;
+    bool HandleReadEvent() override;
+    bool HandleWriteEvent() override;
+    void HandleErrorEvent() override;
+
+    bool Notify();
+
+private:
+    int eventFd_;
+};
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif // end #ifdef __gnu_linux__
+
+#endif
+
@@ -0,0 +1,641 @@
+#include "IoUringPoller.h"
+
+#ifdef ANANAS_HAS_IO_URING
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "AnanasDebug.h"
+
+namespace ananas {
+namespace internal {
+
+namespace {
+
+// user_data of SQE whose CQE should be ignored, such as poll remove
+const uint64_t kIgnoredUserData = ~0ULL;
+// cancel all ops when destroyed
+const uint64_t kCancelAllUserData = ~0ULL - 1;
+
+// user_data: fd in low 32 bits, seq in next 31 bits, top bit for ops
+const uint64_t kOpBit = 1ULL << 63;
+const uint32_t kSeqMask = 0x7fffffff;
+
+const uint16_t kBufferGroup = 0;
+
+inline uint64_t MakeUserData(int fd, uint32_t seq, bool op = false) {
+    return (op ? kOpBit : 0) |
+           (static_cast<uint64_t>(seq & kSeqMask) << 32) |
+           static_cast<uint32_t>(fd);
+}
+
+inline unsigned LoadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline void StoreRelease(unsigned* p, unsigned v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+// multishot recv needs linux 6.0, there is no feature flag for it
+bool KernelAtLeast(int major, int minor) {
+    utsname name;
+    if (::uname(&name) != 0)
+        return false;
+
+    int ma = 0, mi = 0;
+    if (::sscanf(name.release, "%d.%d", &ma, &mi) != 2)
+        return false;
+
+    return ma > major || (ma == major && mi >= minor);
+}
+
+inline uint32_t ToPollMask(int events) {
+    uint32_t mask = 0;
+    if (events & eET_Read)
+        mask |= POLLIN;
+    if (events & eET_Write)
+        mask |= POLLOUT;
+
+    return mask;
+}
+
+} // end namespace
+
+IoUringPoller::IoUringPoller(unsigned entries) {
+    if (!_Setup(entries)) {
+        ANANAS_ERR << "io_uring setup failed, errno " << errno;
+        if (multiplexer_ != -1) {
+            ::close(multiplexer_);
+            multiplexer_ = -1;
+        }
+
+        return;
+    }
+
+    ANANAS_DBG << "create io_uring: " << multiplexer_;
+}
+
+IoUringPoller::~IoUringPoller() {
+    if (bufRing_)
+        _CancelAll();
+
+    if (sqes_)
+        ::munmap(sqes_, sqesSize_);
+    if (ring_)
+        ::munmap(ring_, ringSize_);
+
+    if (multiplexer_ != -1) {
+        ANANAS_DBG << "close io_uring: " << multiplexer_;
+        ::close(multiplexer_);
+    }
+
+    if (bufRing_)
+        ::munmap(bufRing_, bufRingSize_);
+}
+
+bool IoUringPoller::_Setup(unsigned entries) {
+    io_uring_params params;
+    ::memset(&params, 0, sizeof params);
+
+    multiplexer_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (multiplexer_ < 0) {
+        multiplexer_ = -1;
+        return false;
+    }
+
+    // EXT_ARG for timeout, NODROP for not losing completions
+    const unsigned required = IORING_FEAT_SINGLE_MMAP |
+                              IORING_FEAT_NODROP |
+                              IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required) {
+        errno = ENOSYS;
+        return false;
+    }
+
+    const std::size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const std::size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringSize_ = std::max(sqSize, cqSize);
+
+    void* ring = ::mmap(nullptr, ringSize_,
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        multiplexer_, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED)
+        return false;
+
+    ring_ = ring;
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_,
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        multiplexer_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+
+    sqes_ = static_cast<io_uring_sqe* >(sqes);
+
+    char* base = static_cast<char* >(ring_);
+    sqHead_ = reinterpret_cast<unsigned* >(base + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned* >(base + params.sq_off.tail);
+    sqArray_ = reinterpret_cast<unsigned* >(base + params.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned* >(base + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+
+    cqHead_ = reinterpret_cast<unsigned* >(base + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned* >(base + params.cq_off.tail);
+    cqes_ = reinterpret_cast<io_uring_cqe* >(base + params.cq_off.cqes);
+    cqMask_ = *reinterpret_cast<unsigned* >(base + params.cq_off.ring_mask);
+
+    return true;
+}
+
+io_uring_sqe* IoUringPoller::_GetSqe() {
+    unsigned tail = *sqTail_;
+    if (tail - LoadAcquire(sqHead_) >= sqEntries_) {
+        // SQ is full, submit now
+        _Enter(0, 0);
+        if (tail - LoadAcquire(sqHead_) >= sqEntries_)
+            return nullptr;
+    }
+
+    const unsigned idx = tail & sqMask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    ::memset(sqe, 0, sizeof *sqe);
+
+    sqArray_[idx] = idx;
+    StoreRelease(sqTail_, tail + 1);
+    ++ pending_;
+
+    return sqe;
+}
+
+bool IoUringPoller::_SetupBuffers() {
+    if (buffersTried_)
+        return bufRing_ != nullptr;
+
+    buffersTried_ = true;
+    if (!KernelAtLeast(6, 0))
+        return false;
+
+    bufRingSize_ = kRecvBuffers * sizeof(io_uring_buf);
+    void* ring = ::mmap(nullptr, bufRingSize_,
+                        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1, 0);
+    if (ring == MAP_FAILED)
+        return false;
+
+    io_uring_buf_reg reg;
+    ::memset(&reg, 0, sizeof reg);
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = kRecvBuffers;
+    reg.bgid = kBufferGroup;
+    if (::syscall(__NR_io_uring_register, multiplexer_,
+                  IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        ANANAS_WRN << "io_uring provided buffers not supported, errno " << errno;
+        ::munmap(ring, bufRingSize_);
+        return false;
+    }
+
+    bufRing_ = static_cast<io_uring_buf* >(ring);
+    buffers_.reset(new char[kRecvBuffers * kRecvBufferSize]);
+    for (unsigned bid = 0; bid < kRecvBuffers; ++ bid)
+        _RecycleBuffer(static_cast<uint16_t>(bid));
+
+    return true;
+}
+
+void IoUringPoller::_RecycleBuffer(uint16_t bid) {
+    io_uring_buf& buf = bufRing_[bufTail_ & (kRecvBuffers - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffers_.get() + bid * kRecvBufferSize);
+    buf.len = kRecvBufferSize;
+    buf.bid = bid;
+
+    // tail of ring overlays resv of the first buf
+    ++ bufTail_;
+    __atomic_store_n(&bufRing_[0].resv, bufTail_, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::_Arm(int fd) {
+    FdState& state = fds_[fd];
+    state.seq = (state.seq + 1) & kSeqMask;
+
+    io_uring_sqe* sqe = _GetSqe();
+    if (!sqe) {
+        ANANAS_ERR << "io_uring SQ full, can not poll fd " << fd;
+        return;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    // reads are done by op, but keep polling for errors like epoll does
+    int events = state.events;
+    if (state.op != CompletionOp::eNone)
+        events &= ~eET_Read;
+
+    sqe->poll32_events = ToPollMask(events);
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = MakeUserData(fd, state.seq);
+}
+
+void IoUringPoller::_Disarm(int fd) {
+    const FdState& state = fds_[fd];
+
+    io_uring_sqe* sqe = _GetSqe();
+    if (!sqe) {
+        ANANAS_ERR << "io_uring SQ full, can not remove poll of fd " << fd;
+        return;
+    }
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = MakeUserData(fd, state.seq);
+    sqe->user_data = kIgnoredUserData;
+}
+
+void IoUringPoller::_ArmOp(int fd) {
+    FdState& state = fds_[fd];
+    state.opSeq = (state.opSeq + 1) & kSeqMask;
+
+    io_uring_sqe* sqe = _GetSqe();
+    if (!sqe) {
+        // try again in next Poll
+        starved_.push_back(fd);
+        return;
+    }
+
+    sqe->fd = fd;
+    sqe->user_data = MakeUserData(fd, state.opSeq, true);
+    switch (state.op) {
+    case CompletionOp::eRecv:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        break;
+
+    case CompletionOp::eRecvMsg:
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = reinterpret_cast<uint64_t>(state.msg.get());
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        break;
+
+    case CompletionOp::eAccept:
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        break;
+
+    case CompletionOp::eNone:
+        assert (false);
+        break;
+    }
+
+    state.opArmed = true;
+}
+
+void IoUringPoller::_CancelOp(int fd) {
+    FdState& state = fds_[fd];
+    state.opArmed = false;
+
+    io_uring_sqe* sqe = _GetSqe();
+    if (!sqe) {
+        ANANAS_ERR << "io_uring SQ full, can not cancel op of fd " << fd;
+        return;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = MakeUserData(fd, state.opSeq, true);
+    sqe->user_data = kIgnoredUserData;
+}
+
+void IoUringPoller::_CancelAll() {
+    // ops may still write to buffers, wait until they are cancelled
+    io_uring_sqe* sqe = _GetSqe();
+    if (!sqe)
+        return;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = kCancelAllUserData;
+
+    for (int i = 0; i < 10; ++ i) {
+        if (!_Enter(1, 100))
+            return;
+
+        bool done = false;
+        unsigned head = *cqHead_;
+        const unsigned tail = LoadAcquire(cqTail_);
+        for (; head != tail; ++ head) {
+            if (cqes_[head & cqMask_].user_data == kCancelAllUserData)
+                done = true;
+        }
+
+        StoreRelease(cqHead_, head);
+        if (done)
+            return;
+    }
+}
+
+bool IoUringPoller::Register(int fd, int events, uint64_t userData) {
+    if (fd < 0 || !IsValid())
+        return false;
+
+    if (static_cast<std::size_t>(fd) >= fds_.size())
+        fds_.resize(std::max<std::size_t>(2 * fds_.size(), fd + 1));
+
+    FdState& state = fds_[fd];
+    if (state.events != 0)
+        return Modify(fd, events, userData);
+
+    state.userData = userData;
+    state.events = events;
+    _Arm(fd);
+
+    return true;
+}
+
+bool IoUringPoller::Modify(int fd, int events, uint64_t userData) {
+    if (events == 0)
+        return Unregister(fd, 0);
+
+    if (fd < 0 ||
+        static_cast<std::size_t>(fd) >= fds_.size() ||
+        fds_[fd].events == 0)
+        return Register(fd, events, userData);
+
+    FdState& state = fds_[fd];
+    if (state.events == events && state.userData == userData)
+        return true;
+
+    // Re-arm instead of IORING_POLL_UPDATE, so that current
+    // readiness of fd is checked again.
+    _Disarm(fd);
+    state.userData = userData;
+    state.events = events;
+    _Arm(fd);
+
+    return true;
+}
+
+bool IoUringPoller::Unregister(int fd, int ) {
+    if (fd < 0 ||
+        static_cast<std::size_t>(fd) >= fds_.size() ||
+        fds_[fd].events == 0)
+        return false;
+
+    // Pay attention: io_uring holds a reference of file until poll is removed,
+    // that is, submitted in next Poll.
+    FdState& state = fds_[fd];
+    _Disarm(fd);
+    if (state.opArmed)
+        _CancelOp(fd);
+
+    state.op = CompletionOp::eNone;
+    state.events = 0;
+
+    return true;
+}
+
+bool IoUringPoller::StartCompletion(int fd, CompletionOp op, uint64_t userData) {
+    if (fd < 0 ||
+        op == CompletionOp::eNone ||
+        static_cast<std::size_t>(fd) >= fds_.size() ||
+        fds_[fd].events == 0)
+        return false;
+
+    FdState& state = fds_[fd];
+    if (state.op != CompletionOp::eNone)
+        return state.op == op;
+
+    // also checks kernel for ops, accept needs no buffer though
+    if (!_SetupBuffers())
+        return false;
+
+    if (op == CompletionOp::eRecvMsg) {
+        if (!state.msg)
+            state.msg.reset(new msghdr);
+
+        ::memset(state.msg.get(), 0, sizeof(msghdr));
+        state.msg->msg_namelen = sizeof(sockaddr_in6);
+    }
+
+    state.userData = userData;
+    state.op = op;
+
+    // poll without read
+    _Disarm(fd);
+    _Arm(fd);
+    _ArmOp(fd);
+
+    return true;
+}
+
+bool IoUringPoller::_Enter(unsigned minComplete, int timeoutMs) {
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    __kernel_timespec ts;
+    void* pArg = nullptr;
+    std::size_t argSize = 0;
+
+    if (minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+
+        if (timeoutMs > 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = timeoutMs % 1000 * 1000000LL;
+
+            ::memset(&arg, 0, sizeof arg);
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+            flags |= IORING_ENTER_EXT_ARG;
+            pArg = &arg;
+            argSize = sizeof arg;
+        }
+    }
+
+    int ret = static_cast<int>(::syscall(__NR_io_uring_enter, multiplexer_,
+                                         pending_, minComplete, flags,
+                                         pArg, argSize));
+    if (ret < 0)
+        return errno == EINTR || errno == ETIME || errno == EAGAIN || errno == EBUSY;
+
+    assert (static_cast<unsigned>(ret) <= pending_);
+    pending_ -= static_cast<unsigned>(ret);
+    return true;
+}
+
+int IoUringPoller::Poll(std::size_t , int timeoutMs) {
+    if (!IsValid())
+        return -1;
+
+    // handlers of last Poll are done with them
+    for (uint16_t bid : usedBuffers_)
+        _RecycleBuffer(bid);
+    usedBuffers_.clear();
+
+    if (!starved_.empty()) {
+        const std::size_t n = starved_.size();
+        for (std::size_t i = 0; i < n; ++ i) {
+            const int fd = starved_[i];
+            const FdState& state = fds_[fd];
+            if (state.events != 0 && state.op != CompletionOp::eNone && !state.opArmed)
+                _ArmOp(fd);
+        }
+
+        starved_.erase(starved_.begin(), starved_.begin() + n);
+    }
+
+    const bool hasCompletion = LoadAcquire(cqTail_) != *cqHead_;
+    const unsigned minComplete = (hasCompletion || timeoutMs == 0) ? 0 : 1;
+
+    // Busy loop with completions ready: no syscall at all
+    if (pending_ > 0 || minComplete > 0) {
+        if (!_Enter(minComplete, timeoutMs))
+            return -1;
+    }
+
+    return _Reap();
+}
+
+int IoUringPoller::_Reap() {
+    unsigned head = *cqHead_;
+    const unsigned tail = LoadAcquire(cqTail_);
+
+    if (firedEvents_.size() < tail - head)
+        firedEvents_.resize(tail - head);
+
+    int nFired = 0;
+    for (; head != tail; ++ head) {
+        const io_uring_cqe& cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == kIgnoredUserData ||
+            cqe.user_data == kCancelAllUserData)
+            continue;
+
+        const int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+        const uint32_t seq = static_cast<uint32_t>(cqe.user_data >> 32) & kSeqMask;
+        if (cqe.user_data & kOpBit) {
+            if (_ReapOp(cqe, fd, seq, firedEvents_[nFired]))
+                ++ nFired;
+
+            continue;
+        }
+
+        if (static_cast<std::size_t>(fd) >= fds_.size())
+            continue;
+
+        FdState& state = fds_[fd];
+        if (state.events == 0 || state.seq != seq)
+            continue; // stale, removed or re-armed
+
+        FiredEvent& fired = firedEvents_[nFired ++];
+        fired.events = 0;
+        fired.userdata = state.userData;
+
+        if (cqe.res < 0) {
+            fired.events |= eET_Error;
+        } else {
+            if (cqe.res & (POLLIN | POLLPRI))
+                fired.events |= eET_Read;
+
+            if (cqe.res & POLLOUT)
+                fired.events |= eET_Write;
+
+            if (cqe.res & (POLLERR | POLLHUP))
+                fired.events |= eET_Error;
+        }
+
+        // multishot poll terminated by kernel, eg. CQ overflow
+        if (!(cqe.flags & IORING_CQE_F_MORE) && cqe.res >= 0)
+            _Arm(fd);
+    }
+
+    StoreRelease(cqHead_, head);
+    return nFired;
+}
+
+bool IoUringPoller::_ReapOp(const io_uring_cqe& cqe, int fd, uint32_t seq, FiredEvent& fired) {
+    const bool hasBuffer = cqe.flags & IORING_CQE_F_BUFFER;
+    const uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+    if (static_cast<std::size_t>(fd) >= fds_.size() ||
+        fds_[fd].op == CompletionOp::eNone ||
+        fds_[fd].opSeq != seq) {
+        // stale, give buffer back at once
+        if (hasBuffer)
+            _RecycleBuffer(bid);
+
+        return false;
+    }
+
+    FdState& state = fds_[fd];
+    const bool more = cqe.flags & IORING_CQE_F_MORE;
+    if (!more)
+        state.opArmed = false;
+
+    if (cqe.res == -ENOBUFS) {
+        // handlers hold all buffers, arm again when they're recycled
+        if (!more)
+            starved_.push_back(fd);
+
+        return false;
+    }
+
+    // Multishot op is terminated by kernel, eg. CQ overflow or error.
+    // Recv stops at EOF or error, the others go on like epoll does.
+    if (!more) {
+        const bool rearm = state.op == CompletionOp::eRecv ? cqe.res > 0 : cqe.res != -ECANCELED;
+        if (rearm)
+            _ArmOp(fd);
+    }
+
+    fired.events = eET_Completion;
+    fired.userdata = state.userData;
+    fired.completion = Completion();
+    fired.completion.result = cqe.res;
+
+    if (hasBuffer) {
+        char* buf = buffers_.get() + bid * kRecvBufferSize;
+        usedBuffers_.push_back(bid);
+
+        if (state.op == CompletionOp::eRecvMsg) {
+            // io_uring_recvmsg_out, name, control, payload
+            const auto* out = reinterpret_cast<const io_uring_recvmsg_out* >(buf);
+            const std::size_t header = sizeof *out + state.msg->msg_namelen + state.msg->msg_controllen;
+            if (cqe.res < 0 || static_cast<std::size_t>(cqe.res) < header) {
+                fired.completion.result = -EINVAL;
+                return true;
+            }
+
+            fired.completion.peer = buf + sizeof *out;
+            fired.completion.peerLen = std::min(out->namelen, state.msg->msg_namelen);
+            fired.completion.data = buf + header;
+            fired.completion.result = static_cast<int>(std::min<std::size_t>(out->payloadlen,
+                                                                             cqe.res - header));
+            fired.completion.truncated = out->flags & MSG_TRUNC;
+        } else {
+            fired.completion.data = buf;
+        }
+    }
+
+    return true;
+}
+
+} // end namespace internal
+} // end namespace ananas
+
+#endif // end #ifdef ANANAS_HAS_IO_URING
+
@@ -0,0 +1,123 @@
+#ifndef BERT_IOURINGPOLLER_H
+#define BERT_IOURINGPOLLER_H
+
+#if defined(__gnu_linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ANANAS_HAS_IO_URING 1
+#endif
+#endif
+
+#ifdef ANANAS_HAS_IO_URING
+
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include "Poller.h"
+
+namespace ananas {
+namespace internal {
+
+// Poller based on io_uring multishot poll, needs linux 5.13 or newer.
+//
+// Register/Modify/Unregister only queue SQEs, they're submitted together
+// with waiting for completions in Poll, so there is at most one syscall
+// per loop iteration, and none if completions are already there.
+//
+// Multishot poll is triggered by wakeups of fd, like EPOLLET, handlers must
+// read/write until EAGAIN, which is what ananas channels do.
+//
+// With StartCompletion, reads are done by kernel instead: multishot recv
+// and recvmsg into a ring of provided buffers, and multishot accept (linux
+// 6.0 or newer). One SQE serves all reads of a socket, no syscall per read
+// and no EAGAIN read. Buffers of completions are given back to kernel in
+// next Poll, after handlers have consumed them.
+class IoUringPoller : public Poller {
+public:
+    explicit
+    IoUringPoller(unsigned entries = 1024);
+    ~IoUringPoller();
+
+    IoUringPoller(const IoUringPoller& ) = delete;
+    void operator= (const IoUringPoller& ) = delete;
+
+    // false if kernel doesn't support io_uring, or it's forbidden
+    bool IsValid() const {
+        return multiplexer_ != -1;
+    }
+
+    bool Register(int fd, int events, uint64_t userData) override;
+    bool Modify(int fd, int events, uint64_t userData) override;
+    bool Unregister(int fd, int events) override;
+
+    bool StartCompletion(int fd, CompletionOp op, uint64_t userData) override;
+
+    int Poll(std::size_t maxEvent, int timeoutMs) override;
+
+    static constexpr unsigned kRecvBuffers = 256; // power of 2
+    // Datagram larger than it less recvmsg header is truncated, see
+    // Completion::truncated
+    static constexpr unsigned kRecvBufferSize = 16 * 1024;
+
+private:
+    struct FdState {
+        uint64_t userData = 0;
+        uint32_t seq = 0; // bumped when armed, CQEs of old arm are stale
+        int events = 0;   // 0 : not registered
+
+        CompletionOp op = CompletionOp::eNone;
+        uint32_t opSeq = 0;
+        bool opArmed = false;
+        std::unique_ptr<msghdr> msg; // of eRecvMsg, read by kernel when submitted
+    };
+
+    bool _Setup(unsigned entries);
+    bool _SetupBuffers();
+    io_uring_sqe* _GetSqe();
+    void _Arm(int fd);
+    void _Disarm(int fd);
+    void _ArmOp(int fd);
+    void _CancelOp(int fd);
+    void _RecycleBuffer(uint16_t bid);
+    void _CancelAll();
+    bool _Enter(unsigned minComplete, int timeoutMs);
+    int _Reap();
+    bool _ReapOp(const io_uring_cqe& cqe, int fd, uint32_t seq, FiredEvent& fired);
+
+    std::vector<FdState> fds_;
+    unsigned pending_ = 0; // SQEs not submitted
+
+    // provided buffers, set up by first StartCompletion
+    bool buffersTried_ = false;
+    io_uring_buf* bufRing_ = nullptr;
+    std::size_t bufRingSize_ = 0;
+    std::unique_ptr<char []> buffers_;
+    uint16_t bufTail_ = 0;
+    std::vector<uint16_t> usedBuffers_; // by completions of last Poll
+    std::vector<int> starved_;          // ops stopped by running out of buffers
+
+    // mmaped rings
+    void* ring_ = nullptr;
+    std::size_t ringSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqesSize_ = 0;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cqMask_ = 0;
+};
+
+} // end namespace internal
+} // end namespace ananas
+
+#endif // end #ifdef ANANAS_HAS_IO_URING
+
+#endif
+
@@ -20,8 +20,9 @@ Kqueue::~Kqueue() {
         ::close(multiplexer_);
 }
 
-bool Kqueue::Register(int sock, int events, void* userPtr) {
+bool Kqueue::Register(int sock, int events, uint64_t userData) {
     struct kevent change[2];
+    void* userPtr = reinterpret_cast<void* >(static_cast<uintptr_t>(userData));
 
     int  cnt = 0;
 
@@ -59,12 +60,12 @@ bool Kqueue::Unregister(int sock, int events) {
 }
 
 
-bool Kqueue::Modify(int sock, int events, void* userPtr) {
+bool Kqueue::Modify(int sock, int events, uint64_t userData) {
     bool ret = Unregister(sock, eET_Read | eET_Write);
     if (events == 0)
         return ret;
 
-    return Register(sock, events, userPtr);
+    return Register(sock, events, userData);
 }
 
 
@@ -94,7 +95,7 @@ int Kqueue::Poll(std::size_t maxEvent, int timeoutMs) {
     for (int i = 0; i < nFired; ++ i) {
         FiredEvent& fired = events[i];
         fired.events   = 0;
-        fired.userdata = events_[i].udata;
+        fired.userdata = reinterpret_cast<uintptr_t>(events_[i].udata);
 
         if (events_[i].filter == EVFILT_READ)
             fired.events  |= eET_Read;
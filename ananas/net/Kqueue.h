@@ -15,8 +15,8 @@ public:
     Kqueue();
     ~Kqueue();
 
-    bool Register(int fd, int events, void* userPtr) override;
-    bool Modify(int fd, int events, void* userPtr) override;
+    bool Register(int fd, int events, uint64_t userData) override;
+    bool Modify(int fd, int events, uint64_t userData) override;
     bool Unregister(int fd, int events) override;
 
     int Poll(std::size_t maxEvent, int timeoutMs) override;
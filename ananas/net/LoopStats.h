@@ -0,0 +1,148 @@
+#ifndef BERT_LOOPSTATS_H
+#define BERT_LOOPSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+namespace ananas {
+
+// Log2 histogram: bucket 0 holds 0, bucket i holds [2^(i-1), 2^i).
+struct Histogram {
+    static constexpr int kBuckets = 40;
+
+    uint64_t buckets[kBuckets] = {};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    double Average() const;
+    // Upper bound of the bucket where p-th percentile is, p is in [0, 100]
+    uint64_t Percentile(double p) const;
+    void Merge(const Histogram& other);
+
+    static int BucketOf(uint64_t value);
+};
+
+// Snapshot of EventLoop runtime statistics, see EventLoop::GetStats.
+struct LoopStats {
+    uint64_t iterations = 0;
+    uint64_t pollNs = 0;   // blocked in Poller::Poll
+    uint64_t handleNs = 0; // running handlers, timers and tasks
+    uint64_t events = 0;
+    Histogram eventsPerPoll;
+
+    // tasks posted by other threads
+    uint64_t tasksRun = 0;
+    uint64_t tasksPending = 0; // counted since stats enabled, see EventLoop::NumOfPendingTasks
+    Histogram taskLatencyUs; // from enqueue to run, only when stats enabled
+
+    uint64_t timersFired = 0;
+    uint64_t timerWakeups = 0;    // iterations which fired timers
+    uint64_t timersCoalesced = 0; // deferred into another timer's wakeup, see TimerSlack
+
+    // buffer pool, always counted
+    uint64_t bufferAllocs = 0;
+    uint64_t bufferHits = 0;
+    uint64_t bufferRetainedBytes = 0;
+    uint64_t bufferTrimmedBytes = 0;
+
+    // registered channels by type
+    enum ChannelKind {
+        eCK_Acceptor,
+        eCK_Connection,
+        eCK_Datagram,
+        eCK_Other, // notifier, connector...
+        eCK_Max,
+    };
+    int64_t channels[eCK_Max] = {};
+
+    // aggregate, eg. for EventLoopGroup
+    void Merge(const LoopStats& other);
+    std::string ToString() const;
+};
+
+namespace internal {
+
+// Counters of LoopStats, written only by loop thread except OnTaskPosted,
+// can be read by any thread. Single writer needs no atomic RMW.
+class LoopStatsCounters {
+public:
+    LoopStatsCounters() = default;
+
+    LoopStatsCounters(const LoopStatsCounters& ) = delete;
+    void operator= (const LoopStatsCounters& ) = delete;
+
+    static int64_t NowNs() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // thread-safe
+    void OnTaskPosted() {
+        tasksPosted_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // loop thread only
+    void OnPoll(int64_t ns, int events);
+    void OnIteration(int64_t handleNs, std::size_t timersFired, std::size_t timersCoalesced);
+    // latencyNs is negative if task is not stamped,
+    // counted if OnTaskPosted was called for it
+    void OnTaskRun(int64_t latencyNs, bool counted);
+    void OnChannel(LoopStats::ChannelKind kind, int delta);
+    void ResetChannels();
+
+    // thread-safe
+    void Snapshot(LoopStats& stats) const;
+    uint64_t PendingTasks() const;
+    int64_t Channels(LoopStats::ChannelKind kind) const {
+        return channels_[kind].load(std::memory_order_relaxed);
+    }
+
+private:
+    using Counter = std::atomic<uint64_t>;
+
+    static void _Add(Counter& c, uint64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    struct AtomicHistogram {
+        Counter buckets[Histogram::kBuckets] = {};
+        Counter count {0};
+        Counter sum {0};
+        Counter max {0};
+
+        void Record(uint64_t value);
+        void Load(Histogram& h) const;
+    };
+
+    Counter iterations_ {0};
+    Counter pollNs_ {0};
+    Counter handleNs_ {0};
+    Counter events_ {0};
+    AtomicHistogram eventsPerPoll_;
+
+    Counter tasksRun_ {0};
+    Counter countedRun_ {0}; // run ones of tasksPosted_
+    AtomicHistogram taskLatencyUs_;
+
+    Counter timersFired_ {0};
+    Counter timerWakeups_ {0};
+    Counter timersCoalesced_ {0};
+
+    std::atomic<int64_t> channels_[LoopStats::eCK_Max] = {};
+
+    // written by producers, keep it away from loop's counters;
+    // padding, not alignas, see MpscQueue
+    char pad0_[64];
+    Counter tasksPosted_ {0}; // only counted ones, see OnTaskRun
+    char pad1_[64 - sizeof(Counter)];
+};
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif
+
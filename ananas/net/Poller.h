@@ -3,7 +3,10 @@
 
 #include <vector>
 #include <memory>
-#include <stdio.h>
+#include <stdint.h>
+
+#include "LoopStats.h"
+#include "ananas/util/Trace.h"
 
 namespace ananas {
 namespace internal {
@@ -13,21 +16,46 @@ enum EventType {
     eET_Read  = 0x1 << 0,
     eET_Write = 0x1 << 1,
     eET_Error = 0x1 << 2,
+    eET_Completion = 0x1 << 3, // see CompletionOp
+};
+
+// Completion based IO: poller does the read or accept for channel, and
+// reports the result instead of readiness. Only IoUringPoller supports it.
+enum class CompletionOp {
+    eNone,
+    eRecv,    // stream socket, data in poller's buffer
+    eAccept,  // listen socket, result is the new fd
+    eRecvMsg, // datagram socket, with peer address
+};
+
+struct Completion {
+    int result = 0; // bytes or new fd, -errno on error, 0 for EOF of eRecv
+    // Received data and peer address of eRecvMsg, they're in poller's
+    // buffer, valid only in HandleCompletion.
+    const char* data = nullptr;
+    const void* peer = nullptr;
+    unsigned int peerLen = 0;
+    // eRecvMsg: datagram didn't fit poller's buffer, data is cut to result
+    bool truncated = false;
 };
 
 class Channel : public std::enable_shared_from_this<Channel> {
 public:
     Channel() {
-        printf("New channel %p\n", (void*)this);
+        ANANAS_TRACE_POINT("Channel::New", this);
     }
     virtual ~Channel() {
-        printf("Delete channel %p\n", (void*)this);
+        ANANAS_TRACE_POINT("Channel::Delete", this);
     }
 
     Channel(const Channel& ) = delete;
     void operator=(const Channel& ) = delete;
 
     virtual int Identifier() const = 0; // the socket
+    // for channel count of LoopStats
+    virtual LoopStats::ChannelKind Kind() const {
+        return LoopStats::eCK_Other;
+    }
 
     unsigned int GetUniqueId() const {
         return unique_id_;
@@ -36,20 +64,113 @@ public:
         unique_id_ = id;
     }
 
+    uint64_t ReadIteration() const {
+        return read_iteration_;
+    }
+    void SetReadIteration(uint64_t iteration) {
+        read_iteration_ = iteration;
+    }
+
     virtual bool HandleReadEvent() = 0;
     virtual bool HandleWriteEvent() = 0;
     virtual void HandleErrorEvent() = 0;
+    // Only called if completion IO is started, see EventLoop::StartCompletion
+    virtual bool HandleCompletion(const Completion& ) {
+        return false;
+    }
+    // Called by loop's buffer trim if not read since the last trim, see
+    // EventLoop::TrimWhenIdle. Release memory kept for reading, return
+    // true if some is still kept.
+    virtual bool HandleIdleTrim() {
+        return false;
+    }
+
+private:
+    friend class TrimList;
+
+    unsigned int unique_id_ = 0; // generation of fd slot, dispatch by ioloop
+    uint64_t read_iteration_ = 0; // loop iteration of last read, by ioloop
+    // in TrimList of ioloop
+    bool trim_linked_ = false;
+    Channel* trim_prev_ = nullptr;
+    Channel* trim_next_ = nullptr;
+};
+
+// Intrusive list of channels which keep memory for reading, so that the
+// idle trim of loop needn't walk all channels. Loop thread only.
+class TrimList {
+public:
+    TrimList() = default;
+
+    TrimList(const TrimList& ) = delete;
+    void operator=(const TrimList& ) = delete;
+
+    bool Contains(const Channel* c) const {
+        return c->trim_linked_;
+    }
+    std::size_t Size() const {
+        return size_;
+    }
+
+    // no-op if c is already in
+    void Push(Channel* c) {
+        if (c->trim_linked_)
+            return;
+
+        c->trim_linked_ = true;
+        c->trim_prev_ = nullptr;
+        c->trim_next_ = head_;
+        if (head_)
+            head_->trim_prev_ = c;
+        head_ = c;
+        ++ size_;
+    }
+
+    // no-op if c is not in
+    void Erase(Channel* c) {
+        if (!c->trim_linked_)
+            return;
+
+        if (c->trim_prev_)
+            c->trim_prev_->trim_next_ = c->trim_next_;
+        else
+            head_ = c->trim_next_;
+        if (c->trim_next_)
+            c->trim_next_->trim_prev_ = c->trim_prev_;
+
+        c->trim_linked_ = false;
+        c->trim_prev_ = c->trim_next_ = nullptr;
+        -- size_;
+    }
+
+    void Clear() {
+        while (head_)
+            Erase(head_);
+    }
+
+    // Erase channels for which f returns false, f must not change the list
+    template <typename F>
+    void Filter(F&& f) {
+        for (Channel* c = head_; c; ) {
+            Channel* next = c->trim_next_;
+            if (!f(c))
+                Erase(c);
+            c = next;
+        }
+    }
 
 private:
-    unsigned int unique_id_ = 0; // dispatch by ioloop
+    Channel* head_ = nullptr;
+    std::size_t size_ = 0;
 };
 
 
 struct FiredEvent {
     int   events;
-    void* userdata;
+    uint64_t userdata; // see ChannelTable::Token
+    Completion completion; // if events has eET_Completion
 
-    FiredEvent() : events(0), userdata(nullptr) {
+    FiredEvent() : events(0), userdata(0) {
     }
 };
 
@@ -61,10 +182,16 @@ public:
     virtual ~Poller() {
     }
 
-    virtual bool Register(int fd, int events, void* userPtr) = 0;
-    virtual bool Modify(int fd, int events, void* userPtr) = 0;
+    virtual bool Register(int fd, int events, uint64_t userData) = 0;
+    virtual bool Modify(int fd, int events, uint64_t userData) = 0;
     virtual bool Unregister(int fd, int events) = 0;
 
+    // Start op for fd registered, eET_Read of fd is not reported any more.
+    // Return false if not supported, then channel should read by itself.
+    virtual bool StartCompletion(int , CompletionOp , uint64_t ) {
+        return false;
+    }
+
     virtual int Poll(std::size_t maxEv, int timeoutMs) = 0;
     const std::vector<FiredEvent>& GetFiredEvents() const {
         return firedEvents_;
@@ -0,0 +1,38 @@
+#include "ReadSizer.h"
+
+namespace ananas {
+
+namespace internal {
+
+constexpr std::size_t ReadSizer::kMinSize;
+constexpr std::size_t ReadSizer::kInitSize;
+constexpr std::size_t ReadSizer::kMaxSize;
+constexpr int ReadSizer::kShrinkAfter;
+
+bool ReadSizer::Record(std::size_t bytes, std::size_t space) {
+    if (bytes >= space || bytes >= guess_) {
+        // there may be more, read more next time
+        smallReads_ = 0;
+        if (guess_ < kMaxSize)
+            guess_ *= 2;
+
+        return false;
+    }
+
+    if (guess_ > kMinSize && bytes <= guess_ / 2) {
+        if (++ smallReads_ >= kShrinkAfter) {
+            smallReads_ = 0;
+            guess_ /= 2;
+            return true;
+        }
+    } else {
+        smallReads_ = 0;
+    }
+
+    return false;
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
@@ -0,0 +1,42 @@
+#ifndef BERT_READSIZER_H
+#define BERT_READSIZER_H
+
+#include <cstddef>
+
+namespace ananas {
+
+namespace internal {
+
+// Guess how many bytes the next read of a socket will return, from the
+// observed read sizes, like the adaptive allocator of netty.
+//
+// Sizes are powers of 2 in [kMinSize, kMaxSize]. A read filling the whole
+// space doubles the guess at once; only after kShrinkAfter reads in a row
+// fitting in half of the guess, it's halved. So a bursty peer will not make
+// the receive buffer thrash between sizes.
+class ReadSizer {
+public:
+    static constexpr std::size_t kMinSize = 2 * 1024;
+    static constexpr std::size_t kInitSize = 16 * 1024;
+    static constexpr std::size_t kMaxSize = 1024 * 1024;
+    static constexpr int kShrinkAfter = 4;
+
+    std::size_t Guess() const {
+        return guess_;
+    }
+
+    // bytes: returned by read; space: the size it's asked to read
+    // Return true if guess is shrunk, then buffer may release memory.
+    bool Record(std::size_t bytes, std::size_t space);
+
+private:
+    std::size_t guess_ = kInitSize;
+    int smallReads_ = 0;
+};
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif
+
@@ -0,0 +1,45 @@
+
+#ifndef BERT_TIMERFDCHANNEL_H
+#define BERT_TIMERFDCHANNEL_H
+
+#ifdef __gnu_linux__
+
+#include "Poller.h"
+#include "ananas/util/Timer.h"
+
+namespace ananas {
+
+namespace internal {
+
+// Wake up eventloop at the nearest timer, with nanoseconds precision,
+// so that loop need not poll with a short timeout.
+class TimerfdChannel : public internal::Channel {
+public:
+    TimerfdChannel();
+    ~TimerfdChannel();
+
+    TimerfdChannel(const TimerfdChannel& ) = delete;
+    void operator= (const TimerfdChannel& ) = delete;
+
+    int Identifier() const override;
+    bool HandleReadEvent() override;
+    bool HandleWriteEvent() override;
+    void HandleErrorEvent() override;
+
+    // Absolute steady clock time, TimePoint::max() to disarm.
+    // No syscall if deadline is not changed.
+    bool SetDeadline(const TimePoint& deadline);
+
+private:
+    int timerFd_;
+    TimePoint deadline_;
+};
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif // end #ifdef __gnu_linux__
+
+#endif
+
@@ -1,6 +1,7 @@
 #ifndef BERT_TYPEDEFS_H
 #define BERT_TYPEDEFS_H
 
+#include <cstddef>
 #include <functional>
 
 namespace ananas {
@@ -22,6 +23,31 @@ using UDPMessageCallback = std::function<void (DatagramSocket*, const char* data
 using UDPCreateCallback = std::function<void (DatagramSocket* )>;
 
 using SocketPairCreateCallback = std::function<void (Connection* r, Connection* w)>;
+
+// How new connections of a listener are distributed over worker loops
+enum class LoadBalance {
+    eRoundRobin,
+    eLeastConnections,   // connections plus pending tasks, such as handovers
+    eLeastPendingTasks,
+    ePowerOfTwoChoices,  // the less loaded of two random loops
+    eHashByPeer,         // connections from the same ip go to the same loop
+};
+
+// Work limits of one EventLoop iteration, 0 is unlimited.
+// Leftover is carried over to the next iteration, which polls without blocking.
+struct LoopBudget {
+    size_t tasks = 0;        // posted tasks, urgent tasks are not limited
+    size_t timers = 0;       // timer callbacks
+    size_t readBytes = 0;    // bytes read by one connection
+    size_t readMessages = 0; // messages handled by one connection
+};
+
+// I/O multiplexer of EventLoop
+enum class PollerType {
+    eDefault, // epoll on linux, kqueue on mac os
+    eEdgeTriggered, // epoll with EPOLLET on linux, eDefault on mac os
+    eIoUring, // linux 5.13+, fallback to eDefault if not available
+};
 }
 
 #endif
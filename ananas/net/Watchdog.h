@@ -0,0 +1,124 @@
+#ifndef BERT_WATCHDOG_H
+#define BERT_WATCHDOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <signal.h>
+
+#include "ananas/util/Timer.h"
+
+namespace ananas {
+
+class EventLoop;
+
+namespace internal {
+
+// What a loop is doing, stamped by loop thread, sampled by Watchdog.
+// Only relaxed stores, no clock in loop thread.
+struct Heartbeat {
+    enum Kind {
+        eIdle,
+        eRead,
+        eWrite,
+        eError,
+        eTimer,
+        eTask,
+    };
+
+    void Enter(Kind k, int f = -1, const char* t = nullptr) {
+        fd.store(f, std::memory_order_relaxed);
+        tag.store(t, std::memory_order_relaxed);
+        kind.store(k, std::memory_order_relaxed);
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void Leave() {
+        kind.store(eIdle, std::memory_order_relaxed);
+    }
+
+    static const char* Name(int kind);
+
+    std::atomic<uint64_t> seq {0}; // bumped by every Enter
+    std::atomic<int> kind {eIdle};
+    std::atomic<int> fd {-1};
+    std::atomic<const char* > tag {nullptr}; // static string, see StallInfo::tag
+};
+
+} // end namespace internal
+
+struct StallInfo {
+    int loopId;
+    const char* what; // read, write, error, timer, task
+    int fd;           // -1 if not a channel
+    const char* tag;  // type of task's or timer's callable, which names
+                      // where it's posted for lambdas; nullptr if neither
+    DurationMs duration;
+    bool finished;    // false if it's still running
+};
+
+using StallCallback = std::function<void (const StallInfo& )>;
+
+// A thread monitors heartbeats of event loops, and reports handlers, timers
+// and tasks running longer than budget: once when detected, once finished.
+// Precision of duration is about budget / 4.
+class Watchdog {
+public:
+    explicit
+    Watchdog(DurationMs budget);
+    ~Watchdog();
+
+    Watchdog(const Watchdog& ) = delete;
+    void operator= (const Watchdog& ) = delete;
+
+    // Called in watchdog thread, default is logging.
+    // Must be called before Start.
+    void SetStallCallback(StallCallback cb);
+
+    // Dump stack of stalled loop thread to stderr, by signal signo.
+    // Signals not sent by Watchdog go to the previous handler, unless it's
+    // SIG_DFL or SIG_IGN. Must be called before Start.
+    void EnableBacktrace(bool enable, int signo = SIGURG);
+
+    void Start();
+    void Stop();
+
+    // thread-safe
+    // Loop must be unwatched before destructed.
+    void Watch(EventLoop* loop);
+    void Unwatch(EventLoop* loop);
+
+private:
+    struct Entry {
+        EventLoop* loop;
+        uint64_t seq;
+        TimePoint since;
+        bool reported;
+        int kind; // of the reported stall
+        int fd;
+        const char* tag;
+    };
+
+    void _Run();
+    void _Check(Entry& e, const TimePoint& now);
+    void _Report(const Entry& e, const TimePoint& now, bool finished);
+
+    const DurationMs budget_;
+    StallCallback onStall_;
+    bool backtrace_ = false;
+    int signo_ = SIGURG;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<Entry> loops_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // end namespace ananas
+
+#endif
+
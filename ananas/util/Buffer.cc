@@ -1,6 +1,8 @@
 
 #include "Buffer.h"
+#include "BufferPool.h"
 #include <iostream>
+#include <algorithm>
 #include <limits>
 #include <cassert>
 
@@ -97,12 +99,14 @@ void Buffer::AssureSpace(std::size_t needsize) {
     }
 
     if (oldCap < capacity_) {
-        std::unique_ptr<char []> tmp(new char[capacity_]);
+        // pool may give a bit more
+        char* tmp = internal::BufferPool::Allocate(capacity_);
 
         if (dataSize != 0)
             memcpy(&tmp[0], &buffer_[readPos_], dataSize);
 
-        buffer_.swap(tmp);
+        internal::BufferPool::Free(buffer_, oldCap);
+        buffer_ = tmp;
     } else {
         assert (readPos_ > 0);
         ::memmove(&buffer_[0], &buffer_[readPos_], dataSize);
@@ -113,24 +117,23 @@ void Buffer::AssureSpace(std::size_t needsize) {
 }
 
 
-void Buffer::Shrink() {
-    if (IsEmpty()) {
-        Clear();
-        capacity_ = 0;
-        buffer_.reset();
+void Buffer::Shrink(std::size_t reserve) {
+    if (IsEmpty() && reserve == 0) {
+        _Release();
         return;
     }
 
     std::size_t oldCap = capacity_;
     std::size_t dataSize = ReadableSize();
-    if (dataSize > oldCap / 2)
+    if (dataSize + reserve > oldCap / 2)
         return;
 
-    std::size_t newCap = RoundUp2Power(dataSize);
+    std::size_t newCap = RoundUp2Power(dataSize + reserve);
 
-    std::unique_ptr<char []> tmp(new char[newCap]);
+    char* tmp = internal::BufferPool::Allocate(newCap);
     memcpy(&tmp[0], &buffer_[readPos_], dataSize);
-    buffer_.swap(tmp);
+    internal::BufferPool::Free(buffer_, oldCap);
+    buffer_ = tmp;
     capacity_ = newCap;
 
     readPos_  = 0;
@@ -145,10 +148,24 @@ void Buffer::Swap(Buffer& buf) {
     std::swap(readPos_, buf.readPos_);
     std::swap(writePos_, buf.writePos_);
     std::swap(capacity_, buf.capacity_);
-    buffer_.swap(buf.buffer_);
+    std::swap(buffer_, buf.buffer_);
+}
+
+Buffer::~Buffer() {
+    _Release();
 }
 
-Buffer::Buffer(Buffer&& other) {
+void Buffer::_Release() {
+    internal::BufferPool::Free(buffer_, capacity_);
+    buffer_ = nullptr;
+    readPos_ = writePos_ = capacity_ = 0;
+}
+
+Buffer::Buffer(Buffer&& other) :
+    readPos_(0),
+    writePos_(0),
+    capacity_(0),
+    buffer_(nullptr) {
     _MoveFrom(std::move(other));
 }
 
@@ -158,17 +175,135 @@ Buffer& Buffer::operator= (Buffer&& other) {
 
 Buffer& Buffer::_MoveFrom(Buffer&& other) {
     if (this != &other) {
+        _Release();
+
         this->readPos_ = other.readPos_;
         this->writePos_ = other.writePos_;
         this->capacity_ = other.capacity_;
-        this->buffer_ = std::move(other.buffer_);
+        this->buffer_ = other.buffer_;
 
-        other.Clear();
-        other.Shrink();
+        other.buffer_ = nullptr;
+        other.readPos_ = other.writePos_ = other.capacity_ = 0;
     }
 
     return *this;
 }
 
+
+constexpr std::size_t BufferVector::kChunkSize;
+
+BufferVector::BufferVector(BufferVector&& other) {
+    *this = std::move(other);
+}
+
+BufferVector& BufferVector::operator= (BufferVector&& other) {
+    if (this != &other) {
+        ring_ = std::move(other.ring_);
+        head_ = other.head_;
+        count_ = other.count_;
+        totalBytes_ = other.totalBytes_;
+
+        other.ring_.clear();
+        other.head_ = other.count_ = other.totalBytes_ = 0;
+    }
+
+    return *this;
+}
+
+void BufferVector::Clear() {
+    while (!Empty())
+        Pop();
+}
+
+Buffer* BufferVector::_MergeTarget(std::size_t size) {
+    if (Empty())
+        return nullptr;
+
+    Buffer& tail = _At(count_ - 1);
+    return tail.ReadableSize() + size <= kChunkSize ? &tail : nullptr;
+}
+
+Buffer& BufferVector::_PushSlot() {
+    if (count_ == ring_.size()) {
+        // slots are moved, buffer memory is not
+        std::vector<Buffer> ring(std::max<std::size_t>(8, ring_.size() * 2));
+        for (std::size_t i = 0; i < count_; ++ i)
+            ring[i] = std::move(_At(i));
+
+        ring_.swap(ring);
+        head_ = 0;
+    }
+
+    return _At(count_ ++);
+}
+
+void BufferVector::Push(Buffer&& buf) {
+    const std::size_t size = buf.ReadableSize();
+    if (size == 0)
+        return;
+
+    totalBytes_ += size;
+    if (Buffer* tail = _MergeTarget(size))
+        tail->PushData(buf.ReadAddr(), size);
+    else
+        _PushSlot() = std::move(buf);
+}
+
+void BufferVector::Push(const void* data, std::size_t size) {
+    if (size == 0)
+        return;
+
+    totalBytes_ += size;
+    if (Buffer* tail = _MergeTarget(size))
+        tail->PushData(data, size);
+    else
+        _PushSlot().PushData(data, size);
+}
+
+void BufferVector::Pop() {
+    assert (!Empty());
+
+    Buffer& front = Front();
+    totalBytes_ -= front.ReadableSize();
+    front.Clear();
+    front.Shrink(); // back to pool
+
+    head_ = (head_ + 1) & (ring_.size() - 1);
+    -- count_;
+}
+
+void BufferVector::Consume(std::size_t bytes) {
+    assert (bytes <= totalBytes_);
+
+    while (bytes > 0) {
+        Buffer& front = Front();
+        if (bytes < front.ReadableSize()) {
+            front.Consume(bytes);
+            totalBytes_ -= bytes;
+            return;
+        }
+
+        bytes -= front.ReadableSize();
+        Pop();
+    }
+}
+
+int BufferVector::Gather(struct iovec* vecs, int max, std::size_t* bytes) const {
+    const int n = static_cast<int>(std::min<std::size_t>(count_, static_cast<std::size_t>(max)));
+
+    std::size_t total = 0;
+    for (int i = 0; i < n; ++ i) {
+        const Buffer& buf = _At(i);
+        vecs[i].iov_base = const_cast<char*>(buf.ReadAddr());
+        vecs[i].iov_len = buf.ReadableSize();
+        total += buf.ReadableSize();
+    }
+
+    if (bytes)
+        *bytes = total;
+
+    return n;
+}
+
 } // end namespace ananas
 
@@ -5,24 +5,32 @@
 #include <cstring>
 #include <memory>
 #include <list>
+#include <vector>
+#include <sys/uio.h>
 
 namespace ananas {
 
+// Memory is drawn from and returned to BufferPool of the current thread,
+// see EventLoop.
 class Buffer {
 public:
     Buffer() :
         readPos_(0),
         writePos_(0),
-        capacity_(0) {
+        capacity_(0),
+        buffer_(nullptr) {
     }
 
     Buffer(const void* data, size_t size) :
         readPos_(0),
         writePos_(0),
-        capacity_(0) {
+        capacity_(0),
+        buffer_(nullptr) {
         PushData(data, size);
     }
 
+    ~Buffer();
+
     Buffer(const Buffer& ) = delete;
     void operator = (const Buffer& ) = delete;
 
@@ -42,6 +50,9 @@ public:
     char* ReadAddr()  {
         return &buffer_[readPos_];
     }
+    const char* ReadAddr() const {
+        return &buffer_[readPos_];
+    }
     char* WriteAddr() {
         return &buffer_[writePos_];
     }
@@ -59,7 +70,8 @@ public:
         return capacity_;
     }
 
-    void Shrink();
+    // Release memory if capacity is more than twice of data plus reserve.
+    void Shrink(std::size_t reserve = 0);
     void Clear();
     void Swap(Buffer& buf);
 
@@ -71,24 +83,61 @@ public:
 
 private:
     Buffer& _MoveFrom(Buffer&& );
+    void _Release();
 
     std::size_t readPos_;
     std::size_t writePos_;
     std::size_t capacity_;
-    std::unique_ptr<char []>  buffer_;
+    char* buffer_; // from BufferPool
 };
 
 
-struct BufferVector {
-    static constexpr int kMinSize = 1024;
+// Queue of buffers, for data waiting to be sent.
+//
+// Buffers are kept in a ring of slots which grows by doubling, so push and
+// pop allocate nothing but buffer memory, which comes from BufferPool.
+// Small data is appended to the tail buffer while it fits in kChunkSize.
+class BufferVector {
+public:
+    static constexpr std::size_t kChunkSize = 16 * 1024;
+
+    template <typename V, typename Vec>
+    class Iterator {
+    public:
+        Iterator(Vec* vec, std::size_t pos) :
+            vec_(vec),
+            pos_(pos) {
+        }
 
-    typedef std::list<Buffer> BufferContainer;
+        V& operator* () const {
+            return vec_->_At(pos_);
+        }
+        V* operator-> () const {
+            return &vec_->_At(pos_);
+        }
 
-    typedef BufferContainer::const_iterator const_iterator;
-    typedef BufferContainer::iterator iterator;
-    typedef BufferContainer::value_type value_type;
-    typedef BufferContainer::reference reference;
-    typedef BufferContainer::const_reference const_reference;
+        Iterator& operator++ () {
+            ++ pos_;
+            return *this;
+        }
+
+        bool operator== (const Iterator& other) const {
+            return pos_ == other.pos_;
+        }
+        bool operator!= (const Iterator& other) const {
+            return pos_ != other.pos_;
+        }
+
+    private:
+        Vec* vec_;
+        std::size_t pos_;
+    };
+
+    typedef Iterator<Buffer, BufferVector> iterator;
+    typedef Iterator<const Buffer, const BufferVector> const_iterator;
+    typedef Buffer value_type;
+    typedef Buffer& reference;
+    typedef const Buffer& const_reference;
 
     BufferVector() {
     }
@@ -97,77 +146,81 @@ struct BufferVector {
         Push(std::move(first));
     }
 
+    BufferVector(BufferVector&& );
+    BufferVector& operator= (BufferVector&& );
+
     bool Empty() const {
-        return buffers.empty();
+        return count_ == 0;
     }
 
-    std::size_t TotalBytes() const {
-        return totalBytes;
+    // number of buffers
+    std::size_t Size() const {
+        return count_;
     }
 
-    void Clear() {
-        buffers.clear();
-        totalBytes = 0;
+    std::size_t TotalBytes() const {
+        return totalBytes_;
     }
 
-    void Push(Buffer&& buf) {
-        totalBytes += buf.ReadableSize();
-        if (_ShouldMerge()) {
-            auto& last = buffers.back();
-            last.PushData(buf.ReadAddr(), buf.ReadableSize());
-        } else {
-            buffers.push_back(std::move(buf));
-        }
-    }
+    void Clear();
 
-    void Push(const void* data, size_t size) {
-        totalBytes += size;
-        if (_ShouldMerge()) {
-            auto& last = buffers.back();
-            last.PushData(data, size);
-        } else {
-            buffers.push_back(Buffer(data, size));
-        }
-    }
+    void Push(Buffer&& buf);
+    void Push(const void* data, std::size_t size);
 
-    void Pop() {
-        totalBytes -= buffers.front().ReadableSize();
-        buffers.pop_front();
+    Buffer& Front() {
+        return _At(0);
     }
+    void Pop();
+
+    // Remove bytes from front, such as sent by network.
+    // Only the last touched buffer may be partially consumed.
+    void Consume(std::size_t bytes);
+
+    // Fill at most max iovecs with data from front, return the number filled.
+    // bytes: if not null, set to the bytes of filled iovecs.
+    int Gather(struct iovec* vecs, int max, std::size_t* bytes = nullptr) const;
 
     iterator begin() {
-        return buffers.begin();
+        return iterator(this, 0);
     }
     iterator end() {
-        return buffers.end();
+        return iterator(this, count_);
     }
 
     const_iterator begin() const {
-        return buffers.begin();
+        return const_iterator(this, 0);
     }
     const_iterator end() const {
-        return buffers.end();
+        return const_iterator(this, count_);
     }
 
     const_iterator cbegin() const {
-        return buffers.cbegin();
+        return begin();
     }
     const_iterator cend() const {
-        return buffers.cend();
+        return end();
     }
 
-    BufferContainer buffers;
-    size_t totalBytes {0};
-
 private:
-    bool _ShouldMerge() const {
-        if (buffers.empty()) {
-            return false;
-        } else {
-            const auto& last = buffers.back();
-            return last.ReadableSize() < kMinSize;
-        }
+    template <typename V, typename Vec>
+    friend class Iterator;
+
+    Buffer& _At(std::size_t pos) {
+        return ring_[(head_ + pos) & (ring_.size() - 1)];
     }
+    const Buffer& _At(std::size_t pos) const {
+        return ring_[(head_ + pos) & (ring_.size() - 1)];
+    }
+
+    // empty slot after tail
+    Buffer& _PushSlot();
+    // tail buffer if data of size can be appended to it, or nullptr
+    Buffer* _MergeTarget(std::size_t size);
+
+    std::vector<Buffer> ring_; // size is power of 2
+    std::size_t head_ = 0;
+    std::size_t count_ = 0;
+    std::size_t totalBytes_ = 0;
 };
 
 struct Slice {
@@ -0,0 +1,99 @@
+#ifndef BERT_BUFFERPOOL_H
+#define BERT_BUFFERPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+namespace ananas {
+
+namespace internal {
+
+// Size-class pool of Buffer memory, owned by EventLoop, NOT thread-safe.
+//
+// Block sizes are powers of 2 from 64B to 1MB, larger ones are not pooled.
+// Blocks are plain operator new memory, so a block allocated by one thread
+// can be released to the pool of another thread, or to heap if the thread
+// has no pool.
+// Free blocks are kept in intrusive lists until limit, Trim releases blocks
+// which stay unused since last trim.
+class BufferPool {
+public:
+    static constexpr int kMinShift = 6;
+    static constexpr int kMaxShift = 20;
+    static constexpr std::size_t kDefaultLimit = 16 * 1024 * 1024;
+
+    struct Stats {
+        uint64_t allocs = 0;
+        uint64_t hits = 0; // allocs served from pool
+        uint64_t frees = 0;
+        uint64_t trimmedBytes = 0;
+        uint64_t retainedBytes = 0; // free bytes kept in pool now
+    };
+
+    BufferPool();
+    ~BufferPool();
+
+    BufferPool(const BufferPool& ) = delete;
+    void operator= (const BufferPool& ) = delete;
+
+    // pool of this thread, nullptr if none
+    static BufferPool* Current();
+    // nullptr to uninstall
+    static void SetCurrent(BufferPool* pool);
+
+    // Allocate at least size bytes, size is set to the real size.
+    // Use pool of this thread if any.
+    static char* Allocate(std::size_t& size);
+    // size: the real size given by Allocate
+    static void Free(char* block, std::size_t size);
+
+    // max free bytes kept, 0 to disable pooling
+    void SetLimit(std::size_t bytes);
+    void Trim();
+
+    // thread-safe
+    Stats GetStats() const;
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct SizeClass {
+        FreeBlock* head = nullptr;
+        std::size_t count = 0;
+        std::size_t lowWater = 0; // min count since last trim
+    };
+
+    static constexpr int kClasses = kMaxShift - kMinShift + 1;
+
+    // -1 if size is too large to be pooled
+    static int _ClassOf(std::size_t size);
+    char* _Pop(int cls);
+    bool _Push(int cls, char* block);
+    void _Release(int cls, std::size_t n);
+
+    SizeClass classes_[kClasses];
+    std::size_t limit_;
+
+    // written only by owner thread, see LoopStatsCounters
+    using Counter = std::atomic<uint64_t>;
+
+    static void _Add(Counter& c, int64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    Counter allocs_ {0};
+    Counter hits_ {0};
+    Counter frees_ {0};
+    Counter trimmedBytes_ {0};
+    Counter retainedBytes_ {0};
+};
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#endif
+
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <cstdio>
 #include <sstream>
+#include <functional>
 #include <errno.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -138,7 +139,8 @@ void Logger::Flush(enum LogLevel level) {
     if (pos_ == kPrefixTimeLen + kPrefixLevelLen)
         return; // empty log
 
-    Time now;
+    // microseconds part is only as precise as the kernel tick
+    const Time now(CoarseClock::SystemNow());
 
     auto seconds = now.MilliSeconds() / 1000;
     if (seconds != lastLogSecond_) {
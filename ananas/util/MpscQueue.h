@@ -0,0 +1,150 @@
+#ifndef BERT_MPSCQUEUE_H
+#define BERT_MPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+
+namespace ananas {
+namespace internal {
+
+// Intrusive node, derive your element type from it.
+struct MpscNode {
+    std::atomic<MpscNode* > mpscNext_ {nullptr};
+};
+
+// Intrusive lock-free multi-producer single-consumer queue,
+// see Dmitry Vyukov's non-intrusive MPSC node-based queue.
+//
+// Push is wait-free and can be called from any thread;
+// Pop and Consume must be called only by the consumer thread.
+// The queue owns the pushed nodes until they're popped, remaining
+// nodes are deleted when the queue is destructed.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() :
+        head_(&stub_),
+        tail_(&stub_) {
+    }
+
+    ~MpscQueue() {
+        while (T* node = Pop())
+            delete node;
+    }
+
+    MpscQueue(const MpscQueue& ) = delete;
+    void operator= (const MpscQueue& ) = delete;
+
+    // thread-safe
+    void Push(T* node) {
+        _Push(node);
+    }
+
+    // Returns nullptr if empty, or a producer is in the middle of Push.
+    // The latter is fine: that producer will notify consumer after Push.
+    T* Pop();
+
+    // Pop the nodes pushed before calling Consume, and pass each to f,
+    // f takes the ownership of node.
+    // Nodes pushed concurrently are left to next call, so that busy
+    // producers can not starve the consumer.
+    // At most max nodes are popped, the rest are left to next call.
+    template <typename F>
+    std::size_t Consume(F&& f,
+                        std::size_t max = std::numeric_limits<std::size_t>::max());
+
+    // Only for consumer thread.
+    // A node in the middle of Push is treated as not empty.
+    bool Empty() const {
+        return tail_ == &stub_ &&
+               head_.load(std::memory_order_acquire) == &stub_;
+    }
+
+private:
+    void _Push(MpscNode* node) {
+        node->mpscNext_.store(nullptr, std::memory_order_relaxed);
+        MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->mpscNext_.store(node, std::memory_order_release);
+    }
+
+    // Avoid false sharing between producers and consumer. Padding, not
+    // alignas: the owner is allocated by plain new, which doesn't honor
+    // over-alignment before C++17.
+    static constexpr std::size_t kCacheLine = 64;
+
+    char pad0_[kCacheLine];
+    std::atomic<MpscNode* > head_;
+    char pad1_[kCacheLine - sizeof(std::atomic<MpscNode* >)];
+    MpscNode* tail_;
+    MpscNode stub_;
+};
+
+template <typename T>
+T* MpscQueue<T>::Pop() {
+    MpscNode* tail = tail_;
+    MpscNode* next = tail->mpscNext_.load(std::memory_order_acquire);
+
+    if (tail == &stub_) {
+        if (!next)
+            return nullptr;
+
+        // skip stub
+        tail_ = next;
+        tail = next;
+        next = next->mpscNext_.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        tail_ = next;
+        return static_cast<T* >(tail);
+    }
+
+    if (tail != head_.load(std::memory_order_acquire))
+        return nullptr; // producer not finished yet
+
+    // tail is the last one, push stub behind it so we can pop it
+    _Push(&stub_);
+
+    next = tail->mpscNext_.load(std::memory_order_acquire);
+    if (next) {
+        tail_ = next;
+        return static_cast<T* >(tail);
+    }
+
+    return nullptr;
+}
+
+template <typename T>
+template <typename F>
+std::size_t MpscQueue<T>::Consume(F&& f, std::size_t max) {
+    // If head is stub, Pop has pushed stub behind its last node, but there
+    // may be nodes pushed before stub, so drain until Pop returns nullptr.
+    const MpscNode* last = head_.load(std::memory_order_acquire);
+    if (last == &stub_)
+        last = nullptr; // no limit
+
+    std::size_t n = 0;
+    while (n < max) {
+        T* node = Pop();
+        if (!node)
+            break;
+
+        ++ n;
+
+        // f may delete node
+        const bool isLast = (node == last);
+        f(node);
+
+        if (isLast)
+            break;
+    }
+
+    return n;
+}
+
+} // end namespace internal
+} // end namespace ananas
+
+#endif
+
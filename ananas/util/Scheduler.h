@@ -1,6 +1,9 @@
 #ifndef BERT_SCHEDULER_H
 #define BERT_SCHEDULER_H
 
+#include <chrono>
+#include "ananas/util/UniqueFunction.h"
+
 namespace ananas {
 
 class Scheduler {
@@ -26,8 +29,8 @@ public:
      * },
      * &this_loop);
      */
-    virtual void ScheduleLater(std::chrono::milliseconds duration, std::function<void()> f) = 0;
-    virtual void Schedule(std::function<void()> f) = 0;
+    virtual void ScheduleLater(std::chrono::milliseconds duration, UniqueFunction<void()> f) = 0;
+    virtual void Schedule(UniqueFunction<void()> f) = 0;
 };
 
 } // end namespace ananas
@@ -73,7 +73,7 @@ void ThreadPool::_WorkerRoutine() {
     working_ = true;
 
     while (working_) {
-        std::function<void ()> task;
+        UniqueFunction<void ()> task;
 
         {
             std::unique_lock<std::mutex> guard(mutex_);
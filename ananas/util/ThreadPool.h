@@ -8,8 +8,8 @@
 #include <mutex>
 #include <condition_variable>
 #include "ananas/future/Future.h"
-#include <iostream>
-using namespace std;
+#include "ananas/util/Trace.h"
+#include "ananas/util/UniqueFunction.h"
 
 namespace ananas {
 
@@ -44,6 +44,11 @@ public:
               typename = typename std::enable_if<std::is_void<typename std::result_of<F (Args...)>::type>::value, void>::type>
     auto Execute(F&& f, Args&&... args) -> Future<void>;
 
+    // Fire-and-forget, no promise or future is created, f can be move-only.
+    // Return false if pool is shutdown.
+    template <typename F>
+    bool Post(F&& f);
+
     void JoinAll();
     void SetMaxIdleThreads(unsigned int );
     void SetMaxThreads(unsigned int );
@@ -68,7 +73,7 @@ private:
     std::condition_variable cond_;
     unsigned waiters_;
     bool shutdown_;
-    std::deque<std::function<void ()> > tasks_;
+    std::deque<UniqueFunction<void ()> > tasks_;
 
     static const int kMaxThreads = 1024;
     static std::thread::id s_mainThread;
@@ -78,13 +83,13 @@ private:
 // if F return something
 template <typename F, typename... Args, typename, typename >
 auto ThreadPool::Execute(F&& f, Args&&... args) -> Future<typename std::result_of<F (Args...)>::type> {
-	cout<<"ThreadPool::Execute return something"<<endl;
     using resultType = typename std::result_of<F (Args...)>::type;
 
     std::unique_lock<std::mutex> guard(mutex_);
     if (shutdown_)
         return MakeReadyFuture<resultType>(resultType());
 
+    ANANAS_TRACE_POINT("ThreadPool::Execute", waiters_);
     Promise<resultType> promise;
     auto future = promise.GetFuture();
 
@@ -109,7 +114,6 @@ auto ThreadPool::Execute(F&& f, Args&&... args) -> Future<typename std::result_o
 // F return void
 template <typename F, typename... Args, typename >
 auto ThreadPool::Execute(F&& f, Args&&... args) -> Future<void> {
-	cout<<"ThreadPool::Execute return void"<<endl;
     using resultType = typename std::result_of<F (Args...)>::type;
     static_assert(std::is_void<resultType>::value, "must be void");
 
@@ -117,6 +121,7 @@ auto ThreadPool::Execute(F&& f, Args&&... args) -> Future<void> {
     if (shutdown_)
         return MakeReadyFuture();
 
+    ANANAS_TRACE_POINT("ThreadPool::Execute", waiters_);
     Promise<resultType> promise;
     auto future = promise.GetFuture();
 
@@ -139,6 +144,20 @@ auto ThreadPool::Execute(F&& f, Args&&... args) -> Future<void> {
     return future;
 }
 
+template <typename F>
+bool ThreadPool::Post(F&& f) {
+    std::unique_lock<std::mutex> guard(mutex_);
+    if (shutdown_)
+        return false;
+
+    tasks_.emplace_back(std::forward<F>(f));
+    if (waiters_ == 0 && currentThreads_ < maxThreads_)
+        _SpawnWorker();
+
+    cond_.notify_one();
+    return true;
+}
+
 } // end namespace ananas
 
 #endif
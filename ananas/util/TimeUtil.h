@@ -9,9 +9,20 @@
 
 namespace ananas {
 
+// Process-wide coarse clock: resolution is the kernel tick(1~10ms) on linux,
+// but it's read from vdso without syscall, much cheaper than now().
+// For timestamps which need no exact precision, such as log.
+// Fallback to the precise clock on other platforms.
+class CoarseClock {
+public:
+    static std::chrono::system_clock::time_point SystemNow();
+};
+
 class Time {
 public:
     Time();
+    explicit
+    Time(const std::chrono::system_clock::time_point& tp);
 
     void Now();
     int64_t MilliSeconds() const;
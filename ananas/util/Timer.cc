@@ -1,117 +1,271 @@
 #include <vector>
+#include <algorithm>
 #include <cassert>
 #include "Timer.h"
+#include "TimingWheel.h"
 
 namespace ananas {
 namespace internal {
 
-unsigned int TimerManager::s_timerIdGen_ = 0;
+static const uint32_t kNoFree = ~uint32_t(0);
 
-TimerManager::TimerManager() {
+TimerManager::TimerManager(TimerBackend backend) :
+    backend_(TimerBackend::eMap),
+    freeList_(kNoFree) {
+    SetBackend(backend);
 }
 
 TimerManager::~TimerManager() {
 }
 
-void TimerManager::Update() {
-    if (timers_.empty())
+void TimerManager::SetBackend(TimerBackend backend) {
+    if (backend == backend_)
         return;
 
-    const auto now = std::chrono::steady_clock::now();
+    queue_.clear();
+    wheel_.reset();
 
-    for (auto it(timers_.begin()); it != timers_.end(); ) {
-        if (it->first > now)
-            return;
-
-        // support cancel self
-        it->second.OnTimer();
-
-        // steal and erase it
-        Timer timer(std::move(it->second));
-        it = timers_.erase(it);
-
-        if (timer.count_ != 0) {
-            // need reschedule
-            const auto tp = timer.id_->first;
-            auto itNew = timers_.insert(std::make_pair(tp, std::move(timer)));
-            if (it == timers_.end() || itNew->first < it->first)
-                it = itNew;
-        }
+    backend_ = backend;
+    if (backend_ == TimerBackend::eWheel)
+        wheel_.reset(new TimingWheel(std::chrono::steady_clock::now()));
+
+    for (uint32_t i = 0; i < timers_.size(); ++ i) {
+        if (timers_[i].state == Timer::ePending)
+            _Enqueue(i);
     }
 }
 
-bool TimerManager::Cancel(TimerId id) {
-    //time point + uid
-    auto begin = timers_.lower_bound(id->first);
-    if (begin == timers_.end())
-        return false;
+TimerBackend TimerManager::Backend() const {
+    return backend_;
+}
 
-    auto end = timers_.upper_bound(id->first);
-    for (auto it(begin); it != end; ++ it) {
-        if (it->second.UniqueId() == id->second) {
-            // lazy delete, in case cancel another timer during on timer call.
-            it->second.count_ = 0;
-            return true;
-        }
+void TimerManager::SetOnFire(UniqueFunction<void (const char* )> f) {
+    onFire_ = std::move(f);
+}
+
+TimerId TimerManager::_Add(const TimePoint& triggerTime, DurationUs interval, int count,
+                           DurationUs slack, UniqueFunction<void ()>&& func, const char* tag) {
+    uint32_t index = freeList_;
+    if (index != kNoFree) {
+        freeList_ = timers_[index].nextFree;
+    } else {
+        index = static_cast<uint32_t>(timers_.size());
+        timers_.emplace_back();
     }
 
-    return false;
+    Timer& t = timers_[index];
+    if (++ t.generation == 0)
+        t.generation = 1;
+
+    t.when = triggerTime;
+    t.interval = interval;
+    t.slack = std::max(DurationUs(0), slack);
+    t.count = count;
+    t.state = Timer::ePending;
+    t.func = std::move(func);
+    t.tag = tag;
+
+    ++ size_;
+    _Enqueue(index);
+    return TimerId(index, t.generation);
 }
 
-DurationMs TimerManager::NearestTimer() const {
-    if (timers_.empty())
-        return DurationMs::max();
+bool TimerManager::_IsLive(TimerId id) const {
+    return id.index_ < timers_.size() &&
+           timers_[id.index_].generation == id.generation_ &&
+           timers_[id.index_].state != Timer::eFree;
+}
 
-    const auto& timer = timers_.begin()->second;
-    auto now = std::chrono::steady_clock::now();
-    if (now > timer.Id()->first)
-        return DurationMs::min();
+void TimerManager::_Enqueue(uint32_t index) {
+    Timer& t = timers_[index];
+    const TimePoint deadline = _Deadline(t);
+    if (backend_ == TimerBackend::eWheel)
+        wheel_->Add(index, deadline);
     else
-        return std::chrono::duration_cast<DurationMs>(timer.Id()->first - now);
+        t.pos = queue_.insert(std::make_pair(deadline, index));
+}
+
+TimePoint TimerManager::_Deadline(const Timer& t) const {
+    if (t.slack.count() == 0)
+        return t.when;
+
+    // Round up to the coarsest grid inside [when, when + slack]: the step is
+    // the largest power of 2 not above slack. Grid is shared by all timers,
+    // so ones with overlapping windows likely expire at the same point.
+    const uint64_t slackUs = static_cast<uint64_t>(t.slack.count());
+    const DurationUs stepUs(int64_t(1) << (63 - __builtin_clzll(slackUs)));
+    const auto step = std::chrono::duration_cast<TimePoint::duration>(stepUs);
+
+    const auto rem = t.when.time_since_epoch() % step;
+    if (rem.count() <= 0)
+        return t.when;
+
+    if (t.when > TimePoint::max() - step)
+        return t.when; // avoid overflow
+
+    return t.when + (step - rem);
 }
 
-TimerManager::Timer::Timer(const TimePoint& tp) :
-    id_(std::make_shared<std::pair<TimePoint, unsigned int>>(tp, ++ TimerManager::s_timerIdGen_)),
-    count_(kForever) {
+void TimerManager::_Dequeue(uint32_t index) {
+    if (backend_ == TimerBackend::eWheel)
+        wheel_->Remove(index);
+    else
+        queue_.erase(timers_[index].pos);
 }
 
-TimerManager::Timer::Timer(Timer&& timer) {
-    _Move(std::move(timer));
+void TimerManager::_Free(uint32_t index) {
+    Timer& t = timers_[index];
+    t.state = Timer::eFree;
+    t.func = nullptr; // release captures now
+    t.nextFree = freeList_;
+    freeList_ = index;
+    -- size_;
 }
 
-TimerManager::Timer& TimerManager::Timer::operator= (Timer&& timer) {
-    if (this != &timer)
-        _Move(std::move(timer));
+bool TimerManager::_Fire(uint32_t index) {
+    Timer& t = timers_[index];
+    const bool deferred = _Deadline(t) != t.when;
+    if (t.count != kForever)
+        -- t.count;
+
+    // support cancel self, t is not moved by timers added in callback
+    t.state = Timer::eRunning;
+    if (onFire_)
+        onFire_(t.tag);
+    if (t.func)
+        t.func();
+
+    if (t.count != 0) {
+        t.when += t.interval;
+        t.state = Timer::ePending;
+        _Enqueue(index);
+    } else {
+        _Free(index);
+    }
 
-    return *this;
+    return deferred;
 }
 
-void TimerManager::Timer::_Move(Timer&& timer) {
-    this->id_ = std::move(timer.id_);
-    this->func_ = std::move(timer.func_);
-    this->interval_ = std::move(timer.interval_);
-    this->count_ = timer.count_;
+std::size_t TimerManager::Update(std::size_t max) {
+    if (size_ == 0)
+        return 0;
+
+    return Update(std::chrono::steady_clock::now(), max);
 }
 
+std::size_t TimerManager::Update(const TimePoint& now, std::size_t max) {
+    if (size_ == 0)
+        return 0;
 
-void TimerManager::Timer::OnTimer() {
-    if (!func_ || count_ == 0)
-        return;
+    std::size_t nDeferred = 0;
+    const std::size_t nFired = backend_ == TimerBackend::eMap ?
+                               _UpdateMap(now, max, nDeferred) :
+                               _UpdateWheel(now, max, nDeferred);
 
-    if (count_ == kForever || count_-- > 0) {
-        func_();
-        id_->first += interval_;
-    } else {
-        count_ = 0; // in case if count_ other than -1
+    // if none fired at its own deadline, one of them owns the wakeup
+    if (nDeferred > 0)
+        coalesced_ += nDeferred == nFired ? nDeferred - 1 : nDeferred;
+
+    return nFired;
+}
+
+std::size_t TimerManager::_UpdateWheel(const TimePoint& now, std::size_t max, std::size_t& nDeferred) {
+    std::size_t nFired = 0;
+    while (nFired < max) {
+        const uint32_t index = wheel_->PopExpired(now);
+        if (index == TimingWheel::kNil)
+            break;
+
+        if (_Fire(index))
+            ++ nDeferred;
+        ++ nFired;
     }
+
+    return nFired;
 }
 
-TimerId TimerManager::Timer::Id() const {
-    return id_;
+std::size_t TimerManager::_UpdateMap(const TimePoint& now, std::size_t max, std::size_t& nDeferred) {
+    std::size_t nFired = 0;
+    while (!queue_.empty() && nFired < max) {
+        auto it = queue_.begin();
+        if (it->first > now)
+            break;
+
+        const uint32_t index = it->second;
+        queue_.erase(it);
+
+        if (_Fire(index))
+            ++ nDeferred;
+        ++ nFired;
+    }
+
+    return nFired;
 }
 
-unsigned int TimerManager::Timer::UniqueId() const {
-    return id_->second;
+bool TimerManager::Cancel(TimerId id) {
+    if (!_IsLive(id))
+        return false;
+
+    Timer& t = timers_[id.index_];
+    if (t.state == Timer::eRunning) {
+        // freed when callback returns
+        t.count = 0;
+        return true;
+    }
+
+    _Dequeue(id.index_);
+    _Free(id.index_);
+    return true;
+}
+
+bool TimerManager::RescheduleAt(TimerId id, const TimePoint& triggerTime) {
+    if (!_IsLive(id))
+        return false;
+
+    Timer& t = timers_[id.index_];
+    if (t.state != Timer::ePending)
+        return false;
+
+    _Dequeue(id.index_);
+    t.when = triggerTime;
+    _Enqueue(id.index_);
+    return true;
+}
+
+std::size_t TimerManager::Size() const {
+    return size_;
+}
+
+uint64_t TimerManager::Coalesced() const {
+    return coalesced_;
+}
+
+DurationMs TimerManager::NearestTimer() const {
+    const TimePoint nearest = NearestTimePoint();
+    if (nearest == TimePoint::max())
+        return DurationMs::max();
+
+    auto now = std::chrono::steady_clock::now();
+    if (now > nearest)
+        return DurationMs::min();
+
+    // round up, do not wake up before timer expired
+    const auto left = nearest - now;
+    auto ms = std::chrono::duration_cast<DurationMs>(left);
+    if (ms < left)
+        ++ ms;
+
+    return ms;
+}
+
+TimePoint TimerManager::NearestTimePoint() const {
+    if (backend_ == TimerBackend::eWheel)
+        return wheel_->NearestTimePoint();
+
+    if (queue_.empty())
+        return TimePoint::max();
+
+    return queue_.begin()->first;
 }
 
 } // end namespace internal
@@ -2,22 +2,99 @@
 #ifndef BERT_TIMERMANAGER_H
 #define BERT_TIMERMANAGER_H
 
+#include <limits>
 #include <map>
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <ostream>
+#include <typeinfo>
+#include <stdint.h>
+
+#include "ananas/util/UniqueFunction.h"
 
 namespace ananas {
 
 using DurationMs = std::chrono::milliseconds;
+using DurationUs = std::chrono::microseconds;
 using TimePoint = std::chrono::steady_clock::time_point;
-using TimerId = std::shared_ptr<std::pair<TimePoint, unsigned int> >;
 
 constexpr int kForever = -1;
 
+// Storage of timers.
+// eMap: ordered by time point, O(log n) schedule.
+// eWheel: hierarchical timing wheel with 1ms tick, O(1) schedule,
+//         timers in the same tick are not ordered.
+// Both cancel in O(1).
+enum class TimerBackend {
+    eMap,
+    eWheel,
+};
+
+// Tolerance of timer: it may expire at any time in [deadline, deadline + slack].
+// Timers with overlapping windows are expired in one wakeup.
+class TimerSlack {
+public:
+    TimerSlack() = default;
+
+    template <typename Duration>
+    explicit
+    TimerSlack(const Duration& slack) :
+        slack_(std::chrono::duration_cast<DurationUs>(slack)) {
+    }
+
+    DurationUs Get() const {
+        return slack_;
+    }
+
+private:
+    DurationUs slack_ {0};
+};
+
+namespace internal {
+class TimerManager;
+}
+
+// Handle of timer: slot index and generation, cheap to copy.
+// Default constructed one refers to no timer. Once the timer is fired or
+// canceled, the handle is stale: slot is reused with a new generation.
+class TimerId {
+public:
+    TimerId() = default;
+
+    explicit operator bool() const {
+        return generation_ != 0;
+    }
+
+    bool operator== (const TimerId& other) const {
+        return index_ == other.index_ && generation_ == other.generation_;
+    }
+    bool operator!= (const TimerId& other) const {
+        return !(*this == other);
+    }
+
+    uint32_t Index() const {
+        return index_;
+    }
+    uint32_t Generation() const {
+        return generation_;
+    }
+
+private:
+    friend class internal::TimerManager;
+
+    TimerId(uint32_t index, uint32_t generation) :
+        index_(index),
+        generation_(generation) {
+    }
+
+    uint32_t index_ = 0;
+    uint32_t generation_ = 0; // 0 : invalid
+};
+
 inline std::ostream& operator<< (std::ostream& os, const TimerId& d) {
-    os << "[TimerId:" << (void*)d.get() << "]";
+    os << "[TimerId:" << d.Index() << "." << d.Generation() << "]";
     return os;
 }
 
@@ -25,14 +102,29 @@ namespace internal {
 
 class TimerManager final {
 public:
-    TimerManager();
+    explicit
+    TimerManager(TimerBackend backend = TimerBackend::eMap);
     ~TimerManager();
 
     TimerManager(const TimerManager& ) = delete;
     void operator= (const TimerManager& ) = delete;
 
-    // Tick
-    void Update();
+    // Pending timers are moved to the new backend.
+    // Do not call it in timer callback.
+    void SetBackend(TimerBackend backend);
+    TimerBackend Backend() const;
+
+    // Called before every timer callback, with type name of the callback
+    // like StallInfo::tag, eg. for a watchdog to name the running timer.
+    void SetOnFire(UniqueFunction<void (const char* tag)> f);
+
+    // Tick, return the number of fired timers.
+    // At most max timers are fired, the rest are still due for next tick.
+    std::size_t Update(std::size_t max = std::numeric_limits<std::size_t>::max());
+    // Same as above, but timers are expired against now given by caller,
+    // for example a clock cached by loop.
+    std::size_t Update(const TimePoint& now,
+                       std::size_t max = std::numeric_limits<std::size_t>::max());
 
     // Schedule timer at absolute timepoint then repeat with period
     // RepeatCount: Timer will be canceled after trigger RepeatCount times, kForever implies forever.
@@ -40,6 +132,11 @@ public:
     // period: After 1st trigger, Timer will be triggered every period
     template <int RepeatCount, typename Duration, typename F, typename... Args>
     TimerId ScheduleAtWithRepeat(const TimePoint& triggerTime, const Duration& period, F&& f, Args&&... args);
+    // slack: every trigger may be deferred by at most slack, so that timers
+    // close to each other share a wakeup. Same for the overloads below.
+    template <int RepeatCount, typename Duration, typename F, typename... Args>
+    TimerId ScheduleAtWithRepeat(const TimePoint& triggerTime, const Duration& period,
+                                 TimerSlack slack, F&& f, Args&&... args);
 
     // Schedule timer with period
     // RepeatCount: Timer will be canceled after triggered RepeatCount times, kForever implies forever.
@@ -47,109 +144,197 @@ public:
     // PAY ATTENTION: Timer's first triggered at once, but after period time
     template <int RepeatCount, typename Duration, typename F, typename... Args>
     TimerId ScheduleAfterWithRepeat(const Duration& period, F&& f, Args&&... args);
+    template <int RepeatCount, typename Duration, typename F, typename... Args>
+    TimerId ScheduleAfterWithRepeat(const Duration& period, TimerSlack slack, F&& f, Args&&... args);
 
     // Schedule timer at timepoint
     // triggerTime: The absolute time at when timer will be triggered
     template <typename F, typename... Args>
     TimerId ScheduleAt(const TimePoint& triggerTime, F&& f, Args&&... args);
+    template <typename F, typename... Args>
+    TimerId ScheduleAt(const TimePoint& triggerTime, TimerSlack slack, F&& f, Args&&... args);
 
     // Schedule timer after duration
     // duration: After duration, timer will be triggered
     template <typename Duration, typename F, typename... Args>
     TimerId ScheduleAfter(const Duration& duration, F&& f, Args&&... args);
+    template <typename Duration, typename F, typename... Args>
+    TimerId ScheduleAfter(const Duration& duration, TimerSlack slack, F&& f, Args&&... args);
 
-    // Cancel timer
+    // Cancel timer, return false if id is stale.
     bool Cancel(TimerId id);
 
-    // how far the nearest timer will be trigger.
-    DurationMs NearestTimer() const;
-
-private:
-    class Timer {
-        friend class TimerManager;
-    public:
-        explicit
-        Timer(const TimePoint& tp);
+    // Move pending timer to triggerTime, its period, slack and remaining count are kept.
+    // Return false if id is stale or timer is running.
+    bool RescheduleAt(TimerId id, const TimePoint& triggerTime);
+    template <typename Duration>
+    bool RescheduleAfter(TimerId id, const Duration& duration);
 
-        // only move
-        Timer(Timer&& timer);
-        Timer& operator= (Timer&& );
+    // number of pending timers
+    std::size_t Size() const;
 
-        Timer(const Timer& ) = delete;
-        void operator= (const Timer& ) = delete;
+    // Timers deferred by slack into a wakeup owned by another timer, total
+    // since construction. Timers which are just overdue together don't count.
+    uint64_t Coalesced() const;
 
-        template <typename F, typename... Args>
-        void SetCallback(F&& f, Args&&... args);
-
-        void OnTimer();
-
-        TimerId Id() const;
-        unsigned int UniqueId() const;
+    // how far the nearest timer will be trigger, round up to milliseconds.
+    // It reads the clock: a loop's cached one is stale by the handlers run
+    // since, the poll timeout would be too long.
+    DurationMs NearestTimer() const;
 
-    private:
-        void _Move(Timer&& timer);
+    // when the nearest timer will be trigger, TimePoint::max() if no timer.
+    // It's the deadline deferred by slack.
+    TimePoint NearestTimePoint() const;
 
-        TimerId id_;
+private:
+    class TimingWheel;
+    struct Timer;
 
-        std::function<void ()> func_;
-        DurationMs interval_;
-        int count_;
+    template <typename F>
+    static UniqueFunction<void ()> _MakeCallback(F&& f);
+    template <typename F, typename... Args>
+    static UniqueFunction<void ()> _MakeCallback(F&& f, Args&&... args);
+
+    TimerId _Add(const TimePoint& triggerTime, DurationUs interval, int count,
+                 DurationUs slack, UniqueFunction<void ()>&& func, const char* tag);
+    bool _IsLive(TimerId id) const;
+    // put pending timer into backend
+    void _Enqueue(uint32_t index);
+    // take pending timer out of backend
+    void _Dequeue(uint32_t index);
+    void _Free(uint32_t index);
+    // return true if the timer was deferred by its slack
+    bool _Fire(uint32_t index);
+    // when the timer expires in backend, deferred by slack
+    TimePoint _Deadline(const Timer& t) const;
+    std::size_t _UpdateMap(const TimePoint& now, std::size_t max, std::size_t& nDeferred);
+    std::size_t _UpdateWheel(const TimePoint& now, std::size_t max, std::size_t& nDeferred);
+
+    using Queue = std::multimap<TimePoint, uint32_t>;
+
+    struct Timer {
+        enum State {
+            eFree,
+            ePending,
+            eRunning,
+        };
+
+        TimePoint when;
+        DurationUs interval {0};
+        DurationUs slack {0};
+        int count = 0;
+        uint32_t generation = 0;
+        State state = eFree;
+        uint32_t nextFree = 0;
+        Queue::iterator pos; // if backend is map
+        UniqueFunction<void ()> func;
+        const char* tag = nullptr; // typeid name of callback
     };
 
-    std::multimap<TimePoint, Timer> timers_;
-
-    friend class Timer;
+    TimerBackend backend_;
+    // indexed by TimerId, deque: timer stays put while it's running
+    std::deque<Timer> timers_;
+    uint32_t freeList_;
+    std::size_t size_ = 0;
+    uint64_t coalesced_ = 0;
+    UniqueFunction<void (const char* )> onFire_;
 
-    // not thread-safe, but who cares?
-    static unsigned int s_timerIdGen_;
+    Queue queue_;
+    std::unique_ptr<TimingWheel> wheel_;
 };
 
 
 template <int RepeatCount, typename Duration, typename F, typename... Args>
 TimerId TimerManager::ScheduleAtWithRepeat(const TimePoint& triggerTime, const Duration& period, F&& f, Args&&... args) {
+    return ScheduleAtWithRepeat<RepeatCount>(triggerTime,
+                                             period,
+                                             TimerSlack(),
+                                             std::forward<F>(f),
+                                             std::forward<Args>(args)...);
+}
+
+template <int RepeatCount, typename Duration, typename F, typename... Args>
+TimerId TimerManager::ScheduleAtWithRepeat(const TimePoint& triggerTime, const Duration& period,
+                                           TimerSlack slack, F&& f, Args&&... args) {
     static_assert(RepeatCount != 0, "Why you add a timer with zero count?");
+    static_assert(RepeatCount > 0 || RepeatCount == kForever, "Negative count other than kForever");
 
     using namespace std::chrono;
 
-    Timer t(triggerTime);
-    // precision: milliseconds
-    t.interval_ = std::max(DurationMs(1), duration_cast<DurationMs>(period));
-    t.count_ = RepeatCount;
-    TimerId id = t.Id();
-
-    t.SetCallback(std::forward<F>(f), std::forward<Args>(args)...);
-    timers_.insert(std::make_pair(triggerTime, std::move(t)));
-    return id;
+    // precision: microseconds
+    return _Add(triggerTime,
+                std::max(DurationUs(1), duration_cast<DurationUs>(period)),
+                RepeatCount,
+                slack.Get(),
+                _MakeCallback(std::forward<F>(f), std::forward<Args>(args)...),
+                typeid(typename std::decay<F>::type).name());
 }
 
 template <int RepeatCount, typename Duration, typename F, typename... Args>
 TimerId TimerManager::ScheduleAfterWithRepeat(const Duration& period, F&& f, Args&&... args) {
+    return ScheduleAfterWithRepeat<RepeatCount>(period,
+                                                TimerSlack(),
+                                                std::forward<F>(f),
+                                                std::forward<Args>(args)...);
+}
+
+template <int RepeatCount, typename Duration, typename F, typename... Args>
+TimerId TimerManager::ScheduleAfterWithRepeat(const Duration& period, TimerSlack slack, F&& f, Args&&... args) {
     const auto now = std::chrono::steady_clock::now();
     return ScheduleAtWithRepeat<RepeatCount>(now + period,
                                              period,
+                                             slack,
                                              std::forward<F>(f),
                                              std::forward<Args>(args)...);
 }
 
 template <typename F, typename... Args>
 TimerId TimerManager::ScheduleAt(const TimePoint& triggerTime, F&& f, Args&&... args) {
+    return ScheduleAt(triggerTime,
+                      TimerSlack(),
+                      std::forward<F>(f),
+                      std::forward<Args>(args)...);
+}
+
+template <typename F, typename... Args>
+TimerId TimerManager::ScheduleAt(const TimePoint& triggerTime, TimerSlack slack, F&& f, Args&&... args) {
     return ScheduleAtWithRepeat<1>(triggerTime,
                                    DurationMs(0), // dummy
+                                   slack,
                                    std::forward<F>(f),
                                    std::forward<Args>(args)...);
 }
 
 template <typename Duration, typename F, typename... Args>
 TimerId TimerManager::ScheduleAfter(const Duration& duration, F&& f, Args&&... args) {
+    return ScheduleAfter(duration,
+                         TimerSlack(),
+                         std::forward<F>(f),
+                         std::forward<Args>(args)...);
+}
+
+template <typename Duration, typename F, typename... Args>
+TimerId TimerManager::ScheduleAfter(const Duration& duration, TimerSlack slack, F&& f, Args&&... args) {
     const auto now = std::chrono::steady_clock::now();
     return ScheduleAt(now + duration,
+                      slack,
                       std::forward<F>(f),
                       std::forward<Args>(args)...);
 }
 
+template <typename Duration>
+bool TimerManager::RescheduleAfter(TimerId id, const Duration& duration) {
+    return RescheduleAt(id, std::chrono::steady_clock::now() + duration);
+}
+
+template <typename F>
+UniqueFunction<void ()> TimerManager::_MakeCallback(F&& f) {
+    return UniqueFunction<void ()>(std::forward<F>(f));
+}
+
 template <typename F, typename... Args>
-void TimerManager::Timer::SetCallback(F&& f, Args&&... args) {
-    func_ = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+UniqueFunction<void ()> TimerManager::_MakeCallback(F&& f, Args&&... args) {
+    return std::bind(std::forward<F>(f), std::forward<Args>(args)...);
 }
 
 } // end namespace internal
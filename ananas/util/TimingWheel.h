@@ -0,0 +1,86 @@
+#ifndef BERT_TIMINGWHEEL_H
+#define BERT_TIMINGWHEEL_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "Timer.h"
+
+namespace ananas {
+namespace internal {
+
+// Hierarchical timing wheel, tick is 1ms.
+//
+// Level 0 has 256 slots of one tick, level 1~4 have 64 slots each, covering
+// 2^14, 2^20, 2^26, 2^32 ticks(49 days). Farther timers wait in the last
+// level and are placed again when cascaded.
+// A timer is in the slot of its level by absolute tick, when the wheel turns
+// to the start of a higher slot, timers in it are cascaded to lower levels.
+//
+// The wheel only orders timers by index of TimerManager's table, links of
+// timers in slot lists are kept here, so add and remove are O(1).
+// Timers never fire early: deadline is rounded up to tick.
+class TimerManager::TimingWheel {
+public:
+    static constexpr uint32_t kNil = ~uint32_t(0);
+
+    explicit
+    TimingWheel(const TimePoint& base);
+
+    TimingWheel(const TimingWheel& ) = delete;
+    void operator= (const TimingWheel& ) = delete;
+
+    void Add(uint32_t index, const TimePoint& when);
+    void Remove(uint32_t index);
+    // Turn the wheel to now, return index of an expired timer, which is
+    // removed from wheel; kNil if none.
+    uint32_t PopExpired(const TimePoint& now);
+    // Lower bound of the nearest deadline, TimePoint::max() if no timer.
+    // It may be a cascade point where no timer fires.
+    TimePoint NearestTimePoint() const;
+
+private:
+    static constexpr int kLevels = 5;
+    static constexpr int kRootBits = 8;
+    static constexpr int kLevelBits = 6;
+    static constexpr uint64_t kRootSlots = 1 << kRootBits;
+    static constexpr uint64_t kLevelSlots = 1 << kLevelBits;
+    static constexpr uint64_t kMaxDelta = uint64_t(1) << (kRootBits + (kLevels - 1) * kLevelBits);
+    static constexpr uint64_t kNever = ~uint64_t(0);
+
+    // list ids: slots of level 0, slots of level 1~4, due list
+    static constexpr uint32_t kNumSlots = kRootSlots + (kLevels - 1) * kLevelSlots;
+    static constexpr uint32_t kDueList = kNumSlots;
+
+    struct Link {
+        uint64_t tick = 0;
+        uint32_t prev = kNil;
+        uint32_t next = kNil;
+        uint32_t list = kNil; // kNil if not in wheel
+    };
+
+    static int _Shift(int level);
+    uint64_t _TickOf(const TimePoint& tp, bool roundUp) const;
+
+    // put timer in slot or due list by its tick
+    void _Place(uint32_t index);
+    void _Link(uint32_t index, uint32_t list);
+    void _Unlink(uint32_t index);
+    void _Cascade(int level);
+    void _ExpireRoot();
+    uint64_t _NextTick() const;
+
+    const TimePoint base_;
+    uint64_t current_ = 0; // ticks before and at current_ are expired
+    std::size_t size_ = 0;
+
+    std::vector<Link> links_; // indexed by timer index
+    uint32_t heads_[kNumSlots + 1]; // plus due list
+    uint64_t occupied_[kNumSlots / 64];
+};
+
+} // end namespace internal
+} // end namespace ananas
+
+#endif
+
@@ -0,0 +1,64 @@
+#ifndef BERT_TRACE_H
+#define BERT_TRACE_H
+
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+// Trace points for hot paths.
+//
+// ANANAS_TRACE_POINT(name, arg) expands to nothing unless ANANAS_TRACE is
+// defined at build time, arg is not even evaluated then.
+// When enabled, each point records {timestamp, name, arg} into a ring
+// buffer owned by the calling thread: no lock, no allocation, no I/O.
+// name must be a string literal, arg is an integer or a pointer.
+//
+// Usage:
+//
+// ANANAS_TRACE_POINT("channel.new", this);
+// ...
+// ananas::DumpTraces(stderr);
+
+namespace ananas {
+
+struct TraceEvent {
+    int64_t ns;       // steady clock
+    uint64_t thread;  // small id of recording thread, from 1
+    const char* name;
+    uint64_t arg;
+};
+
+// Records of all threads, including exited ones, ordered by time.
+// Best effort if called when others are still tracing: records being
+// overwritten are skipped.
+std::vector<TraceEvent> CollectTraces();
+void DumpTraces(FILE* fp);
+
+namespace internal {
+
+void TraceRecord(const char* name, uint64_t arg);
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint64_t>::type
+TraceArg(T v) {
+    return static_cast<uint64_t>(v);
+}
+
+inline uint64_t TraceArg(const void* p) {
+    return reinterpret_cast<uintptr_t>(p);
+}
+
+} // end namespace internal
+
+} // end namespace ananas
+
+#ifdef ANANAS_TRACE
+#define ANANAS_TRACE_POINT(name, arg) \
+    ::ananas::internal::TraceRecord(name, ::ananas::internal::TraceArg(arg))
+#else
+#define ANANAS_TRACE_POINT(name, arg) do { } while (0)
+#endif
+
+#endif
+
@@ -0,0 +1,204 @@
+#ifndef BERT_UNIQUEFUNCTION_H
+#define BERT_UNIQUEFUNCTION_H
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ananas {
+
+// Move-only replacement of std::function.
+//
+// It can hold move-only callables, such as a lambda capturing a Promise or a
+// unique_ptr, and stores callables no larger than InlineSize bytes in place
+// without heap allocation. Larger ones are allocated once and only the
+// pointer is moved afterwards.
+//
+// Like std::function, calling an empty UniqueFunction is undefined, and
+// operator() is const but calls the stored callable as non-const.
+
+constexpr std::size_t kUniqueFunctionInlineSize = 4 * sizeof(void*);
+
+template <typename Signature, std::size_t InlineSize = kUniqueFunctionInlineSize>
+class UniqueFunction;
+
+template <typename R, typename... Args, std::size_t InlineSize>
+class UniqueFunction<R (Args...), InlineSize> {
+    static_assert(InlineSize >= sizeof(void*), "InlineSize can't hold a pointer");
+
+    template <typename F, typename Result = typename std::result_of<typename std::decay<F>::type& (Args...)>::type>
+    using Callable = std::integral_constant<bool,
+                     !std::is_same<typename std::decay<F>::type, UniqueFunction>::value &&
+                     (std::is_void<R>::value || std::is_convertible<Result, R>::value)>;
+
+public:
+    UniqueFunction() noexcept {
+    }
+
+    UniqueFunction(std::nullptr_t) noexcept {
+    }
+
+    template <typename F, typename = typename std::enable_if<Callable<F>::value>::type>
+    UniqueFunction(F&& f) {
+        using Func = typename std::decay<F>::type;
+        if (_IsNull(f))
+            return;
+
+        _Construct<Func>(std::forward<F>(f), std::integral_constant<bool, _FitsInline<Func>()>());
+    }
+
+    UniqueFunction(UniqueFunction&& other) noexcept {
+        _MoveFrom(other);
+    }
+
+    UniqueFunction& operator= (UniqueFunction&& other) noexcept {
+        if (this != &other) {
+            _Reset();
+            _MoveFrom(other);
+        }
+
+        return *this;
+    }
+
+    UniqueFunction& operator= (std::nullptr_t) noexcept {
+        _Reset();
+        return *this;
+    }
+
+    template <typename F, typename = typename std::enable_if<Callable<F>::value>::type>
+    UniqueFunction& operator= (F&& f) {
+        return *this = UniqueFunction(std::forward<F>(f));
+    }
+
+    UniqueFunction(const UniqueFunction& ) = delete;
+    void operator= (const UniqueFunction& ) = delete;
+
+    ~UniqueFunction() {
+        _Reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+    R operator()(Args... args) const {
+        return ops_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+
+    // true if callable is stored without heap allocation
+    bool IsInline() const noexcept {
+        return ops_ && ops_->isInline;
+    }
+
+    void Swap(UniqueFunction& other) noexcept {
+        UniqueFunction tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+private:
+    using Storage = typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type;
+
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        // move construct dst from src, then destroy src
+        void (*relocate)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+        bool isInline;
+    };
+
+    template <typename Func>
+    static constexpr bool _FitsInline() {
+        return sizeof(Func) <= sizeof(Storage) &&
+               alignof(Func) <= alignof(Storage) &&
+               std::is_nothrow_move_constructible<Func>::value;
+    }
+
+    template <typename Func, typename F>
+    void _Construct(F&& f, std::true_type ) {
+        new (&storage_) Func(std::forward<F>(f));
+        ops_ = _InlineOps<Func>();
+    }
+
+    template <typename Func, typename F>
+    void _Construct(F&& f, std::false_type ) {
+        new (&storage_) Func* (new Func(std::forward<F>(f)));
+        ops_ = _HeapOps<Func>();
+    }
+
+    template <typename Func>
+    static const Ops* _InlineOps() {
+        static const Ops ops = {
+            [](void* s, Args&&... args) -> R {
+                return static_cast<R>((*static_cast<Func*>(s))(std::forward<Args>(args)...));
+            },
+            [](void* dst, void* src) noexcept {
+                Func* f = static_cast<Func*>(src);
+                new (dst) Func(std::move(*f));
+                f->~Func();
+            },
+            [](void* s) noexcept {
+                static_cast<Func*>(s)->~Func();
+            },
+            true
+        };
+        return &ops;
+    }
+
+    template <typename Func>
+    static const Ops* _HeapOps() {
+        static const Ops ops = {
+            [](void* s, Args&&... args) -> R {
+                return static_cast<R>((**static_cast<Func**>(s))(std::forward<Args>(args)...));
+            },
+            [](void* dst, void* src) noexcept {
+                new (dst) Func* (*static_cast<Func**>(src));
+            },
+            [](void* s) noexcept {
+                delete *static_cast<Func**>(s);
+            },
+            false
+        };
+        return &ops;
+    }
+
+    template <typename F>
+    static bool _IsNull(const F& ) {
+        return false;
+    }
+
+    template <typename T>
+    static bool _IsNull(T* f) {
+        return f == nullptr;
+    }
+
+    template <typename S>
+    static bool _IsNull(const std::function<S>& f) {
+        return !f;
+    }
+
+    void _MoveFrom(UniqueFunction& other) noexcept {
+        if (other.ops_) {
+            other.ops_->relocate(&storage_, &other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    void _Reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    mutable Storage storage_;
+    const Ops* ops_ = nullptr;
+};
+
+} // end namespace ananas
+
+#endif
+